@@ -26,15 +26,7 @@
  * @param b Pointer to bstring_t;
  * @return Length of string.
  */
-int bs_advance(bstring_t *b)
-{
-   b->buf++;
-   b->len--;
-   return b->len;
-}
-
-
-int bs_advancel(bstringl_t *b)
+long bs_advance(bstring_t *b)
 {
    b->buf++;
    b->len--;
@@ -47,7 +39,7 @@ int bs_advancel(bstringl_t *b)
  * @param b Pointer to bstring_t.
  * @return Length of string.
  */
-int bs_advance2(bstring_t *b)
+long bs_advance2(bstring_t *b)
 {
    if (b == NULL || b->buf == NULL || b->len < 1)
       return 0;
@@ -60,9 +52,9 @@ int bs_advance2(bstring_t *b)
  * returned. If they are not equal, the return value of strncmp(3) is returned.
  * If the string length of either is less then n, -2 is returned.
  */
-int bs_ncmp(bstring_t b, const char *s, int n)
+int bs_ncmp(bstring_t b, const char *s, long n)
 {
-   if ((b.len < n) || (strlen(s) < n))
+   if ((b.len < n) || ((long) strlen(s) < n))
       return -2;
    return strncmp(b.buf, s, n);
 }
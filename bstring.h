@@ -19,28 +19,15 @@
 #define BSTRING_H
 
 
-typedef struct bstrings
-{
-   short len;
-   char *buf;
-} bstrings_t;
-
 typedef struct bstring
-{
-   int len;
-   char *buf;
-} bstring_t;
-
-typedef struct bstringl
 {
    long len;
    char *buf;
-} bstringl_t;
+} bstring_t;
 
-int bs_advance(bstring_t *);
-int bs_advancel(bstringl_t *);
-int bs_advance2(bstring_t *);
-int bs_ncmp(bstring_t b, const char *s, int n);
+long bs_advance(bstring_t *);
+long bs_advance2(bstring_t *);
+int bs_ncmp(bstring_t b, const char *s, long n);
 int bs_cmp(bstring_t b, const char *s);
 long bs_tol(bstring_t b);
 double bs_tod(bstring_t b);
@@ -0,0 +1,306 @@
+#!/bin/sh
+# Copyright 2011 Bernhard R. Fischer, 2048R/5C5FFD47 <bf@abenteuerland.at>
+#
+# This file is part of smfilter.
+#
+# Smfilter is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, version 3 of the License.
+#
+# Smfilter is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with smfilter. If not, see <http://www.gnu.org/licenses/>.
+
+# Regression check of the output of smfilter against golden outputs.
+#
+# The corpus consists of testlight.osm, testinvalid.osm (seamarks with
+# errors), and two files generated by smgen (gen, big). The golden outputs
+# of the first two are kept as files golden/<input>.<test>,
+# those of the generated files as MD5 sums in golden/SUMS. The goldens of
+# the modes which already existed before the output layer (osm, chu, S,
+# par) were produced by the baseline version of smfilter.
+#
+# Each output format and mode is run with file input and one thread (ref)
+# and with
+#   pipe ... input read from a pipe,
+#   I4k .... initial input buffer of 4 kB which has to grow,
+#   pI4k ... both of the above,
+#   t0 ..... no encoder/decoder threads,
+#   tN ..... N threads (default = number of cpus),
+#   x ...... index built by the first run (-x) and used by the second run.
+# All outputs have to be byte-identical to the golden output. The time of
+# each run is reported relative to the reference run (> 1 is faster).
+#
+# The other modes are checked against their golden outputs and, where
+# possible, semantically: -z is decompressed and compared to the plain
+# output, PBF and o5m input has to generate the same objects as OSM input,
+# -k has to produce the same output from the cache, and the sector file of
+# -s is read back with sctdump and compared to the input tags and to the
+# counters of -v.
+#
+# The counts of the example of the event API of libhpxml (hpxcount) are
+# compared to smfilter -v and to the number of tags in the input, and it is
+# checked that tags with many attributes are reported completely.
+#
+# usage: check.sh [-r] [<smfilter> [<smgen> [<sctdump> [<hpxcount>]]]]
+#   -r ... record the golden outputs instead of checking them
+
+RECORD=0
+if [ "$1" = "-r" ]; then
+   RECORD=1
+   shift
+fi
+SMFILTER=${1:-./smfilter}
+SMGEN=${2:-./smgen}
+SCTDUMP=${3:-./sctdump}
+HPXCOUNT=${4:-./hpxcount}
+N=${THREADS:-$(nproc 2>/dev/null || echo 4)}
+DIR=$(dirname "$0")
+GOLD=$DIR/golden
+
+T=$(mktemp -d) || exit 1
+trap 'rm -rf "$T"' EXIT
+fail=0
+
+cp "$DIR/testlight.osm" "$T/testlight.osm" || exit 1
+cp "$DIR/testinvalid.osm" "$T/testinvalid.osm" || exit 1
+$SMGEN -n 5000 -s 0.01 > "$T/gen.osm" || exit 1
+# larger than the input buffer of 10 MB, thus it is refilled when piped
+$SMGEN -n 80000 -s 0.005 > "$T/big.osm" || exit 1
+: > "$T/SUMS"
+
+now()
+{
+   date +%s%N
+}
+
+# run <name> <input> <args...>, output goes to $T/<name>.out
+run()
+{
+   rn=$1 ri=$2
+   shift 2
+   t0=$(now)
+   case $rn in
+      pipe|pI4k) cat "$T/$ri.osm" | $SMFILTER "$@" > "$T/$rn.out" 2> "$T/$rn.err" ;;
+      *) $SMFILTER "$@" < "$T/$ri.osm" > "$T/$rn.out" 2> "$T/$rn.err" ;;
+   esac
+   rc=$?
+   t1=$(now)
+   [ $rc -eq 0 ] || { echo "FAIL: $ri $rn exited with $rc: $(head -1 "$T/$rn.err")"; return 1; }
+   dt=$(( (t1 - t0) / 1000 + 1 ))
+}
+
+
+# golden <input> <test> <file>, compare file to golden output or record it
+golden()
+{
+   case $1 in
+      testlight|testinvalid)
+         if [ $RECORD -eq 1 ]; then
+            cp "$3" "$GOLD/$1.$2"
+            return 0
+         fi
+         cmp -s "$GOLD/$1.$2" "$3"
+         ;;
+      *)
+         sum="$(md5sum < "$3" | cut -d ' ' -f 1)  $1.$2"
+         if [ $RECORD -eq 1 ]; then
+            grep -qxF "$sum" "$T/SUMS" || echo "$sum" >> "$T/SUMS"
+            return 0
+         fi
+         grep -qxF "$sum" "$GOLD/SUMS"
+         ;;
+   esac
+}
+
+# result <line> <status>, print result of a check
+result()
+{
+   if [ "$2" -eq 0 ]; then
+      echo "$1: ok"
+   else
+      fail=1
+      echo "$1: DIFF"
+   fi
+}
+
+# list <dir>, MD5 sums of all files of a directory tree
+list()
+{
+   (cd "$1" && find . -type f | LC_ALL=C sort | xargs md5sum)
+}
+
+# osc <action> <input>, wrap OSM file into an osmChange
+osc()
+{
+   sed -e "s/^<osm .*>\$/<osmChange version='0.6'><$1>/" -e "s|^</osm>\$|</$1></osmChange>|" "$T/$2.osm"
+}
+
+# output formats and modes, with all input and thread variants
+for inp in testlight gen big; do
+   for test in osm chu S par g n pbf pbf-g pbf-n o5m o5m-g o5m-n geojson geojson-g geojsonl; do
+      case $test in
+         osm) args= ;;
+         chu) args="-c -H -U" ;;
+         S) args=-S ;;
+         par) args="-a 0.05 -d 4 -r 0.3 -b 3 -i -1000" ;;
+         g|n) args=-$test ;;
+         *-*) args="-o ${test%-*} -${test#*-}" ;;
+         *) args="-o $test" ;;
+      esac
+      case $inp/$test in big/o5m*|big/geojson*) continue ;; esac
+
+      line="$inp $test"
+      run ref $inp -t 1 $args || { fail=1; continue; }
+      golden $inp $test "$T/ref.out" || { result "$line" 1; continue; }
+      tref=$dt
+      for v in pipe I4k pI4k t0 tN x; do
+         case $v in
+            pipe) run pipe $inp -t 1 $args ;;
+            I4k|pI4k) run $v $inp -t 1 -I 0.004 $args ;;
+            t0) run t0 $inp -t 0 $args ;;
+            tN) run tN $inp -t $N $args ;;
+            x)
+               case $test in *g|*n) ;; *) continue ;; esac
+               rm -f "$T/idx"
+               run x $inp -t 1 -x "$T/idx" $args && cmp -s "$T/ref.out" "$T/x.out" &&
+                  run x $inp -t 1 -x "$T/idx" $args
+               ;;
+         esac || { fail=1; line="$line $v FAIL,"; continue; }
+         if cmp -s "$T/ref.out" "$T/$v.out"; then
+            line="$line $v $(echo "$tref $dt" | awk '{printf "%.2fx", $1 / $2}'),"
+         else
+            fail=1
+            line="$line $v DIFF,"
+         fi
+      done
+      echo "${line%,}"
+   done
+done
+
+# other modes
+for inp in testlight gen testinvalid; do
+   # compressed output
+   run z $inp -z gzip && gzip -dc < "$T/z.out" > "$T/zd.out" && run ref $inp &&
+      cmp -s "$T/ref.out" "$T/zd.out"
+   result "$inp z" $?
+
+   # PBF and o5m input
+   for fmt in pbf o5m; do
+      run ref $inp -S -o $fmt && mv "$T/ref.out" "$T/$inp.$fmt.osm" &&
+         run f $inp.$fmt -f $fmt && golden $inp f$fmt "$T/f.out" &&
+         run f $inp.$fmt -f $fmt -g && run ref $inp -g &&
+         [ "$(tail -n +3 "$T/f.out" | cksum)" = "$(tail -n +3 "$T/ref.out" | cksum)" ]
+      result "$inp f$fmt" $?
+   done
+
+   # cache, the second run reads the objects from the cache
+   rm -f "$T/cache"
+   run k $inp -k "$T/cache" && golden $inp k "$T/k.out" && cp "$T/k.out" "$T/k1.out" &&
+      run k $inp -k "$T/cache" && cmp -s "$T/k1.out" "$T/k.out"
+   result "$inp k" $?
+
+   # incremental mode, the nodes are created, modified, and deleted
+   rm -f "$T/state"
+   e=0
+   for act in create modify delete; do
+      osc $act $inp > "$T/$inp.osc.osm" && run u $inp.osc -u "$T/state" && golden $inp u-$act "$T/u.out" &&
+         { LC_ALL=C sort "$T/state" 2>/dev/null; true; } > "$T/state.out" && golden $inp u-$act-state "$T/state.out" || e=1
+   done
+   result "$inp u" $e
+
+   # tiles and vector tiles
+   rm -rf "$T/tiles" "$T/mvt"
+   run T $inp -T "$T/tiles:10" && list "$T/tiles" > "$T/T.out" && golden $inp T "$T/T.out"
+   result "$inp T" $?
+   run M $inp -M "$T/mvt:8-11" && list "$T/mvt" > "$T/M.out" && golden $inp M "$T/M.out"
+   result "$inp M" $?
+
+   # regions
+   run B $inp -B -100,-50,100,50 && golden $inp B "$T/B.out"
+   result "$inp B" $?
+   run P $inp -P "$GOLD/region.poly" && golden $inp P "$T/P.out"
+   result "$inp P" $?
+
+   # validation report
+   run V $inp -V - && golden $inp V "$T/V.out"
+   result "$inp V" $?
+
+   # metrics, just the counters which do not depend on time
+   run m $inp -m "$T/m.json" && tr -d '{}' < "$T/m.json" | tr ',' '\n' |
+      grep -E '^"(done|input_bytes|generated_ids|elements|nodes|seamarks|sectors|generated_nodes|generated_ways|features)"' > "$T/m.out" &&
+      golden $inp m "$T/m.out"
+   result "$inp m" $?
+
+   # sector file, read back and compared to the counters and the input tags
+   run s $inp -s "$T/sect" -v && $SCTDUMP "$T/sect" > "$T/s.out" && golden $inp s "$T/s.out" &&
+      [ "$(awk '$1 == "sectors" {print $3}' "$T/s.err")" = "$(awk 'NR == 1 {print $4}' "$T/s.out")" ] &&
+      awk '
+         function ne(a, b) { return a - b > 0.005 || b - a > 0.005 }
+         FNR == NR {
+            # sector angles of the input tags
+            if ($0 ~ /<node /)
+            {
+               id = $0
+               sub(/.* id=./, "", id)
+               sub(/[^-0-9].*/, "", id)
+            }
+            if (match($0, /seamark:light:[0-9]+:sector_(start|end)/))
+            {
+               k = substr($0, RSTART + 14, RLENGTH - 14)
+               v = $0
+               sub(/.* v=./, "", v)
+               sub(/[^.0-9].*/, "", v)
+               ang[id ":" k] = v + 0
+            }
+            next
+         }
+         $1 == "sector" && $10 == 0 {
+            # the end angle may exceed 360
+            if (!(($2 ":" $3 ":sector_start") in ang) || ne(ang[$2 ":" $3 ":sector_start"], $4) ||
+                  ne(ang[$2 ":" $3 ":sector_end"], $5 >= 360 ? $5 - 360 : $5))
+            {
+               print "sector " $3 " of node " $2 " differs from input"
+               e = 1
+            }
+            n++
+         }
+         END { exit e || !n }
+      ' "$T/$inp.osm" "$T/s.out"
+   result "$inp s" $?
+done
+
+# event API of libhpxml
+for inp in testlight gen; do
+   nodes=$($SMFILTER -v < "$T/$inp.osm" 2>&1 >/dev/null | awk '$1 == "nodes" {print $3}')
+   tags=$(grep -o '<tag ' "$T/$inp.osm" | wc -l)
+   cnt=$($HPXCOUNT < "$T/$inp.osm" | awk '$1 != "attributes" {printf "%s ", $2}')
+   [ "$cnt" = "$nodes $tags " ]
+   result "$inp hpxcount" $?
+done
+{
+   echo "<osm>"
+   printf '<node id="1"'
+   i=1
+   while [ $i -le 100 ]; do printf ' a%d="%d"' $i $i; i=$((i + 1)); done
+   echo '><tag k="a" v="b"/></node>'
+   echo "</osm>"
+} > "$T/wide.osm"
+[ "$($HPXCOUNT < "$T/wide.osm" | awk '{printf "%s ", $2}')" = "1 1 103 " ]
+result "wide hpxcount" $?
+
+if [ $RECORD -eq 1 ]; then
+   cp "$T/SUMS" "$GOLD/SUMS"
+   echo "golden outputs recorded"
+   exit 0
+fi
+
+if [ $fail -ne 0 ]; then
+   echo "*** check failed"
+   exit 1
+fi
+echo "all outputs identical"
@@ -0,0 +1,10 @@
+"done":true
+"input_bytes":2604
+"generated_ids":46
+"elements":54
+"nodes":6
+"seamarks":6
+"sectors":5
+"generated_nodes":32
+"generated_ways":14
+"features":0
@@ -0,0 +1,16 @@
+lights 5 sectors 5 subsectors 5
+light 101 38.2999992 25.1000004 1
+sector 101 1 0.00 90.00 - - white - 0 1
+frac 101 1 0.20 0.00 90.00 1 white 1 1
+light 102 38.4000015 25.2000008 1
+sector 102 1 0.00 90.00 - - white - 0 1
+frac 102 1 1.00 0.00 90.00 2 white 1 1
+light 104 38.5999985 25.3999996 1
+sector 104 3 250.00 300.00 - - yellow - 0 1
+frac 104 3 0.20 250.00 300.00 1 yellow 1 1
+light 0 38.7000008 25.5000000 1
+sector 0 1 10.00 50.00 - - white - 0 1
+frac 0 1 0.20 10.00 50.00 1 white 1 1
+light -7 38.7999992 25.6000004 1
+sector -7 1 10.00 50.00 - - white - 0 1
+frac -7 1 0.20 10.00 50.00 1 white 1 1
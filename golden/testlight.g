@@ -0,0 +1,341 @@
+<?xml version='1.0' encoding='UTF-8'?>
+<osm version='0.6' generator='Bernhard R. Fischer'>
+<node id="-1" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.277342" lon="25.086537"/>
+<way id="-2" version="1" timestamp="2008-07-25T11:12:13Z">
+<nd ref="1"/>
+<nd ref="-1"/>
+<tag k="seamark:light_radial" v="4"/>
+<tag k="seamark:light:object" v="light_minor"/>
+</way>
+<node id="-3" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.279520" lon="25.081728"/>
+<way id="-4" version="1" timestamp="2008-07-25T11:12:13Z">
+<nd ref="1"/>
+<nd ref="-3"/>
+<tag k="seamark:light_radial" v="4"/>
+<tag k="seamark:light:object" v="light_minor"/>
+</way>
+<node id="-5" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.278096" lon="25.084644"/>
+<node id="-6" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.278948" lon="25.082818"/>
+<way id="-7" version="1" timestamp="2008-07-25T11:12:13Z">
+<tag k="seamark:light:sector_nr" v="4"/>
+<tag k="seamark:light:object" v="light_minor"/>
+<tag k="seamark:arc_style" v="solid"/>
+<tag k="seamark:light_arc" v="red"/>
+<nd ref="-1"/>
+<nd ref="-5"/>
+<nd ref="-6"/>
+<nd ref="-3"/>
+</way>
+<node id="-8" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.287232" lon="25.086349"/>
+<way id="-9" version="1" timestamp="2008-07-25T11:12:13Z">
+<nd ref="1"/>
+<nd ref="-8"/>
+<tag k="seamark:light_radial" v="1"/>
+<tag k="seamark:light:object" v="light_minor"/>
+</way>
+<node id="-10" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.289286" lon="25.083732"/>
+<node id="-11" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.288366" lon="25.084793"/>
+<way id="-12" version="1" timestamp="2008-07-25T11:12:13Z">
+<tag k="seamark:light:sector_nr" v="1"/>
+<tag k="seamark:light:object" v="light_minor"/>
+<tag k="seamark:arc_style" v="solid"/>
+<tag k="seamark:light_arc" v="white"/>
+<nd ref="-8"/>
+<nd ref="-11"/>
+<nd ref="-10"/>
+</way>
+<node id="-13" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.289286" lon="25.083732"/>
+<node id="-14" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.291666" lon="25.081608"/>
+<node id="-15" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.290615" lon="25.082449"/>
+<way id="-16" version="1" timestamp="2008-07-25T11:12:13Z">
+<tag k="seamark:light:sector_nr" v="1"/>
+<tag k="seamark:light:object" v="light_minor"/>
+<tag k="seamark:arc_style" v="dashed"/>
+<tag k="seamark:light_arc" v="white"/>
+<nd ref="-13"/>
+<nd ref="-15"/>
+<nd ref="-14"/>
+</way>
+<node id="-17" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.291666" lon="25.081608"/>
+<node id="-18" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.294299" lon="25.080044"/>
+<way id="-19" version="1" timestamp="2008-07-25T11:12:13Z">
+<nd ref="1"/>
+<nd ref="-18"/>
+<tag k="seamark:light_radial" v="1"/>
+<tag k="seamark:light:object" v="light_minor"/>
+</way>
+<node id="-20" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.293149" lon="25.080640"/>
+<way id="-21" version="1" timestamp="2008-07-25T11:12:13Z">
+<tag k="seamark:light:sector_nr" v="1"/>
+<tag k="seamark:light:object" v="light_minor"/>
+<tag k="seamark:arc_style" v="solid"/>
+<tag k="seamark:light_arc" v="white"/>
+<nd ref="-17"/>
+<nd ref="-20"/>
+<nd ref="-18"/>
+</way>
+<node id="-22" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.304166" lon="25.090804"/>
+<way id="-23" version="1" timestamp="2008-07-25T11:12:13Z">
+<nd ref="1"/>
+<nd ref="-22"/>
+<tag k="seamark:light_radial" v="2"/>
+<tag k="seamark:light:object" v="light_minor"/>
+</way>
+<node id="-24" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.306383" lon="25.093175"/>
+<node id="-25" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.305307" lon="25.091814"/>
+<node id="-26" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.306300" lon="25.093051"/>
+<way id="-27" version="1" timestamp="2008-07-25T11:12:13Z">
+<tag k="seamark:light:sector_nr" v="2"/>
+<tag k="seamark:light:object" v="light_minor"/>
+<tag k="seamark:arc_style" v="solid"/>
+<tag k="seamark:light_arc" v="red"/>
+<nd ref="-22"/>
+<nd ref="-25"/>
+<nd ref="-26"/>
+<nd ref="-24"/>
+</way>
+<node id="-28" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.306383" lon="25.093175"/>
+<node id="-29" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.307216" lon="25.094691"/>
+<node id="-30" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.307216" lon="25.094691"/>
+<node id="-31" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.307830" lon="25.096369"/>
+<node id="-32" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.307808" lon="25.096292"/>
+<way id="-33" version="1" timestamp="2008-07-25T11:12:13Z">
+<tag k="seamark:light:sector_nr" v="2"/>
+<tag k="seamark:light:object" v="light_minor"/>
+<tag k="seamark:arc_style" v="dashed"/>
+<tag k="seamark:light_arc" v="red"/>
+<nd ref="-30"/>
+<nd ref="-32"/>
+<nd ref="-31"/>
+</way>
+<node id="-34" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.310962" lon="25.094916"/>
+<way id="-35" version="1" timestamp="2008-07-25T11:12:13Z">
+<nd ref="-31"/>
+<nd ref="-34"/>
+<tag k="seamark:light_radial" v="2"/>
+<tag k="seamark:light:object" v="light_minor"/>
+</way>
+<node id="-36" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.311489" lon="25.102582"/>
+<way id="-37" version="1" timestamp="2008-07-25T11:12:13Z">
+<nd ref="1"/>
+<nd ref="-36"/>
+<tag k="seamark:light_radial" v="2"/>
+<tag k="seamark:light:object" v="light_minor"/>
+</way>
+<node id="-38" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.311419" lon="25.096958"/>
+<node id="-39" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.311643" lon="25.099063"/>
+<node id="-40" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.311629" lon="25.101186"/>
+<way id="-41" version="1" timestamp="2008-07-25T11:12:13Z">
+<tag k="seamark:light:sector_nr" v="2"/>
+<tag k="seamark:light:object" v="light_minor"/>
+<tag k="seamark:arc_style" v="solid"/>
+<tag k="seamark:light_arc" v="red"/>
+<nd ref="-34"/>
+<nd ref="-38"/>
+<nd ref="-39"/>
+<nd ref="-40"/>
+<nd ref="-36"/>
+</way>
+<node id="-42" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.302230" lon="25.103157"/>
+<node id="-43" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.302142" lon="25.103254"/>
+<way id="-44" version="1" timestamp="2008-07-25T11:12:13Z">
+<nd ref="1"/>
+<nd ref="-43"/>
+<tag k="seamark:light_radial" v="0"/>
+<tag k="seamark:light:object" v="light_minor"/>
+</way>
+<way id="-45" version="1" timestamp="2008-07-25T11:12:13Z">
+<tag k="seamark:light:sector_nr" v="0"/>
+<tag k="seamark:light:object" v="light_minor"/>
+<tag k="seamark:arc_style" v="solid"/>
+<tag k="seamark:light_arc" v="white"/>
+<nd ref="-42"/>
+<nd ref="-43"/>
+</way>
+<node id="-46" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.302142" lon="25.103254"/>
+<node id="-47" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.302051" lon="25.103347"/>
+<way id="-48" version="1" timestamp="2008-07-25T11:12:13Z">
+<tag k="seamark:light:sector_nr" v="0"/>
+<tag k="seamark:light:object" v="light_minor"/>
+<tag k="seamark:arc_style" v="solid"/>
+<tag k="seamark:light_arc" v="white"/>
+<nd ref="-46"/>
+<nd ref="-47"/>
+</way>
+<node id="-49" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.305700" lon="25.119957"/>
+<way id="-50" version="1" timestamp="2008-07-25T11:12:13Z">
+<nd ref="1"/>
+<nd ref="-49"/>
+<tag k="seamark:light_radial" v="5"/>
+<tag k="seamark:light:object" v="light_minor"/>
+</way>
+<node id="-51" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.291666" lon="25.118393"/>
+<way id="-52" version="1" timestamp="2008-07-25T11:12:13Z">
+<nd ref="1"/>
+<nd ref="-51"/>
+<tag k="seamark:light_radial" v="5"/>
+<tag k="seamark:light:object" v="light_minor"/>
+</way>
+<node id="-53" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.304107" lon="25.120583"/>
+<node id="-54" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.302473" lon="25.121003"/>
+<node id="-55" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.300815" lon="25.121212"/>
+<node id="-56" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.299148" lon="25.121210"/>
+<node id="-57" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.297490" lon="25.120996"/>
+<node id="-58" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.295857" lon="25.120571"/>
+<node id="-59" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.294265" lon="25.119941"/>
+<node id="-60" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.292731" lon="25.119112"/>
+<way id="-61" version="1" timestamp="2008-07-25T11:12:13Z">
+<tag k="seamark:light:sector_nr" v="5"/>
+<tag k="seamark:light:object" v="light_minor"/>
+<tag k="seamark:arc_style" v="solid"/>
+<tag k="seamark:light_arc" v="red"/>
+<nd ref="-49"/>
+<nd ref="-53"/>
+<nd ref="-54"/>
+<nd ref="-55"/>
+<nd ref="-56"/>
+<nd ref="-57"/>
+<nd ref="-58"/>
+<nd ref="-59"/>
+<nd ref="-60"/>
+<nd ref="-51"/>
+</way>
+<node id="-62" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.305682" lon="25.119897"/>
+<node id="-63" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.291691" lon="25.118337"/>
+<node id="-64" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.304090" lon="25.120523"/>
+<node id="-65" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.302456" lon="25.120941"/>
+<node id="-66" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.300797" lon="25.121150"/>
+<node id="-67" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.299130" lon="25.121145"/>
+<node id="-68" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.297473" lon="25.120928"/>
+<node id="-69" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.295840" lon="25.120500"/>
+<node id="-70" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.294249" lon="25.119866"/>
+<node id="-71" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.292717" lon="25.119032"/>
+<way id="-72" version="1" timestamp="2008-07-25T11:12:13Z">
+<tag k="seamark:light:sector_nr" v="5"/>
+<tag k="seamark:light:object" v="light_minor"/>
+<tag k="seamark:arc_style" v="solid"/>
+<tag k="seamark:light_arc_al1" v="green"/>
+<nd ref="-62"/>
+<nd ref="-64"/>
+<nd ref="-65"/>
+<nd ref="-66"/>
+<nd ref="-67"/>
+<nd ref="-68"/>
+<nd ref="-69"/>
+<nd ref="-70"/>
+<nd ref="-71"/>
+<nd ref="-63"/>
+</way>
+<node id="-73" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.305663" lon="25.119827"/>
+<node id="-74" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.291720" lon="25.118273"/>
+<node id="-75" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.304070" lon="25.120452"/>
+<node id="-76" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.302436" lon="25.120870"/>
+<node id="-77" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.300777" lon="25.121077"/>
+<node id="-78" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.299110" lon="25.121069"/>
+<node id="-79" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.297452" lon="25.120849"/>
+<node id="-80" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.295821" lon="25.120417"/>
+<node id="-81" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.294231" lon="25.119778"/>
+<node id="-82" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.292700" lon="25.118939"/>
+<way id="-83" version="1" timestamp="2008-07-25T11:12:13Z">
+<tag k="seamark:light:sector_nr" v="5"/>
+<tag k="seamark:light:object" v="light_minor"/>
+<tag k="seamark:arc_style" v="solid"/>
+<tag k="seamark:light_arc_al2" v="green"/>
+<nd ref="-73"/>
+<nd ref="-75"/>
+<nd ref="-76"/>
+<nd ref="-77"/>
+<nd ref="-78"/>
+<nd ref="-79"/>
+<nd ref="-80"/>
+<nd ref="-81"/>
+<nd ref="-82"/>
+<nd ref="-74"/>
+</way>
+<node id="-84" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.305611" lon="25.119648"/>
+<node id="-85" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.291795" lon="25.118107"/>
+<node id="-86" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.304018" lon="25.120272"/>
+<node id="-87" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.302384" lon="25.120687"/>
+<node id="-88" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.300724" lon="25.120888"/>
+<node id="-89" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.299058" lon="25.120874"/>
+<node id="-90" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.297401" lon="25.120645"/>
+<node id="-91" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.295771" lon="25.120202"/>
+<node id="-92" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.294184" lon="25.119552"/>
+<node id="-93" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.292658" lon="25.118699"/>
+<way id="-94" version="1" timestamp="2008-07-25T11:12:13Z">
+<tag k="seamark:light:sector_nr" v="5"/>
+<tag k="seamark:light:object" v="light_minor"/>
+<tag k="seamark:arc_style" v="solid"/>
+<tag k="seamark:light_arc_al3" v="green"/>
+<nd ref="-84"/>
+<nd ref="-86"/>
+<nd ref="-87"/>
+<nd ref="-88"/>
+<nd ref="-89"/>
+<nd ref="-90"/>
+<nd ref="-91"/>
+<nd ref="-92"/>
+<nd ref="-93"/>
+<nd ref="-85"/>
+</way>
+<node id="-95" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.305583" lon="25.119548"/>
+<node id="-96" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.291837" lon="25.118016"/>
+<node id="-97" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.303990" lon="25.120172"/>
+<node id="-98" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.302355" lon="25.120585"/>
+<node id="-99" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.300695" lon="25.120784"/>
+<node id="-100" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.299029" lon="25.120766"/>
+<node id="-101" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.297372" lon="25.120531"/>
+<node id="-102" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.295743" lon="25.120083"/>
+<node id="-103" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.294158" lon="25.119425"/>
+<node id="-104" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.292635" lon="25.118565"/>
+<way id="-105" version="1" timestamp="2008-07-25T11:12:13Z">
+<tag k="seamark:light:sector_nr" v="5"/>
+<tag k="seamark:light:object" v="light_minor"/>
+<tag k="seamark:arc_style" v="solid"/>
+<tag k="seamark:light_arc_al4" v="green"/>
+<nd ref="-95"/>
+<nd ref="-97"/>
+<nd ref="-98"/>
+<nd ref="-99"/>
+<nd ref="-100"/>
+<nd ref="-101"/>
+<nd ref="-102"/>
+<nd ref="-103"/>
+<nd ref="-104"/>
+<nd ref="-96"/>
+</way>
+<node id="-106" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.297499" lon="25.105518"/>
+<way id="-107" version="1" timestamp="2008-07-25T11:12:13Z">
+<nd ref="1"/>
+<nd ref="-106"/>
+<tag k="seamark:light_radial" v="3"/>
+<tag k="seamark:light:object" v="light_minor"/>
+</way>
+<node id="-108" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.295018" lon="25.100556"/>
+<node id="-109" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.296815" lon="25.104912"/>
+<node id="-110" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.296219" lon="25.104170"/>
+<node id="-111" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.295728" lon="25.103312"/>
+<node id="-112" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.295355" lon="25.102362"/>
+<node id="-113" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.295112" lon="25.101347"/>
+<way id="-114" version="1" timestamp="2008-07-25T11:12:13Z">
+<tag k="seamark:light:sector_nr" v="3"/>
+<tag k="seamark:light:object" v="light_minor"/>
+<tag k="seamark:arc_style" v="solid"/>
+<tag k="seamark:light_arc" v="green"/>
+<nd ref="-106"/>
+<nd ref="-109"/>
+<nd ref="-110"/>
+<nd ref="-111"/>
+<nd ref="-112"/>
+<nd ref="-113"/>
+<nd ref="-108"/>
+</way>
+<node id="-115" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.295018" lon="25.100556"/>
+<node id="-116" version="1" timestamp="2008-07-25T11:12:13Z" lat="38.295301" lon="25.097821"/>
+<way id="-117" version="1" timestamp="2008-07-25T11:12:13Z">
+<nd ref="1"/>
+<nd ref="-116"/>
+<tag k="seamark:light_radial" v="3"/>
+<tag k="seamark:light:object" v="light_minor"/>
+</way>
+</osm>
@@ -0,0 +1,10 @@
+"done":true
+"input_bytes":2358
+"generated_ids":117
+"elements":34
+"nodes":1
+"seamarks":1
+"sectors":6
+"generated_nodes":90
+"generated_ways":27
+"features":0
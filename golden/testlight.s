@@ -0,0 +1,21 @@
+lights 1 sectors 6 subsectors 13
+light 1 38.2999992 25.1000004 6
+sector 1 4 25.00 35.00 - - red - 0 1
+frac 1 4 1.50 25.00 35.00 1 red 1 1
+sector 1 1 40.00 70.00 - - white - 0 3
+frac 1 1 1.00 40.00 50.00 1 white 1 0
+frac 1 1 1.00 50.00 60.00 3 white 0 0
+frac 1 1 1.00 60.00 70.00 1 white 0 1
+sector 1 2 120.00 190.00 - - red - 0 4
+frac 1 2 0.50 120.00 140.00 1 red 1 0
+frac 1 2 0.50 140.00 150.00 2 red 0 0
+frac 1 2 0.50 150.00 160.00 3 red 0 0
+frac 1 2 0.70 160.00 190.00 1 red 0 1
+sector 1 0 230.00 230.00 230.00 - white - 1 2
+frac 1 0 0.20 228.00 230.00 1 white 0 1
+frac 1 0 0.20 230.00 232.00 1 white 0 0
+sector 1 5 250.00 300.00 - - red green 0 1
+frac 1 5 1.00 250.00 300.00 1 red 1 1
+sector 1 3 300.00 380.00 - - green - 0 2
+frac 1 3 0.30 300.00 355.00 1 green 1 0
+frac 1 3 0.30 355.00 380.00 2 green 0 1
@@ -0,0 +1,80 @@
+/* Copyright 2011 Bernhard R. Fischer, 2048R/5C5FFD47 <bf@abenteuerland.at>
+ *
+ * This file is part of smfilter.
+ *
+ * Smfilter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * Smfilter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with smfilter. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! This is an example of the event API of libhpxml. It reads an OSM file
+ *  on stdin and counts the nodes, the tags, and the attributes of both.
+ *  It is linked against the static library, e.g.
+ *
+ *     make hpxcount && ./hpxcount < testlight.osm
+ *
+ *  @author Bernhard R. Fischer
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libhpxml.h"
+
+
+struct count
+{
+   long nodes, tags, attrs;
+};
+
+
+static int node_open(int id, const hpx_tag_t *t, void *p)
+{
+   struct count *c = p;
+
+   c->nodes++;
+   c->attrs += t->nattr;
+   return 0;
+}
+
+
+static int tag_open(int id, const hpx_tag_t *t, void *p)
+{
+   struct count *c = p;
+
+   c->tags++;
+   c->attrs += t->nattr;
+   return 0;
+}
+
+
+int main(int argc, char *argv[])
+{
+   struct count c = {0, 0, 0};
+   hpx_ctrl_t *ctl;
+   hpx_sax_t *s;
+
+   if ((ctl = hpx_init(0, HPX_BUF_SIZE)) == NULL)
+      perror("hpx_init"), exit(EXIT_FAILURE);
+   if ((s = hpx_sax_new(&c)) == NULL)
+      perror("hpx_sax_new"), exit(EXIT_FAILURE);
+
+   if (hpx_sax_reg(s, "node", node_open, NULL) == -1 || hpx_sax_reg(s, "tag", tag_open, NULL) == -1)
+      perror("hpx_sax_reg"), exit(EXIT_FAILURE);
+
+   if (hpx_sax_parse(s, ctl) == -1)
+      perror("hpx_sax_parse"), exit(EXIT_FAILURE);
+
+   printf("nodes %ld\ntags %ld\nattributes %ld\n", c.nodes, c.tags, c.attrs);
+
+   hpx_sax_free(s);
+   hpx_free(ctl);
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,215 @@
+/* Copyright 2011 Bernhard R. Fischer, 2048R/5C5FFD47 <bf@abenteuerland.at>
+ *
+ * This file is part of smfilter.
+ *
+ * Smfilter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * Smfilter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with smfilter. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! This file implements an ordered job queue. Jobs are processed in parallel
+ *  by a pool of threads but they are returned to the caller in exactly the
+ *  order in which they were submitted. This is used to decode and encode
+ *  file blocks in parallel while the stream itself stays sequential.
+ *
+ *  @author Bernhard R. Fischer
+ */
+#include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "jobq.h"
+
+
+struct jobq
+{
+   //! job function
+   void (*func)(void*);
+   pthread_mutex_t mtx;
+   //! signalled if a new job is available
+   pthread_cond_t work;
+   //! signalled if a job was finished
+   pthread_cond_t done;
+   //! ring of jobs
+   void *job[JQ_MAX];
+   //! flag per job set if it was processed
+   char fin[JQ_MAX];
+   //! index of oldest job
+   int head;
+   //! number of jobs in ring
+   int cnt;
+   //! number of jobs already taken by a thread (counted from head)
+   int taken;
+   //! flag to terminate threads
+   int quit;
+   int nthreads;
+   pthread_t thread[];
+};
+
+
+static void *jq_thread(void *p)
+{
+   jobq_t *jq = p;
+   int i;
+
+   pthread_mutex_lock(&jq->mtx);
+   for (;;)
+   {
+      while (jq->taken == jq->cnt && !jq->quit)
+         pthread_cond_wait(&jq->work, &jq->mtx);
+      if (jq->quit)
+         break;
+
+      i = (jq->head + jq->taken) % JQ_MAX;
+      jq->taken++;
+      pthread_mutex_unlock(&jq->mtx);
+
+      jq->func(jq->job[i]);
+
+      pthread_mutex_lock(&jq->mtx);
+      jq->fin[i] = 1;
+      pthread_cond_broadcast(&jq->done);
+   }
+   pthread_mutex_unlock(&jq->mtx);
+
+   return NULL;
+}
+
+
+/*! Create a job queue.
+ *  @param nthreads Number of worker threads. If it is 0, jobs are processed
+ *  synchronously within jq_submit().
+ *  @param func Function which is called for each job.
+ *  @return Pointer to job queue or NULL in case of error with errno set.
+ */
+jobq_t *jq_init(int nthreads, void (*func)(void*))
+{
+   jobq_t *jq;
+   int e;
+
+   if ((jq = calloc(1, sizeof(*jq) + nthreads * sizeof(pthread_t))) == NULL)
+      return NULL;
+
+   jq->func = func;
+   pthread_mutex_init(&jq->mtx, NULL);
+   pthread_cond_init(&jq->work, NULL);
+   pthread_cond_init(&jq->done, NULL);
+
+   for (; jq->nthreads < nthreads; jq->nthreads++)
+      if ((e = pthread_create(&jq->thread[jq->nthreads], NULL, jq_thread, jq)))
+      {
+         jq_free(jq);
+         errno = e;
+         return NULL;
+      }
+
+   return jq;
+}
+
+
+/*! Terminate all threads and free the job queue. Jobs still pending are not
+ *  returned, thus the caller must free them itself.
+ */
+void jq_free(jobq_t *jq)
+{
+   int i;
+
+   pthread_mutex_lock(&jq->mtx);
+   jq->quit = 1;
+   pthread_cond_broadcast(&jq->work);
+   pthread_mutex_unlock(&jq->mtx);
+
+   for (i = 0; i < jq->nthreads; i++)
+      pthread_join(jq->thread[i], NULL);
+
+   pthread_cond_destroy(&jq->done);
+   pthread_cond_destroy(&jq->work);
+   pthread_mutex_destroy(&jq->mtx);
+   free(jq);
+}
+
+
+/*! Append a job to the queue.
+ *  @return 0 on success or -1 if the queue is full (errno = EAGAIN).
+ */
+int jq_submit(jobq_t *jq, void *job)
+{
+   int i;
+
+   if (jq->cnt >= JQ_MAX)
+   {
+      errno = EAGAIN;
+      return -1;
+   }
+
+   if (!jq->nthreads)
+   {
+      i = (jq->head + jq->cnt) % JQ_MAX;
+      jq->job[i] = job;
+      jq->func(job);
+      jq->fin[i] = 1;
+      jq->cnt++;
+      jq->taken++;
+      return 0;
+   }
+
+   pthread_mutex_lock(&jq->mtx);
+   i = (jq->head + jq->cnt) % JQ_MAX;
+   jq->job[i] = job;
+   jq->fin[i] = 0;
+   jq->cnt++;
+   pthread_cond_signal(&jq->work);
+   pthread_mutex_unlock(&jq->mtx);
+
+   return 0;
+}
+
+
+/*! Wait for the oldest job to be finished and remove it from the queue.
+ *  @return Pointer to job or NULL if the queue is empty.
+ */
+void *jq_next(jobq_t *jq)
+{
+   void *job;
+
+   pthread_mutex_lock(&jq->mtx);
+   if (!jq->cnt)
+   {
+      pthread_mutex_unlock(&jq->mtx);
+      return NULL;
+   }
+
+   while (!jq->fin[jq->head])
+      pthread_cond_wait(&jq->done, &jq->mtx);
+
+   job = jq->job[jq->head];
+   jq->head = (jq->head + 1) % JQ_MAX;
+   jq->cnt--;
+   jq->taken--;
+   pthread_mutex_unlock(&jq->mtx);
+
+   return job;
+}
+
+
+/*! @return Number of jobs submitted but not yet returned by jq_next().
+ */
+int jq_pending(const jobq_t *jq)
+{
+   return jq->cnt;
+}
+
+
+int jq_threads(const jobq_t *jq)
+{
+   return jq->nthreads;
+}
+
@@ -0,0 +1,36 @@
+/* Copyright 2011 Bernhard R. Fischer, 2048R/5C5FFD47 <bf@abenteuerland.at>
+ *
+ * This file is part of smfilter.
+ *
+ * Smfilter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * Smfilter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with smfilter. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef JOBQ_H
+#define JOBQ_H
+
+//! maximum number of jobs in flight
+#define JQ_MAX 64
+
+
+typedef struct jobq jobq_t;
+
+
+jobq_t *jq_init(int nthreads, void (*func)(void*));
+void jq_free(jobq_t *jq);
+int jq_submit(jobq_t *jq, void *job);
+void *jq_next(jobq_t *jq);
+int jq_pending(const jobq_t *jq);
+int jq_threads(const jobq_t *jq);
+
+#endif
+
@@ -15,6 +15,7 @@
  * along with libhpxml. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <limits.h>
@@ -29,12 +30,40 @@
 #include "libhpxml.h"
 
 
-static long hpx_lineno_;
+/*! Count newlines between p and e. This uses memchr() which is vectorized
+ *  by the C library.
+ */
+static long hpx_count_lines(const char *p, const char *e)
+{
+   long n = 0;
+
+   for (; (p = memchr(p, '\n', e - p)) != NULL; p++)
+      n++;
+   return n;
+}
 
 
-long hpx_lineno(void)
+/*! Return line number of file offset off. Lines are not counted while
+ *  parsing, they are counted from the last requested offset on demand. Thus,
+ *  it is cheap if offsets are requested in ascending order. With buffered
+ *  input this works only for data within the buffer unless ctl->lines is set
+ *  which lets the data be counted on refills.
+ *  @return Line number or 0 if it is unknown.
+ */
+long hpx_lineno(hpx_ctrl_t *ctl, long off)
 {
-   return hpx_lineno_;
+   const char *b = ctl->buf.buf - ctl->off;
+
+   // lines of data which was discarded from the buffer are unknown
+   if (ctl->lno_off < ctl->off || off < ctl->off || off > ctl->off + ctl->buf.len)
+      return 0;
+
+   if (off < ctl->lno_off)
+      return ctl->lno - hpx_count_lines(b + off, b + ctl->lno_off);
+
+   ctl->lno += hpx_count_lines(b + ctl->lno_off, b + off);
+   ctl->lno_off = off;
+   return ctl->lno;
 }
 
 
@@ -42,7 +71,7 @@ long hpx_lineno(void)
  *  @param b Pointer to bstring.
  *  @return Number of remaining characters in b.
  */
-int skip_bblank(bstring_t *b)
+long skip_bblank(bstring_t *b)
 {
    for (; isspace(*b->buf) && b->len; bs_advance(b));
    return b->len;
@@ -65,12 +94,37 @@ hpx_tag_t *hpx_tm_create(int n)
 }
 
 
+static void hpx_bs_reloc(bstring_t *b, const char *lo, const char *hi, char *to)
+{
+   if (b->buf >= lo && b->buf < hi)
+      b->buf = to + (b->buf - lo);
+}
+
+
+/*! Move the strings of a tag which point into the range [lo, hi[ to the
+ *  same position relative to to. This is used to adjust tags after the data
+ *  of the buffer was moved or the buffer was reallocated. Other strings are
+ *  not changed.
+ */
+void hpx_tm_reloc(hpx_tag_t *t, const char *lo, const char *hi, char *to)
+{
+   int i;
+
+   hpx_bs_reloc(&t->tag, lo, hi, to);
+   for (i = 0; i < t->nattr; i++)
+   {
+      hpx_bs_reloc(&t->attr[i].name, lo, hi, to);
+      hpx_bs_reloc(&t->attr[i].value, lo, hi, to);
+   }
+}
+
+
 /*!
  *  @param b Pointer to bstring buffer which should be parsed.
  *  @param n Destination bstring.
  *  @return number of valid characters found.
  */
-int hpx_parse_name(bstring_t *b, bstring_t *n)
+long hpx_parse_name(bstring_t *b, bstring_t *n)
 {
    if (!IS_XML1CHAR(*b->buf))
       return 0;
@@ -270,7 +324,6 @@ int cblank(char *c)
    switch (*c)
    {
       case '\n':
-         hpx_lineno_++;
       case '\t':
       case '\r':
 #ifdef MODMEM
@@ -293,7 +346,6 @@ int cblank1(const char *c)
    switch (*c)
    {
       case '\n':
-         hpx_lineno_++;
       case '\t':
       case '\r':
       case ' ':
@@ -310,9 +362,10 @@ int cblank1(const char *c)
  *  @return Lendth of tag content including '<' and '>'. If return value > len,
  *  the tag is unclosed.
  */
-int count_tag(bstringl_t b)
+long count_tag(bstring_t b)
 {
-   int i, c = 0;
+   long i;
+   int c = 0;
 
    if ((b.len >= 7) && !strncmp(b.buf + 1, "!--", 3))
       c = 1;
@@ -340,9 +393,9 @@ int count_tag(bstringl_t b)
  *  @param nbc Pointer to integer which counts non-blank characters.
  *  @return Length of literal. Return value == len if literal is unclosed.
  */
-int count_literal(bstringl_t b, int *nbc)
+long count_literal(bstring_t b, long *nbc)
 {
-   int i, t;
+   long i, t;
 
    if (nbc != NULL)
       *nbc = 0;
@@ -364,18 +417,14 @@ int count_literal(bstringl_t b, int *nbc)
 /*! Parse XML element into bstring.
  *  @param ctl Hpx control structure.
  *  @param b Pointer to bstring.
- *  @param lno Pointer to integer which will receive the line number of the
- *  element. lno may be NULL.
  *  @return Length of element or -1 if element is unclosed.
  */
-int hpx_proc_buf(hpx_ctrl_t *ctl, bstringl_t *b, long *lno)
+long hpx_proc_buf(hpx_ctrl_t *ctl, bstring_t *b)
 {
-   int i, s, n;
+   long i, s, n;
 
    if (ctl->in_tag)
    {
-      if (lno != NULL)
-         *lno = hpx_lineno_;
       s = count_tag(*b);
       if (s > b->len)
          return -1;
@@ -385,12 +434,10 @@ int hpx_proc_buf(hpx_ctrl_t *ctl, bstringl_t *b, long *lno)
    {
       // skip leading white spaces
       for (i = 0; i < b->len && !cblank(b->buf); i++)
-         bs_advancel(b);
+         bs_advance(b);
       if (i == b->len)
          return -1;
 
-      if (lno != NULL)
-         *lno = hpx_lineno_;
       s = count_literal(*b, &n);
       // check if literal had no end tag (i.e. '<')
       if (s == b->len)
@@ -413,6 +460,55 @@ int hpx_buf_reader(int fd, char *buf, int buflen)
 }
 */
 
+
+/*! Allocate input buffer. If available, it is backed by huge pages which
+ *  reduces TLB misses when scanning large buffers.
+ *  @return Pointer to buffer or NULL on error.
+ */
+static char *hpx_buf_alloc(long len)
+{
+#if defined(WITH_MMAP) && defined(MADV_HUGEPAGE)
+   char *buf;
+
+   if ((buf = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED)
+      return NULL;
+   (void) madvise(buf, len, MADV_HUGEPAGE);
+   return buf;
+#else
+   return malloc(len);
+#endif
+}
+
+
+static void hpx_buf_free(char *buf, long len)
+{
+#if defined(WITH_MMAP) && defined(MADV_HUGEPAGE)
+   (void) munmap(buf, len);
+#else
+   free(buf);
+#endif
+}
+
+
+/*! Double the size of the input buffer. The data is copied into the new
+ *  buffer, thus pointers into the buffer have to be adjusted (see
+ *  hpx_tm_reloc()).
+ *  @return 0 on success, -1 on error.
+ */
+static int hpx_grow(hpx_ctrl_t *ctl)
+{
+   char *buf;
+
+   if ((buf = hpx_buf_alloc(ctl->len * 2)) == NULL)
+      return -1;
+
+   memcpy(buf, ctl->buf.buf, ctl->buf.len);
+   hpx_buf_free(ctl->buf.buf, ctl->len);
+   ctl->buf.buf = buf;
+   ctl->len *= 2;
+   return 0;
+}
+
 /*!
  *  @param fd Input file descriptor.
  *  @param len Read buffer length. If len is negative, the file is memory
@@ -427,13 +523,14 @@ hpx_ctrl_t *hpx_init(int fd, long len)
 {
    hpx_ctrl_t *ctl;
 
-   if ((ctl = malloc(sizeof(*ctl) + (len < 0 ? 0 : len))) == NULL)
+   if ((ctl = malloc(sizeof(*ctl))) == NULL)
       return NULL;
 
    memset(ctl, 0, sizeof(*ctl));
    ctl->fd = fd;
+   ctl->keep = -1;
    // init line counter
-   hpx_lineno_ = 1;
+   ctl->lno = 1;
 
    if (len < 0)
    {
@@ -461,7 +558,11 @@ hpx_ctrl_t *hpx_init(int fd, long len)
 #endif
    }
 
-   ctl->buf.buf = (char*) (ctl + 1);
+   if ((ctl->buf.buf = hpx_buf_alloc(len)) == NULL)
+   {
+      free(ctl);
+      return NULL;
+   }
    ctl->len = len;
    ctl->empty = 1;
 
@@ -475,11 +576,60 @@ void hpx_free(hpx_ctrl_t *ctl)
    if (ctl->mmap)
       // FIXME returned code should be checked
       (void) munmap(ctl->buf.buf, ctl->len);
+   else
 #endif
+      hpx_buf_free(ctl->buf.buf, ctl->len);
    free(ctl);
 }
 
 
+/*! Move the unprocessed data to the beginning of the buffer and read new
+ *  data from the file into the remaining space. Data from the offset set with
+ *  hpx_keep() on is moved as well. If no space is left, the buffer is
+ *  enlarged.
+ *  @return Number of bytes read, 0 on eof, or -1 on error.
+ */
+static long hpx_fill(hpx_ctrl_t *ctl)
+{
+   long s, k = ctl->pos;
+
+   // count lines of data which is discarded
+   if (ctl->lines)
+      (void) hpx_lineno(ctl, ctl->off + k);
+
+   if (ctl->keep >= ctl->off && ctl->keep - ctl->off < k)
+      k = ctl->keep - ctl->off;
+
+   // grow buffer if the remaining data fills it, i.e. the element is too long
+   if (ctl->buf.len - k >= ctl->len && hpx_grow(ctl) == -1)
+      return -1;
+
+   // move remaining data to the beginning of the buffer
+   ctl->buf.len -= k;
+   memmove(ctl->buf.buf, ctl->buf.buf + k, ctl->buf.len);
+   ctl->off += k;
+   ctl->pos -= k;
+
+   // read new data from file
+   for (;;)
+   {
+      if ((s = read(ctl->fd, ctl->buf.buf + ctl->buf.len, ctl->len - ctl->buf.len)) != -1)
+         break;
+
+      if (errno != EINTR)
+         return -1;
+   }
+
+   if (!s)
+      ctl->eof = 1;
+
+   // adjust position pointers
+   ctl->buf.len += s;
+   ctl->nfill++;
+   return s;
+}
+
+
 /*!
  *  @param ctl Pointer to valid hpx_ctrl_t structure.
  *  @param b Pointer to bstring_t. This structure will be filled out by this
@@ -487,12 +637,13 @@ void hpx_free(hpx_ctrl_t *ctl)
  *  @param in_tag is set to 1 or 0, either it is a tag or not. It is optional
  *  and may be NULL.
  *  @param lno Pointer to integer which will contain the starting line number
- *  of b. lno may be NULL.
+ *  of b. lno may be NULL. Lines are counted just if lno is not NULL (see
+ *  hpx_lineno()).
  *  @return Length of element (always >= 1) if everything is ok. b will contain
  *  a valid bstring to the element. -1 is returned in case of error. On eof, 0
  *  is returned.
  */
-long hpx_get_eleml(hpx_ctrl_t *ctl, bstringl_t *b, int *in_tag, long *lno)
+long hpx_get_elem(hpx_ctrl_t *ctl, bstring_t *b, int *in_tag, long *lno)
 {
    long s;
 
@@ -522,32 +673,9 @@ long hpx_get_eleml(hpx_ctrl_t *ctl, bstringl_t *b, int *in_tag, long *lno)
       if (ctl->empty)
       {
          if (ctl->mmap)
-         {
             ctl->eof = 1;
-         }
-         else
-         {
-            // move remaining data to the beginning of the buffer
-            ctl->buf.len -= ctl->pos;
-            memmove(ctl->buf.buf, ctl->buf.buf + ctl->pos, ctl->buf.len);
-            ctl->pos = 0;
-
-            // read new data from file
-            for (;;)
-            {
-               if ((s = read(ctl->fd, ctl->buf.buf + ctl->buf.len, ctl->len - ctl->buf.len)) != -1)
-                  break;
-
-               if (errno != EINTR)
-                  return -1;
-            }
-
-            if (!s)
-               ctl->eof = 1;
-
-            // adjust position pointers
-            ctl->buf.len += s;
-         }
+         else if (hpx_fill(ctl) == -1)
+            return -1;
          ctl->empty = 0;
       }
 
@@ -559,8 +687,10 @@ long hpx_get_eleml(hpx_ctrl_t *ctl, bstringl_t *b, int *in_tag, long *lno)
       b->buf = ctl->buf.buf + ctl->pos;
       b->len = ctl->buf.len - ctl->pos;
 
-      if ((s = hpx_proc_buf(ctl, b, lno)) >= 0)
+      if ((s = hpx_proc_buf(ctl, b)) >= 0)
       {
+         if (lno != NULL)
+            *lno = hpx_lineno(ctl, ctl->off + (b->buf - ctl->buf.buf));
          if (in_tag != NULL)
             *in_tag = ctl->in_tag;
 
@@ -582,56 +712,184 @@ long hpx_get_eleml(hpx_ctrl_t *ctl, bstringl_t *b, int *in_tag, long *lno)
 }
 
 
-int hpx_get_elem(hpx_ctrl_t *ctl, bstring_t *b, int *in_tag, long *lno)
+/*! Return file offset of the next element. If the previous element was a
+ *  tag, this is the offset of the byte following its '>'.
+ */
+long hpx_tell(const hpx_ctrl_t *ctl)
 {
-   long e;
-   bstringl_t bl;
+   return ctl->off + ctl->pos;
+}
 
-   if ((e = hpx_get_eleml(ctl, &bl, in_tag, lno)) == -1)
-      return -1;
 
-   if (bl.len > INT_MAX)
+/*! Keep the data from file offset off on in the buffer if it is refilled.
+ *  Elements which start at or after off are still available afterwards but
+ *  they are moved within the buffer or into a larger buffer, thus pointers
+ *  to them have to be adjusted with hpx_tm_reloc() if ctl->off or
+ *  ctl->buf.buf changed. Keeping is disabled by setting off to -1.
+ */
+void hpx_keep(hpx_ctrl_t *ctl, long off)
+{
+   ctl->keep = off;
+}
+
+
+/*! Continue reading at file offset pos. This works only if the file is
+ *  memory mapped. pos must point to the beginning of a tag (or to
+ *  whitespace in front of it).
+ *  @param lno Line number at pos.
+ *  @return 0 on success, -1 on error with errno set.
+ */
+int hpx_seek(hpx_ctrl_t *ctl, long pos, long lno)
+{
+   if (!ctl->mmap || pos < 0 || pos > ctl->len)
    {
-      errno = ERANGE;
+      errno = EINVAL;
       return -1;
    }
 
-   b->len = bl.len;
-   b->buf = bl.buf;
-   return e;
+#ifdef WITH_MMAP
+   // pages are accessed randomly now, thus stop read-ahead of blocks
+   if (ctl->madv_ptr != ctl->buf.buf + ctl->len)
+   {
+      madvise(ctl->buf.buf, ctl->len, MADV_RANDOM);
+      ctl->madv_ptr = ctl->buf.buf + ctl->len;
+   }
+#endif
+
+   ctl->pos = pos;
+   ctl->in_tag = 0;
+   ctl->eof = 0;
+   ctl->keep = -1;
+   ctl->lno = lno;
+   ctl->lno_off = pos;
+
+   return 0;
+}
+
+
+/*! Skip forward to the next occurrence of one of the strings in pat without
+ *  parsing the data in between. The position is set to the first byte of
+ *  the string found, thus it should be the beginning of a tag (e.g. "<node")
+ *  and the current position must not be inside of a tag. This is intended
+ *  to pass over large uninteresting parts of a file quickly.
+ *  @param pat NULL-terminated list of strings.
+ *  @return 0 if a string was found, -1 on error or if none of the strings is
+ *  found until eof.
+ */
+int hpx_skip(hpx_ctrl_t *ctl, const char *const *pat)
+{
+   const char *p, *q, *e;
+   size_t n, m;
+   int i;
+
+   for (m = 1, i = 0; pat[i] != NULL; i++)
+      if ((n = strlen(pat[i])) > m)
+         m = n;
+
+   for (;;)
+   {
+      e = ctl->buf.buf + ctl->buf.len;
+      for (p = NULL, i = 0; pat[i] != NULL; i++)
+         if ((q = memmem(ctl->buf.buf + ctl->pos, (p != NULL ? p : e) - (ctl->buf.buf + ctl->pos), pat[i], strlen(pat[i]))) != NULL)
+            p = q;
+
+      if (p != NULL)
+         break;
+
+      // keep the tail of the buffer, it may contain the beginning of a string
+      p = ctl->buf.len - ctl->pos >= (long) m ? e - m + 1 : ctl->buf.buf + ctl->pos;
+      ctl->pos = p - ctl->buf.buf;
+
+      if (ctl->mmap || ctl->eof)
+         return -1;
+      if (hpx_fill(ctl) == -1)
+         return -1;
+      ctl->empty = 0;
+   }
+
+   ctl->pos = p - ctl->buf.buf;
+   ctl->in_tag = 0;
+
+#ifdef WITH_MMAP
+   // continue read-ahead at the new position
+   if (ctl->mmap && ctl->pg_blk_siz)
+      ctl->madv_ptr = ctl->buf.buf + ctl->pos / ctl->pg_blk_siz * ctl->pg_blk_siz;
+#endif
+
+   return 0;
+}
+
+
+/*! Return pointer to the data at file offset off if all len bytes are still
+ *  within the buffer. This is always true if the file is memory mapped.
+ *  @return Pointer to data or NULL.
+ */
+const char *hpx_buf_at(const hpx_ctrl_t *ctl, long off, long len)
+{
+   if (off < ctl->off || len < 0 || off + len > ctl->off + ctl->buf.len)
+      return NULL;
+   return ctl->buf.buf + off - ctl->off;
+}
+
+
+/*! Write bstring b to f, preceded by the string lead.
+ *  @return Number of bytes written or -1 on error.
+ */
+static long hpx_fwrite_bs(FILE *f, const char *lead, bstring_t b)
+{
+   if (fputs(lead, f) == EOF || (b.len > 0 && fwrite(b.buf, b.len, 1, f) != 1))
+      return -1;
+   return strlen(lead) + b.len;
 }
 
 
 int hpx_fprintf_attr(FILE *f, const hpx_attr_t *a, const char *lead)
 {
+   char eq[] = {'=', a->delim, '\0'};
+   long n, m;
+
    //FIXME: escaping of ['"] missing
-   return fprintf(f, "%s%.*s=%c%.*s%c", lead == NULL ? "" : lead, a->name.len,
-         a->name.buf, a->delim, a->value.len, a->value.buf, a->delim);
+   if ((n = hpx_fwrite_bs(f, lead == NULL ? "" : lead, a->name)) == -1 ||
+         (m = hpx_fwrite_bs(f, eq, a->value)) == -1 || fputc(a->delim, f) == EOF)
+      return -1;
+   return n + m + 1;
 }
 
 int hpx_fprintf_tag(FILE *f, const hpx_tag_t *p)
 {
-   int i, n;
+   int i, n, m;
    char *s = "";
 
    switch (p->type)
    {
       case HPX_CLOSE:
-         return fprintf(f, "</%.*s>\n", p->tag.len, p->tag.buf);
+         if ((n = hpx_fwrite_bs(f, "</", p->tag)) == -1 || fputs(">\n", f) == EOF)
+            return -1;
+         return n + 2;
 
       case HPX_SINGLE:
          s = "/";
       case HPX_OPEN:
-         n = fprintf(f, "<%.*s", p->tag.len, p->tag.buf);
+         if ((n = hpx_fwrite_bs(f, "<", p->tag)) == -1)
+            return -1;
          for (i = 0; i < p->nattr; i++)
-            n += hpx_fprintf_attr(f, &p->attr[i], " ");
-         return n + fprintf(f, "%s>\n", s);
+         {
+            if ((m = hpx_fprintf_attr(f, &p->attr[i], " ")) == -1)
+               return -1;
+            n += m;
+         }
+         return (m = fprintf(f, "%s>\n", s)) < 0 ? -1 : n + m;
 
       case HPX_INSTR:
-         n = fprintf(f, "<?%.*s", p->tag.len, p->tag.buf);
+         if ((n = hpx_fwrite_bs(f, "<?", p->tag)) == -1)
+            return -1;
          for (i = 0; i < p->nattr; i++)
-            n += hpx_fprintf_attr(f, &p->attr[i], " ");
-         return n + fprintf(f, "?>\n");
+         {
+            if ((m = hpx_fprintf_attr(f, &p->attr[i], " ")) == -1)
+               return -1;
+            n += m;
+         }
+         return (m = fprintf(f, "?>\n")) < 0 ? -1 : n + m;
  
    }
    return 0;
@@ -660,3 +918,200 @@ int hpx_tree_resize(hpx_tree_t **tl, int n)
    return t->msub;
 }
 
+
+/*! Create the control structure of the event API. Tag names are registered
+ *  with hpx_sax_reg() and the input is parsed with hpx_sax_parse().
+ *  @param p User pointer which is passed to the handlers.
+ *  @return Pointer to structure or NULL on error.
+ */
+hpx_sax_t *hpx_sax_new(void *p)
+{
+   hpx_sax_t *s;
+
+   if ((s = calloc(1, sizeof(*s))) == NULL)
+      return NULL;
+
+   if ((s->t = hpx_tm_create(HPX_SAX_MATTR)) == NULL)
+   {
+      free(s);
+      return NULL;
+   }
+   s->p = p;
+   return s;
+}
+
+
+void hpx_sax_free(hpx_sax_t *s)
+{
+   int i;
+
+   for (i = 0; i < s->ntag; i++)
+      free(s->tag[i].name);
+   free(s->tag);
+   free(s->hash);
+   hpx_tm_free(s->t);
+   free(s);
+}
+
+
+/*! Hash of tag name (FNV-1a).
+ */
+static unsigned hpx_sax_hash(const char *name, long len)
+{
+   unsigned h = 2166136261u;
+
+   for (; len > 0; len--, name++)
+      h = (h ^ (unsigned char) *name) * 16777619u;
+   return h;
+}
+
+
+/*! Return id of tag name, -1 if it is not registered.
+ */
+static int hpx_sax_find(const hpx_sax_t *s, const char *name, long len)
+{
+   int i, id;
+
+   if (!s->mhash)
+      return -1;
+
+   for (i = hpx_sax_hash(name, len) & (s->mhash - 1); s->hash[i]; i = (i + 1) & (s->mhash - 1))
+   {
+      id = s->hash[i] - 1;
+      if (s->tag[id].len == len && !memcmp(s->tag[id].name, name, len))
+         return id;
+   }
+   return -1;
+}
+
+
+/*! Insert tag id into the hash table.
+ */
+static void hpx_sax_insert(hpx_sax_t *s, int id)
+{
+   int i;
+
+   for (i = hpx_sax_hash(s->tag[id].name, s->tag[id].len) & (s->mhash - 1); s->hash[i]; i = (i + 1) & (s->mhash - 1));
+   s->hash[i] = id + 1;
+}
+
+
+/*! Double the size of the hash table and insert all tags again. The table
+ *  is kept at most half full.
+ *  @return 0 on success, -1 on error.
+ */
+static int hpx_sax_rehash(hpx_sax_t *s)
+{
+   int *h, n, i;
+
+   n = s->mhash ? s->mhash * 2 : 16;
+   if ((h = calloc(n, sizeof(*h))) == NULL)
+      return -1;
+
+   free(s->hash);
+   s->hash = h;
+   s->mhash = n;
+   for (i = 0; i < s->ntag; i++)
+      hpx_sax_insert(s, i);
+   return 0;
+}
+
+
+/*! Grow the tag which is passed to the handlers to twice the number of
+ *  attributes.
+ *  @return 0 on success, -1 on error.
+ */
+static int hpx_sax_grow(hpx_sax_t *s)
+{
+   hpx_tag_t *t;
+
+   if ((t = realloc(s->t, sizeof(*t) + sizeof(*t->attr) * s->t->mattr * 2)) == NULL)
+      return -1;
+   t->mattr *= 2;
+   s->t = t;
+   return 0;
+}
+
+
+/*! Register handlers of a tag name. The open handler is called for opening
+ *  and single tags (<name ...> and <name .../>), the close handler for
+ *  closing and single tags (</name> and <name .../>). Either may be NULL. If
+ *  the name is already registered, its handlers are replaced.
+ *  @return Id of the tag name (>= 0) or -1 on error.
+ */
+int hpx_sax_reg(hpx_sax_t *s, const char *name, hpx_handler_t open, hpx_handler_t close)
+{
+   struct hpx_sax_tag *t;
+   int id;
+
+   if ((id = hpx_sax_find(s, name, strlen(name))) == -1)
+   {
+      if (s->ntag >= s->mtag)
+      {
+         if ((t = realloc(s->tag, sizeof(*t) * (s->mtag + 16))) == NULL)
+            return -1;
+         s->tag = t;
+         s->mtag += 16;
+      }
+      if ((s->ntag + 1) * 2 > s->mhash && hpx_sax_rehash(s) == -1)
+         return -1;
+      if ((s->tag[s->ntag].name = strdup(name)) == NULL)
+         return -1;
+      s->tag[s->ntag].len = strlen(name);
+      id = s->ntag++;
+      hpx_sax_insert(s, id);
+   }
+
+   s->tag[id].open = open;
+   s->tag[id].close = close;
+   return id;
+}
+
+
+/*! Parse the input and call the handlers of the registered tags. Just the
+ *  name of a tag is looked up in a hash table before it is parsed, thus
+ *  tags which are not registered cost little more than scanning. Text,
+ *  comments, and processing instructions are not reported. The tag passed
+ *  to the handlers grows if a tag has more than HPX_SAX_MATTR attributes,
+ *  thus all attributes are reported. Malformed tags are skipped.
+ *  @return The value returned by a handler if it was not 0. Otherwise the
+ *  return value of hpx_get_elem() at the end of the input (0 on eof, -1 on
+ *  error). If the tag cannot grow, -1 is returned with errno set.
+ */
+int hpx_sax_parse(hpx_sax_t *s, hpx_ctrl_t *ctl)
+{
+   const struct hpx_sax_tag *t;
+   bstring_t b;
+   long e, i, n;
+   int id, r;
+
+   while ((e = hpx_get_elem(ctl, &b, NULL, NULL)) > 0)
+   {
+      if (b.len < 3 || *b.buf != '<' || b.buf[1] == '!' || b.buf[1] == '?')
+         continue;
+
+      // compare just the name before parsing the tag
+      n = b.buf[1] == '/' ? 2 : 1;
+      for (i = n; i < b.len && IS_XMLCHAR(b.buf[i]); i++);
+      if ((id = hpx_sax_find(s, b.buf + n, i - n)) == -1)
+         continue;
+
+      // the tag is full if the element has more attributes
+      for (s->t->nattr = 0; (r = hpx_process_elem(b, s->t)) == -1 && s->t->nattr >= s->t->mattr; s->t->nattr = 0)
+         if (hpx_sax_grow(s) == -1)
+            return -1;
+      if (r == -1)
+         continue;
+
+      t = &s->tag[id];
+      r = 0;
+      if ((s->t->type == HPX_OPEN || s->t->type == HPX_SINGLE) && t->open != NULL)
+         r = t->open(id, s->t, s->p);
+      if (!r && (s->t->type == HPX_CLOSE || s->t->type == HPX_SINGLE) && t->close != NULL)
+         r = t->close(id, s->t, s->p);
+      if (r)
+         return r;
+   }
+
+   return e;
+}
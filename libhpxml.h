@@ -28,16 +28,20 @@
 #define IS_XML1CHAR(x) (isalpha(x) || (x == '_') || (x == ':'))
 #define IS_XMLCHAR(x) (isalpha(x) || isdigit(x) || (x == '.') || (x == '-') || (x == '_') || (x == ':'))
 
-#define hpx_init_simple() hpx_init(0, 10*1024*1024)
+//! default initial size of the input buffer, it grows if an element does not fit
+#define HPX_BUF_SIZE (10*1024*1024)
+#define hpx_init_simple() hpx_init(0, HPX_BUF_SIZE)
 
 #define MMAP_PAGES (1 << 15)
+//! initial number of attributes of the tag passed to the handlers of the
+//! event API, it grows if a tag has more attributes
+#define HPX_SAX_MATTR 64
 
 
 typedef struct hpx_ctrl
 {
    //! data buffer containing pointer and number of bytes in buffer
-   //bstring_t buf;
-   struct bstringl buf;
+   bstring_t buf;
    //! file descriptor of input file
    int fd;
    //! flag set if eof
@@ -58,6 +62,17 @@ typedef struct hpx_ctrl
    long pg_siz;
    //! length of advised region (multiple of sysconf(_SC_PAGESIZE))
    long pg_blk_siz;
+   //! file offset of beginning of buffer
+   long off;
+   //! number of reads into the buffer
+   long nfill;
+   //! file offset from which on data is kept in the buffer on refills, -1 if none
+   long keep;
+   //! line number at file offset lno_off
+   long lno;
+   long lno_off;
+   //! flag set if lines of discarded data are counted on refills
+   short lines;
 } hpx_ctrl_t;
 
 typedef struct hpx_attr
@@ -85,22 +100,61 @@ typedef struct hpx_tree
    struct hpx_tree *subtag[];
 } hpx_tree_t;
 
+/*! Handler of the event API. It is called with the id of the tag name as
+ *  returned by hpx_sax_reg(), the parsed tag, and the user pointer. The
+ *  strings of the tag point into the input buffer, they are valid only during
+ *  the call.
+ *  @return 0 to continue parsing, any other value stops hpx_sax_parse().
+ */
+typedef int (*hpx_handler_t)(int id, const hpx_tag_t *tag, void *p);
+
+//! tag name registered with hpx_sax_reg()
+struct hpx_sax_tag
+{
+   char *name;
+   long len;
+   hpx_handler_t open, close;
+};
+
+typedef struct hpx_sax
+{
+   //! registered tag names, the index is the id
+   struct hpx_sax_tag *tag;
+   int ntag, mtag;
+   //! hash table of tag names (open addressing), contains id + 1, 0 if empty
+   int *hash;
+   int mhash;
+   //! tag which is passed to the handlers
+   hpx_tag_t *t;
+   //! user pointer passed to the handlers
+   void *p;
+} hpx_sax_t;
+
 enum
 {
    HPX_ILL, HPX_OPEN, HPX_SINGLE, HPX_CLOSE, HPX_LITERAL, HPX_ATT, HPX_INSTR, HPX_COMMENT
 };
 
 
-long hpx_lineno(void);
+long hpx_lineno(hpx_ctrl_t *ctl, long off);
 void hpx_tm_free(hpx_tag_t *t);
 hpx_tag_t *hpx_tm_create(int n);
+void hpx_tm_reloc(hpx_tag_t *t, const char *lo, const char *hi, char *to);
 int hpx_process_elem(bstring_t b, hpx_tag_t *p);
 hpx_ctrl_t *hpx_init(int fd, long len);
 void hpx_free(hpx_ctrl_t *ctl);
-int hpx_get_elem(hpx_ctrl_t *ctl, bstring_t *b, int *in_tag, long *lno);
-long hpx_get_eleml(hpx_ctrl_t *ctl, bstringl_t *b, int *in_tag, long *lno);
+long hpx_get_elem(hpx_ctrl_t *ctl, bstring_t *b, int *in_tag, long *lno);
 int hpx_fprintf_tag(FILE *f, const hpx_tag_t *p);
+long hpx_tell(const hpx_ctrl_t *ctl);
+void hpx_keep(hpx_ctrl_t *ctl, long off);
+int hpx_seek(hpx_ctrl_t *ctl, long pos, long lno);
+int hpx_skip(hpx_ctrl_t *ctl, const char *const *pat);
+const char *hpx_buf_at(const hpx_ctrl_t *ctl, long off, long len);
 int hpx_tree_resize(hpx_tree_t **tl, int n);
+hpx_sax_t *hpx_sax_new(void *p);
+void hpx_sax_free(hpx_sax_t *s);
+int hpx_sax_reg(hpx_sax_t *s, const char *name, hpx_handler_t open, hpx_handler_t close);
+int hpx_sax_parse(hpx_sax_t *s, hpx_ctrl_t *ctl);
 
 #endif
 
@@ -0,0 +1,524 @@
+/* Copyright 2011 Bernhard R. Fischer, 2048R/5C5FFD47 <bf@abenteuerland.at>
+ *
+ * This file is part of smfilter.
+ *
+ * Smfilter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * Smfilter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with smfilter. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! This file contains the event buffer which is filled by the binary input
+ *  decoders (PBF, ...) and converts the events into hpx_tag_t structures.
+ *  All attribute values are stored in XML-escaped form, exactly as they would
+ *  appear in an OSM/XML file.
+ *
+ *  @author Bernhard R. Fischer
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "osm_evbuf.h"
+
+
+#define EV_BS(x) {sizeof(x) - 1, x}
+
+static const bstring_t ev_name_[] =
+{
+   EV_BS("node"), EV_BS("way"), EV_BS("relation"), EV_BS("tag"), EV_BS("nd"),
+   EV_BS("member"), EV_BS("osm"), EV_BS("xml"), EV_BS("bounds"), EV_BS("id"),
+   EV_BS("version"), EV_BS("timestamp"), EV_BS("changeset"), EV_BS("uid"),
+   EV_BS("user"), EV_BS("visible"), EV_BS("lat"), EV_BS("lon"), EV_BS("k"),
+   EV_BS("v"), EV_BS("ref"), EV_BS("type"), EV_BS("role"), EV_BS("generator"),
+   EV_BS("encoding"), EV_BS("minlat"), EV_BS("minlon"), EV_BS("maxlat"),
+   EV_BS("maxlon")
+};
+
+
+void ev_clear(osm_evbuf_t *eb)
+{
+   eb->nev = eb->nat = eb->pos = 0;
+   eb->alen = 0;
+}
+
+
+void ev_free(osm_evbuf_t *eb)
+{
+   free(eb->ev);
+   free(eb->at);
+   free(eb->arena);
+   memset(eb, 0, sizeof(*eb));
+}
+
+
+/*! Make sure that at least len bytes are available in the arena.
+ *  @return Pointer to the first free byte or NULL on error.
+ */
+static char *ev_reserve(osm_evbuf_t *eb, long len)
+{
+   char *a;
+   long n;
+
+   if (eb->alen + len > eb->amax)
+   {
+      for (n = eb->amax ? eb->amax : 4096; n < eb->alen + len; n <<= 1);
+      if ((a = realloc(eb->arena, n)) == NULL)
+         return NULL;
+      eb->arena = a;
+      eb->amax = n;
+   }
+   return eb->arena + eb->alen;
+}
+
+
+/*! Append new event to buffer.
+ *  @param type Type of element (HPX_OPEN, HPX_SINGLE, ...).
+ *  @param name Tag name (EV_NODE, ...).
+ *  @return 0 on success, -1 on error.
+ */
+int ev_add(osm_evbuf_t *eb, int type, int name)
+{
+   struct osm_ev *ev;
+   int n;
+
+   if (eb->nev >= eb->mev)
+   {
+      n = eb->mev ? eb->mev << 1 : 1024;
+      if ((ev = realloc(eb->ev, n * sizeof(*ev))) == NULL)
+         return -1;
+      eb->ev = ev;
+      eb->mev = n;
+   }
+
+   ev = &eb->ev[eb->nev++];
+   ev->type = type;
+   ev->name = name;
+   ev->attr = eb->nat;
+   ev->nattr = 0;
+
+   return 0;
+}
+
+
+/*! Add attribute to the last event.
+ *  @return 0 on success, -1 on error.
+ */
+int ev_attr(osm_evbuf_t *eb, int name, const struct ev_ref *r)
+{
+   struct ev_attr *at;
+   int n;
+
+   if (eb->nat >= eb->mat)
+   {
+      n = eb->mat ? eb->mat << 1 : 4096;
+      if ((at = realloc(eb->at, n * sizeof(*at))) == NULL)
+         return -1;
+      eb->at = at;
+      eb->mat = n;
+   }
+
+   at = &eb->at[eb->nat++];
+   at->name = name;
+   at->val = *r;
+   eb->ev[eb->nev - 1].nattr++;
+
+   return 0;
+}
+
+
+/*! Escape the characters of a string which must not occur literally within
+ *  XML attribute values.
+ *  @param dst Destination buffer. It must be at least 6 * len bytes long. If
+ *  it is NULL, just the resulting length is returned.
+ *  @return Length of escaped string.
+ */
+long ev_escape(char *dst, const char *s, long len)
+{
+   const char *e;
+   long i, n;
+
+   for (i = 0, n = 0; i < len; i++)
+   {
+      switch (s[i])
+      {
+         case '&': e = "&amp;"; break;
+         case '<': e = "&lt;"; break;
+         case '>': e = "&gt;"; break;
+         case '"': e = "&quot;"; break;
+         case '\'': e = "&apos;"; break;
+         case '\n': e = "&#10;"; break;
+         case '\r': e = "&#13;"; break;
+         case '\t': e = "&#9;"; break;
+         default:
+            if (dst != NULL)
+               dst[n] = s[i];
+            n++;
+            continue;
+      }
+      if (dst != NULL)
+         memcpy(dst + n, e, strlen(e));
+      n += strlen(e);
+   }
+
+   return n;
+}
+
+
+/*! Resolve the entity and character references of an XML attribute value.
+ *  Unknown or broken references are copied literally.
+ *  @param dst Destination buffer. It must be at least len bytes long.
+ *  @return Length of the resulting string.
+ */
+long ev_unescape(char *dst, const char *s, long len)
+{
+   static const char *ent[] = {"amp;&", "lt;<", "gt;>", "quot;\"", "apos;'", NULL};
+   unsigned long c;
+   long i, n, l;
+   int j;
+   char *e;
+
+   for (i = 0, n = 0; i < len; i++)
+   {
+      if (s[i] != '&')
+      {
+         dst[n++] = s[i];
+         continue;
+      }
+
+      for (j = 0; ent[j] != NULL; j++)
+      {
+         l = strlen(ent[j]) - 1;
+         if (len - i - 1 >= l && !strncmp(s + i + 1, ent[j], l))
+            break;
+      }
+      if (ent[j] != NULL)
+      {
+         dst[n++] = ent[j][l];
+         i += l;
+         continue;
+      }
+
+      if (len - i > 3 && s[i + 1] == '#' && memchr(s + i, ';', len - i) != NULL)
+      {
+         if (s[i + 2] == 'x')
+            c = strtoul(s + i + 3, &e, 16);
+         else
+            c = strtoul(s + i + 2, &e, 10);
+
+         if (*e == ';' && e > s + i + 2 && c && c <= 0x10ffff)
+         {
+            // encode UTF-8
+            if (c < 0x80)
+               dst[n++] = c;
+            else if (c < 0x800)
+            {
+               dst[n++] = 0xc0 | (c >> 6);
+               dst[n++] = 0x80 | (c & 0x3f);
+            }
+            else if (c < 0x10000)
+            {
+               dst[n++] = 0xe0 | (c >> 12);
+               dst[n++] = 0x80 | ((c >> 6) & 0x3f);
+               dst[n++] = 0x80 | (c & 0x3f);
+            }
+            else
+            {
+               dst[n++] = 0xf0 | (c >> 18);
+               dst[n++] = 0x80 | ((c >> 12) & 0x3f);
+               dst[n++] = 0x80 | ((c >> 6) & 0x3f);
+               dst[n++] = 0x80 | (c & 0x3f);
+            }
+            i = e - s;
+            continue;
+         }
+      }
+
+      dst[n++] = s[i];
+   }
+
+   return n;
+}
+
+
+/*! Create reference to a string. If the string does not contain characters
+ *  which need to be escaped and eb->data is set, the reference points into
+ *  the data block (zero copy), thus s must point into eb->data in that case.
+ *  Otherwise the string is copied (and escaped) into the arena.
+ *  @return 0 on success, -1 on error.
+ */
+int ev_str(osm_evbuf_t *eb, const char *s, int len, struct ev_ref *r)
+{
+   char *a;
+   int n;
+
+   n = ev_escape(NULL, s, len);
+   if (n == len && eb->data != NULL)
+   {
+      r->src = EV_DATA;
+      r->off = s - eb->data;
+      r->len = len;
+      return 0;
+   }
+
+   if ((a = ev_reserve(eb, n)) == NULL)
+      return -1;
+   r->src = EV_ARENA;
+   r->off = eb->alen;
+   r->len = ev_escape(a, s, len);
+   eb->alen += r->len;
+
+   return 0;
+}
+
+
+/*! Add constant string attribute to last event. The string is copied into
+ *  the arena.
+ */
+int ev_cstr(osm_evbuf_t *eb, int name, const char *s)
+{
+   struct ev_ref r;
+   const char *d = eb->data;
+   int e;
+
+   eb->data = NULL;
+   e = ev_str(eb, s, strlen(s), &r);
+   eb->data = d;
+   if (e == -1)
+      return -1;
+   return ev_attr(eb, name, &r);
+}
+
+
+/*! Write decimal number into buffer.
+ *  @param s Destination buffer, it must be at least 21 bytes long.
+ *  @param v Value.
+ *  @param prec Number of decimal places, i.e. v is divided by 10^prec.
+ *  @return Number of characters written.
+ */
+static int ev_itoa(char *s, int64_t v, int prec)
+{
+   char buf[24];
+   uint64_t u;
+   int i = 0, n = 0;
+
+   u = v < 0 ? -(uint64_t) v : (uint64_t) v;
+   do
+   {
+      if (prec && i == prec)
+         buf[i++] = '.';
+      buf[i++] = '0' + u % 10;
+      u /= 10;
+   }
+   while (u || i < (prec ? prec + 2 : 1));
+
+   if (v < 0)
+      s[n++] = '-';
+   while (i)
+      s[n++] = buf[--i];
+
+   return n;
+}
+
+
+/*! Add integer attribute to last event.
+ */
+int ev_long(osm_evbuf_t *eb, int name, int64_t v)
+{
+   struct ev_ref r;
+   char *a;
+
+   if ((a = ev_reserve(eb, 24)) == NULL)
+      return -1;
+   r.src = EV_ARENA;
+   r.off = eb->alen;
+   r.len = ev_itoa(a, v, 0);
+   eb->alen += r.len;
+
+   return ev_attr(eb, name, &r);
+}
+
+
+/*! Add coordinate attribute to last event.
+ *  @param v Coordinate in units of 10^-7 degrees.
+ */
+int ev_coord(osm_evbuf_t *eb, int name, int64_t v)
+{
+   struct ev_ref r;
+   char *a;
+
+   if ((a = ev_reserve(eb, 24)) == NULL)
+      return -1;
+   r.src = EV_ARENA;
+   r.off = eb->alen;
+   r.len = ev_itoa(a, v, 7);
+   eb->alen += r.len;
+
+   return ev_attr(eb, name, &r);
+}
+
+
+/*! Add timestamp attribute (e.g. 2011-05-15T12:00:00Z) to last event. The
+ *  date conversion is done without gmtime() because this is called for every
+ *  object.
+ */
+int ev_time(osm_evbuf_t *eb, int name, time_t t)
+{
+   struct ev_ref r;
+   int64_t z, era, doe, yoe, doy, mp, d, m, y, s;
+   char *a;
+
+   if ((a = ev_reserve(eb, 24)) == NULL)
+      return -1;
+
+   // civil_from_days(), see http://howardhinnant.github.io/date_algorithms.html
+   s = t % 86400;
+   z = t / 86400;
+   if (s < 0)
+   {
+      s += 86400;
+      z--;
+   }
+   z += 719468;
+   era = (z >= 0 ? z : z - 146096) / 146097;
+   doe = z - era * 146097;
+   yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+   y = yoe + era * 400;
+   doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+   mp = (5 * doy + 2) / 153;
+   d = doy - (153 * mp + 2) / 5 + 1;
+   m = mp < 10 ? mp + 3 : mp - 9;
+   y += m <= 2;
+
+   r.src = EV_ARENA;
+   r.off = eb->alen;
+   r.len = snprintf(a, 24, "%04d-%02d-%02dT%02d:%02d:%02dZ",
+         (int) y, (int) m, (int) d, (int) (s / 3600), (int) (s / 60 % 60), (int) (s % 60));
+   eb->alen += r.len;
+
+   return ev_attr(eb, name, &r);
+}
+
+
+/*! Parse an OSM timestamp of the form 2011-05-15T12:00:00Z. Contrary to
+ *  parse_time() it always interprets the time as UTC.
+ *  @return Seconds since the epoch or -1 if the format is wrong.
+ */
+time_t ev_parse_time(bstring_t b)
+{
+   int64_t y, m, d, era, yoe, doy, doe;
+
+   if (b.len < 19 || b.buf[4] != '-' || b.buf[7] != '-' || b.buf[10] != 'T')
+      return -1;
+
+   y = bs_tol(b);
+   b.buf += 5;
+   b.len -= 5;
+   m = bs_tol(b);
+   b.buf += 3;
+   b.len -= 3;
+   d = bs_tol(b);
+
+   // days_from_civil(), see http://howardhinnant.github.io/date_algorithms.html
+   y -= m <= 2;
+   era = (y >= 0 ? y : y - 399) / 400;
+   yoe = y - era * 400;
+   doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+   doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+   d = era * 146097 + doe - 719468;
+
+   b.buf += 3;
+   b.len -= 3;
+   y = bs_tol(b) * 3600;
+   b.buf += 3;
+   b.len -= 3;
+   y += bs_tol(b) * 60;
+   b.buf += 3;
+   b.len -= 3;
+   y += bs_tol(b);
+
+   return d * 86400 + y;
+}
+
+
+/*! Parse decimal coordinate without loss of precision.
+ *  @return Coordinate in units of 10^-7 degrees, rounded.
+ */
+int64_t ev_parse_coord(bstring_t b)
+{
+   int64_t v = 0;
+   int n = 0, e = -1;
+
+   if (b.len && *b.buf == '-')
+   {
+      (void) bs_advance(&b);
+      n = 1;
+   }
+
+   for (; b.len && e < 8; (void) bs_advance(&b))
+   {
+      if (*b.buf == '.' && e == -1)
+      {
+         e = 0;
+         continue;
+      }
+      if ((*b.buf < '0') || (*b.buf > '9'))
+         break;
+      if (e >= 0)
+         e++;
+      if (e == 8)
+      {
+         // round at 8th decimal place
+         if (*b.buf >= '5')
+            v++;
+         break;
+      }
+      v = v * 10 + *b.buf - '0';
+   }
+
+   for (e = e < 0 ? 0 : e; e < 7; e++)
+      v *= 10;
+
+   return n ? -v : v;
+}
+
+
+/*! Convert next event into hpx_tag_t structure. The strings of the tag point
+ *  into the event buffer, thus they are valid until the event buffer is
+ *  cleared or freed.
+ *  @param eb Pointer to event buffer.
+ *  @param tag Destination tag.
+ *  @return 1 if an event was returned, 0 if there are no more events.
+ */
+int ev_get_tag(osm_evbuf_t *eb, hpx_tag_t *tag)
+{
+   const struct osm_ev *ev;
+   const struct ev_attr *at;
+   int i;
+
+   if (eb->pos >= eb->nev)
+      return 0;
+
+   ev = &eb->ev[eb->pos++];
+   tag->type = ev->type;
+   tag->tag = ev_name_[ev->name];
+
+   for (i = 0, at = &eb->at[ev->attr]; i < ev->nattr && i < tag->mattr; i++, at++)
+   {
+      tag->attr[i].name = ev_name_[at->name];
+      tag->attr[i].value.buf = (at->val.src == EV_ARENA ? eb->arena : (char*) eb->data) + at->val.off;
+      tag->attr[i].value.len = at->val.len;
+      tag->attr[i].delim = '"';
+   }
+   tag->nattr = i;
+
+   return 1;
+}
+
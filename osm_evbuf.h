@@ -0,0 +1,102 @@
+/* Copyright 2011 Bernhard R. Fischer, 2048R/5C5FFD47 <bf@abenteuerland.at>
+ *
+ * This file is part of smfilter.
+ *
+ * Smfilter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * Smfilter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with smfilter. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OSM_EVBUF_H
+#define OSM_EVBUF_H
+
+#include <stdint.h>
+#include <time.h>
+
+#include "bstring.h"
+#include "libhpxml.h"
+
+
+//! names of tags and attributes used in events
+enum
+{
+   EV_NODE, EV_WAY, EV_RELATION, EV_TAG, EV_ND, EV_MEMBER, EV_OSM, EV_XML,
+   EV_BOUNDS, EV_ID, EV_VERSION, EV_TIMESTAMP, EV_CHANGESET, EV_UID, EV_USER,
+   EV_VISIBLE, EV_LAT, EV_LON, EV_K, EV_V, EV_REF, EV_TYPE, EV_ROLE,
+   EV_GENERATOR, EV_ENCODING, EV_MINLAT, EV_MINLON, EV_MAXLAT, EV_MAXLON,
+   EV_NAMES
+};
+
+//! source of attribute value
+enum {EV_ARENA, EV_DATA};
+
+/*! Reference to a string which is either stored in the arena of the event
+ * buffer or within the external data block. Offsets are used instead of
+ * pointers because the arena may be reallocated.
+ */
+struct ev_ref
+{
+   long off;
+   int len;
+   int src;
+};
+
+struct ev_attr
+{
+   int name;
+   struct ev_ref val;
+};
+
+struct osm_ev
+{
+   int type;         //!< HPX_OPEN, HPX_SINGLE, HPX_CLOSE, HPX_INSTR
+   int name;         //!< tag name (EV_NODE...)
+   int attr;         //!< index of first attribute
+   int nattr;        //!< number of attributes
+};
+
+/*! An event buffer holds a list of XML events (tags with attributes) which
+ *  are generated by the binary input decoders. The events are returned as
+ *  hpx_tag_t structures, thus the main loop does not see any difference to
+ *  XML input.
+ */
+typedef struct osm_evbuf
+{
+   struct osm_ev *ev;
+   int nev, mev;
+   struct ev_attr *at;
+   int nat, mat;
+   char *arena;
+   long alen, amax;
+   //! external data block referenced by EV_DATA strings
+   const char *data;
+   //! index of next event returned by ev_get_tag()
+   int pos;
+} osm_evbuf_t;
+
+
+void ev_clear(osm_evbuf_t *eb);
+void ev_free(osm_evbuf_t *eb);
+int ev_add(osm_evbuf_t *eb, int type, int name);
+int ev_attr(osm_evbuf_t *eb, int name, const struct ev_ref *r);
+int ev_str(osm_evbuf_t *eb, const char *s, int len, struct ev_ref *r);
+int ev_long(osm_evbuf_t *eb, int name, int64_t v);
+int ev_coord(osm_evbuf_t *eb, int name, int64_t v);
+int ev_time(osm_evbuf_t *eb, int name, time_t t);
+int ev_cstr(osm_evbuf_t *eb, int name, const char *s);
+int ev_get_tag(osm_evbuf_t *eb, hpx_tag_t *tag);
+long ev_escape(char *dst, const char *s, long len);
+long ev_unescape(char *dst, const char *s, long len);
+time_t ev_parse_time(bstring_t b);
+int64_t ev_parse_coord(bstring_t b);
+
+#endif
+
@@ -16,6 +16,7 @@
  */
 
 #define _XOPEN_SOURCE
+#include <string.h>
 #include <time.h>
 
 #include "osm_inplace.h"
@@ -36,6 +37,8 @@ time_t parse_time(bstring_t b)
       return -1;
 
 #ifdef HAS_STRPTIME
+   // strptime() does not set fields which are not parsed, e.g. tm_isdst
+   memset(&tm, 0, sizeof(tm));
    (void) strptime(b.buf, "%Y-%m-%dT%T%z", &tm);
 #else
    tm.tm_year = bs_tol(b) - 1900;
@@ -0,0 +1,643 @@
+/* Copyright 2011 Bernhard R. Fischer, 2048R/5C5FFD47 <bf@abenteuerland.at>
+ *
+ * This file is part of smfilter.
+ *
+ * Smfilter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * Smfilter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with smfilter. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! This file contains the reader for the o5m format. The file is read
+ *  dataset by dataset. Each dataset is decoded into XML events, which are
+ *  returned by o5m_get_tag() as hpx_tag_t structures, thus the caller sees
+ *  the same elements as for OSM/XML input. The format is decoded
+ *  sequentially because all values are delta coded.
+ *
+ *  @author Bernhard R. Fischer
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include "osm_o5m.h"
+
+
+//! dataset types
+enum
+{
+   O5M_NODE = 0x10, O5M_WAY = 0x11, O5M_REL = 0x12, O5M_BBOX = 0xdb,
+   O5M_TSTAMP = 0xdc, O5M_HEADER = 0xe0, O5M_SYNC = 0xee, O5M_JUMP = 0xef,
+   O5M_EOF = 0xfe, O5M_RESET = 0xff
+};
+
+/*! Buffer of a dataset.
+ */
+struct o5b
+{
+   const uint8_t *p, *e;
+};
+
+
+static int o5_uvar(struct o5b *b, uint64_t *v)
+{
+   uint64_t x = 0;
+   int s;
+
+   for (s = 0; b->p < b->e && s < 64; s += 7)
+   {
+      x |= (uint64_t) (*b->p & 0x7f) << s;
+      if (!(*b->p++ & 0x80))
+      {
+         *v = x;
+         return 0;
+      }
+   }
+
+   errno = EBADMSG;
+   return -1;
+}
+
+
+static int o5_svar(struct o5b *b, int64_t *v)
+{
+   uint64_t u;
+
+   if (o5_uvar(b, &u) == -1)
+      return -1;
+   *v = (int64_t) (u >> 1) ^ -(int64_t) (u & 1);
+   return 0;
+}
+
+
+/*! Add signed delta to counter.
+ */
+static int o5_delta(struct o5b *b, int64_t *c)
+{
+   int64_t v;
+
+   if (o5_svar(b, &v) == -1)
+      return -1;
+   *c += v;
+   return 0;
+}
+
+
+/*! Make sure that at least n bytes are available in the read buffer.
+ *  @return 1 on success, 0 if eof occured before, -1 on error.
+ */
+static int o5m_fill(o5m_ctrl_t *ctl, size_t n)
+{
+   uint8_t *b;
+   ssize_t s;
+   size_t m;
+
+   while (ctl->len - ctl->pos < n)
+   {
+      if (ctl->eof)
+         return 0;
+
+      if (ctl->pos + n > ctl->max)
+      {
+         memmove(ctl->buf, ctl->buf + ctl->pos, ctl->len - ctl->pos);
+         ctl->len -= ctl->pos;
+         ctl->pos = 0;
+      }
+
+      if (n > ctl->max)
+      {
+         for (m = ctl->max; m < n; m <<= 1);
+         if ((b = realloc(ctl->buf, m)) == NULL)
+            return -1;
+         ctl->buf = b;
+         ctl->max = m;
+      }
+
+      if ((s = read(ctl->fd, ctl->buf + ctl->len, ctl->max - ctl->len)) == -1)
+      {
+         if (errno == EINTR)
+            continue;
+         return -1;
+      }
+      if (!s)
+         ctl->eof = 1;
+      ctl->len += s;
+   }
+
+   return 1;
+}
+
+
+static void o5m_reset(o5m_ctrl_t *ctl)
+{
+   memset(&ctl->d, 0, sizeof(ctl->d));
+   ctl->st.n = 0;
+}
+
+
+/*! Read a string or a string pair. Strings are either inline (preceded by a
+ *  0-byte) or a reference to a previous string of the string table.
+ *  @param s Receives pointers to the strings.
+ *  @param l Receives the lengths of the strings.
+ *  @param n Number of strings, 1 or 2.
+ *  @return 0 on success, -1 on error.
+ */
+static int o5m_str(o5m_ctrl_t *ctl, struct o5b *b, const char **s, int *l, int n)
+{
+   const char *p, *e;
+   uint64_t r;
+   int i;
+
+   if (b->p >= b->e)
+   {
+      errno = EBADMSG;
+      return -1;
+   }
+
+   if (*b->p)
+   {
+      if (o5_uvar(b, &r) == -1)
+         return -1;
+      if (!r || r > O5M_STR_TAB || (long) r > ctl->st.n)
+      {
+         errno = EBADMSG;
+         return -1;
+      }
+      p = ctl->st.s[(ctl->st.n - r) % O5M_STR_TAB];
+      for (i = 0; i < n; i++)
+      {
+         s[i] = p;
+         l[i] = strlen(p);
+         p += l[i] + 1;
+      }
+      return 0;
+   }
+
+   p = (const char*) ++b->p;
+   for (i = 0; i < n; i++)
+   {
+      if ((e = memchr(b->p, 0, b->e - b->p)) == NULL)
+      {
+         errno = EBADMSG;
+         return -1;
+      }
+      s[i] = (const char*) b->p;
+      l[i] = e - s[i];
+      b->p = (const uint8_t*) e + 1;
+   }
+
+   // the string is put into the table if it is not too long
+   if ((const char*) b->p - p - n <= O5M_STR_MAX)
+   {
+      memcpy(ctl->st.s[ctl->st.n % O5M_STR_TAB], p, (const char*) b->p - p);
+      ctl->st.n++;
+   }
+
+   return 0;
+}
+
+
+static int o5m_strattr(o5m_ctrl_t *ctl, int name, const char *s, int len)
+{
+   struct ev_ref r;
+
+   if (ev_str(&ctl->eb, s, len, &r) == -1)
+      return -1;
+   return ev_attr(&ctl->eb, name, &r);
+}
+
+
+/*! Decode id and version information of an object and add the attributes
+ *  to the last event.
+ *  @return 1 if the object is complete, 0 if the object is deleted (.o5c),
+ *  -1 on error.
+ */
+static int o5m_info(o5m_ctrl_t *ctl, struct o5b *b)
+{
+   const char *s[2];
+   struct o5b u;
+   uint64_t ver, uid;
+   int l[2];
+
+   if (o5_delta(b, &ctl->d.id) == -1)
+      return -1;
+   if (b->p >= b->e)
+      return 0;
+   if (ev_long(&ctl->eb, EV_ID, ctl->d.id) == -1)
+      return -1;
+
+   if (o5_uvar(b, &ver) == -1)
+      return -1;
+   if (!ver)
+      return b->p < b->e;
+   if (ev_long(&ctl->eb, EV_VERSION, ver) == -1)
+      return -1;
+
+   if (o5_delta(b, &ctl->d.ts) == -1)
+      return -1;
+   if (!ctl->d.ts)
+      return b->p < b->e;
+   if (ev_time(&ctl->eb, EV_TIMESTAMP, ctl->d.ts) == -1)
+      return -1;
+
+   if (o5_delta(b, &ctl->d.cs) == -1)
+      return -1;
+   if (ev_long(&ctl->eb, EV_CHANGESET, ctl->d.cs) == -1)
+      return -1;
+
+   // uid (as varint) and user name
+   if (o5m_str(ctl, b, s, l, 2) == -1)
+      return -1;
+   u.p = (const uint8_t*) s[0];
+   u.e = u.p + l[0];
+   uid = 0;
+   if (l[0] && o5_uvar(&u, &uid) == -1)
+      return -1;
+   if (ev_long(&ctl->eb, EV_UID, uid) == -1)
+      return -1;
+   if (o5m_strattr(ctl, EV_USER, s[1], l[1]) == -1)
+      return -1;
+
+   return b->p < b->e;
+}
+
+
+/*! Remove incomplete object from the event buffer.
+ *  @param n Index of the event of the object.
+ *  @param e Return value.
+ */
+static int o5m_drop(o5m_ctrl_t *ctl, int n, int e)
+{
+   ctl->eb.nat = ctl->eb.ev[n].attr;
+   ctl->eb.nev = n;
+   return e;
+}
+
+
+/*! Decode the tags at the end of a dataset.
+ */
+static int o5m_tags(o5m_ctrl_t *ctl, struct o5b *b)
+{
+   const char *s[2];
+   int l[2];
+
+   while (b->p < b->e)
+   {
+      if (o5m_str(ctl, b, s, l, 2) == -1)
+         return -1;
+      if (ev_add(&ctl->eb, HPX_SINGLE, EV_TAG) == -1)
+         return -1;
+      if (o5m_strattr(ctl, EV_K, s[0], l[0]) == -1 || o5m_strattr(ctl, EV_V, s[1], l[1]) == -1)
+         return -1;
+   }
+   return 0;
+}
+
+
+static int o5m_node(o5m_ctrl_t *ctl, struct o5b *b)
+{
+   int e, n = ctl->eb.nev;
+
+   if (ev_add(&ctl->eb, HPX_SINGLE, EV_NODE) == -1)
+      return -1;
+   if ((e = o5m_info(ctl, b)) <= 0)
+      return o5m_drop(ctl, n, e);
+
+   if (o5_delta(b, &ctl->d.lon) == -1 || o5_delta(b, &ctl->d.lat) == -1)
+      return -1;
+   // coordinates are 32 bit values which may wrap around
+   ctl->d.lon = (int32_t) ctl->d.lon;
+   ctl->d.lat = (int32_t) ctl->d.lat;
+   if (ev_coord(&ctl->eb, EV_LAT, ctl->d.lat) == -1 || ev_coord(&ctl->eb, EV_LON, ctl->d.lon) == -1)
+      return -1;
+
+   if (b->p >= b->e)
+      return 0;
+
+   ctl->eb.ev[n].type = HPX_OPEN;
+   if (o5m_tags(ctl, b) == -1)
+      return -1;
+   return ev_add(&ctl->eb, HPX_CLOSE, EV_NODE);
+}
+
+
+static int o5m_way(o5m_ctrl_t *ctl, struct o5b *b)
+{
+   struct o5b r;
+   uint64_t len;
+   int e, n = ctl->eb.nev;
+
+   if (ev_add(&ctl->eb, HPX_SINGLE, EV_WAY) == -1)
+      return -1;
+   if ((e = o5m_info(ctl, b)) <= 0)
+      return o5m_drop(ctl, n, e);
+
+   if (o5_uvar(b, &len) == -1)
+      return -1;
+   if (len > (uint64_t) (b->e - b->p))
+   {
+      errno = EBADMSG;
+      return -1;
+   }
+   r.p = b->p;
+   r.e = b->p += len;
+
+   if (r.p >= r.e && b->p >= b->e)
+      return 0;
+   ctl->eb.ev[n].type = HPX_OPEN;
+
+   while (r.p < r.e)
+   {
+      if (o5_delta(&r, &ctl->d.ref[0]) == -1)
+         return -1;
+      if (ev_add(&ctl->eb, HPX_SINGLE, EV_ND) == -1)
+         return -1;
+      if (ev_long(&ctl->eb, EV_REF, ctl->d.ref[0]) == -1)
+         return -1;
+   }
+
+   if (o5m_tags(ctl, b) == -1)
+      return -1;
+   return ev_add(&ctl->eb, HPX_CLOSE, EV_WAY);
+}
+
+
+static int o5m_relation(o5m_ctrl_t *ctl, struct o5b *b)
+{
+   static const char *mtype[] = {"node", "way", "relation"};
+   const char *s;
+   struct o5b r;
+   uint64_t len;
+   int64_t v;
+   int e, t, l, n = ctl->eb.nev;
+
+   if (ev_add(&ctl->eb, HPX_SINGLE, EV_RELATION) == -1)
+      return -1;
+   if ((e = o5m_info(ctl, b)) <= 0)
+      return o5m_drop(ctl, n, e);
+
+   if (o5_uvar(b, &len) == -1)
+      return -1;
+   if (len > (uint64_t) (b->e - b->p))
+   {
+      errno = EBADMSG;
+      return -1;
+   }
+   r.p = b->p;
+   r.e = b->p += len;
+
+   if (r.p >= r.e && b->p >= b->e)
+      return 0;
+   ctl->eb.ev[n].type = HPX_OPEN;
+
+   while (r.p < r.e)
+   {
+      // reference is delta coded for each member type separately, thus the
+      // type (which follows) is needed first
+      if (o5_svar(&r, &v) == -1)
+         return -1;
+      if (o5m_str(ctl, &r, &s, &l, 1) == -1)
+         return -1;
+      if (!l || s[0] < '0' || s[0] > '2')
+      {
+         errno = EBADMSG;
+         return -1;
+      }
+      t = s[0] - '0';
+      ctl->d.ref[t] += v;
+
+      if (ev_add(&ctl->eb, HPX_SINGLE, EV_MEMBER) == -1)
+         return -1;
+      if (ev_cstr(&ctl->eb, EV_TYPE, mtype[t]) == -1)
+         return -1;
+      if (ev_long(&ctl->eb, EV_REF, ctl->d.ref[t]) == -1)
+         return -1;
+      if (o5m_strattr(ctl, EV_ROLE, s + 1, l - 1) == -1)
+         return -1;
+   }
+
+   if (o5m_tags(ctl, b) == -1)
+      return -1;
+   return ev_add(&ctl->eb, HPX_CLOSE, EV_RELATION);
+}
+
+
+static int o5m_bbox(o5m_ctrl_t *ctl, struct o5b *b)
+{
+   int64_t c[4];
+   int i;
+
+   // x1, y1, x2, y2
+   for (i = 0; i < 4; i++)
+      if (o5_svar(b, &c[i]) == -1)
+         return -1;
+
+   if (ev_add(&ctl->eb, HPX_SINGLE, EV_BOUNDS) == -1)
+      return -1;
+   if (ev_coord(&ctl->eb, EV_MINLAT, c[1]) == -1 ||
+         ev_coord(&ctl->eb, EV_MINLON, c[0]) == -1 ||
+         ev_coord(&ctl->eb, EV_MAXLAT, c[3]) == -1 ||
+         ev_coord(&ctl->eb, EV_MAXLON, c[2]) == -1)
+      return -1;
+
+   return 0;
+}
+
+
+/*! Add the events which open the document.
+ */
+static int o5m_open(o5m_ctrl_t *ctl)
+{
+   ctl->open = 1;
+   if (ev_add(&ctl->eb, HPX_INSTR, EV_XML) == -1)
+      return -1;
+   if (ev_cstr(&ctl->eb, EV_VERSION, "1.0") == -1 || ev_cstr(&ctl->eb, EV_ENCODING, "UTF-8") == -1)
+      return -1;
+   if (ev_add(&ctl->eb, HPX_OPEN, EV_OSM) == -1)
+      return -1;
+   return ev_cstr(&ctl->eb, EV_VERSION, "0.6");
+}
+
+
+/*! Read and decode next dataset.
+ *  @return 1 if a dataset was processed, 0 at the end of the file, -1 on
+ *  error.
+ */
+static int o5m_next(o5m_ctrl_t *ctl)
+{
+   struct o5b b;
+   uint64_t len;
+   int e, i, type;
+
+   if ((e = o5m_fill(ctl, 1)) <= 0)
+      return e;
+
+   type = ctl->buf[ctl->pos++];
+   switch (type)
+   {
+      case O5M_EOF:
+         return 0;
+
+      case O5M_RESET:
+         o5m_reset(ctl);
+         return 1;
+   }
+
+   // datasets 0xf0 to 0xff do not have a length
+   if (type >= 0xf0)
+      return 1;
+
+   for (i = 1, len = 0; ; i++)
+   {
+      if ((e = o5m_fill(ctl, i)) <= 0)
+         goto o5m_trunc;
+      b.p = ctl->buf + ctl->pos;
+      b.e = b.p + i;
+      if (b.p[i - 1] < 0x80)
+         break;
+      if (i >= 10)
+      {
+         errno = EBADMSG;
+         return -1;
+      }
+   }
+   (void) o5_uvar(&b, &len);
+   ctl->pos += i;
+   if (len > O5M_MAX_DS)
+   {
+      errno = EBADMSG;
+      return -1;
+   }
+   if ((e = o5m_fill(ctl, len)) <= 0)
+      goto o5m_trunc;
+
+   b.p = ctl->buf + ctl->pos;
+   b.e = b.p + len;
+   ctl->pos += len;
+
+   if (type == O5M_HEADER)
+   {
+      if (len != 4 || (memcmp(b.p, "o5m2", 4) && memcmp(b.p, "o5c2", 4)))
+      {
+         errno = ENOTSUP;
+         return -1;
+      }
+      return ctl->open ? 1 : o5m_open(ctl) == -1 ? -1 : 1;
+   }
+
+   if (!ctl->open && (type == O5M_NODE || type == O5M_WAY || type == O5M_REL || type == O5M_BBOX))
+      if (o5m_open(ctl) == -1)
+         return -1;
+
+   switch (type)
+   {
+      case O5M_NODE:
+         e = o5m_node(ctl, &b);
+         break;
+      case O5M_WAY:
+         e = o5m_way(ctl, &b);
+         break;
+      case O5M_REL:
+         e = o5m_relation(ctl, &b);
+         break;
+      case O5M_BBOX:
+         e = o5m_bbox(ctl, &b);
+         break;
+      default:
+         e = 0;
+   }
+
+   return e == -1 ? -1 : 1;
+
+o5m_trunc:
+   if (!e)
+      errno = EIO;
+   return -1;
+}
+
+
+/*! Create control structure of o5m reader.
+ *  @param fd File descriptor of input file.
+ *  @return Pointer to o5m_ctrl_t structure or NULL on error with errno set.
+ */
+o5m_ctrl_t *o5m_init(int fd)
+{
+   o5m_ctrl_t *ctl;
+
+   if ((ctl = calloc(1, sizeof(*ctl))) == NULL)
+      return NULL;
+
+   if ((ctl->buf = malloc(O5M_BUFSIZ)) == NULL)
+   {
+      free(ctl);
+      return NULL;
+   }
+
+   if ((ctl->st.s = malloc(O5M_STR_TAB * sizeof(*ctl->st.s))) == NULL)
+   {
+      free(ctl->buf);
+      free(ctl);
+      return NULL;
+   }
+
+   ctl->fd = fd;
+   ctl->max = O5M_BUFSIZ;
+
+   return ctl;
+}
+
+
+void o5m_free(o5m_ctrl_t *ctl)
+{
+   ev_free(&ctl->eb);
+   free(ctl->st.s);
+   free(ctl->buf);
+   free(ctl);
+}
+
+
+/*! Get next element of the o5m file as hpx_tag_t structure. The strings
+ *  within tag are valid until the next call to o5m_get_tag().
+ *  @param ctl Pointer to o5m_ctrl_t structure.
+ *  @param tag Pointer to tag which receives the element. The number of
+ *  attributes is limited to tag->mattr.
+ *  @return 1 if a tag was returned, 0 on eof, -1 on error with errno set.
+ */
+int o5m_get_tag(o5m_ctrl_t *ctl, hpx_tag_t *tag)
+{
+   int e;
+
+   for (;;)
+   {
+      if (ev_get_tag(&ctl->eb, tag))
+      {
+         tag->line = 0;
+         return 1;
+      }
+
+      if (ctl->fin)
+         return 0;
+
+      ev_clear(&ctl->eb);
+      if ((e = o5m_next(ctl)) == -1)
+         return -1;
+
+      if (!e)
+      {
+         ctl->fin = 1;
+         if (ctl->open && ev_add(&ctl->eb, HPX_CLOSE, EV_OSM) == -1)
+            return -1;
+      }
+   }
+}
+
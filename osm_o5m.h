@@ -0,0 +1,87 @@
+/* Copyright 2011 Bernhard R. Fischer, 2048R/5C5FFD47 <bf@abenteuerland.at>
+ *
+ * This file is part of smfilter.
+ *
+ * Smfilter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * Smfilter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with smfilter. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OSM_O5M_H
+#define OSM_O5M_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "libhpxml.h"
+#include "osm_evbuf.h"
+
+
+//! initial size of the read buffer
+#define O5M_BUFSIZ (1024 * 1024)
+//! maximum size of a dataset
+#define O5M_MAX_DS (64 * 1024 * 1024)
+//! number of entries of the string table
+#define O5M_STR_TAB 15000
+//! maximum length of strings (or pairs) which are kept in the string table
+#define O5M_STR_MAX 250
+
+
+/*! String table of o5m. Each entry holds the raw bytes of a string or a
+ *  string pair including the terminating 0-bytes.
+ */
+struct o5m_stab
+{
+   char (*s)[O5M_STR_MAX + 2];
+   //! total number of strings added since the last reset
+   long n;
+};
+
+/*! Counters of delta coding.
+ */
+struct o5m_delta
+{
+   int64_t id, ts, cs, lat, lon;
+   //! member references of nodes (and node refs of ways), ways, and relations
+   int64_t ref[3];
+};
+
+typedef struct o5m_ctrl
+{
+   //! file descriptor of input file
+   int fd;
+   //! read buffer
+   uint8_t *buf;
+   size_t pos, len, max;
+   //! flag set if eof of input
+   short eof;
+   //! flag set if <osm> was opened
+   short open;
+   //! flag set if </osm> was returned
+   short fin;
+   struct o5m_delta d;
+   struct o5m_stab st;
+   //! events of the current dataset
+   osm_evbuf_t eb;
+} o5m_ctrl_t;
+
+typedef struct o5m_wctrl o5m_wctrl_t;
+
+
+o5m_ctrl_t *o5m_init(int fd);
+void o5m_free(o5m_ctrl_t *ctl);
+int o5m_get_tag(o5m_ctrl_t *ctl, hpx_tag_t *tag);
+o5m_wctrl_t *o5m_wopen(FILE *f);
+int o5m_put_tag(o5m_wctrl_t *w, const hpx_tag_t *t);
+int o5m_wclose(o5m_wctrl_t *w);
+
+#endif
+
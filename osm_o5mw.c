@@ -0,0 +1,564 @@
+/* Copyright 2011 Bernhard R. Fischer, 2048R/5C5FFD47 <bf@abenteuerland.at>
+ *
+ * This file is part of smfilter.
+ *
+ * Smfilter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * Smfilter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with smfilter. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! This file contains the writer for the o5m format. It receives XML
+ *  elements (hpx_tag_t) and assembles them into OSM objects. Each object is
+ *  encoded as a single dataset when it is closed. Tags and members are
+ *  collected first because the string table requires that the strings are
+ *  encoded in the order of the dataset.
+ *
+ *  @author Bernhard R. Fischer
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include "osm_o5m.h"
+
+
+//! size of the hash table of the string table, must be a power of 2
+#define O5W_HASH 65536
+
+//! dataset types
+enum {O5W_NODE = 0x10, O5W_WAY = 0x11, O5W_REL = 0x12, O5W_BBOX = 0xdb};
+
+/*! Growable buffer. Allocation errors are sticky.
+ */
+struct o5w_buf
+{
+   uint8_t *buf;
+   size_t len, max;
+   int err;
+};
+
+struct o5m_wctrl
+{
+   FILE *f;
+   //! flag set if file header was written
+   int hdr;
+   //! number of objects written
+   long cnt;
+   struct o5m_delta d;
+   //! string table
+   char (*st)[O5M_STR_MAX + 2];
+   //! number of strings added to the table
+   long stn;
+   //! hash table which contains the index + 1 of the strings within st
+   long *hash;
+   //! type of current object (O5W_NODE...) or 0
+   int type;
+   int64_t id, ver, ts, cs, uid, lat, lon;
+   //! user name (unescaped)
+   struct o5w_buf usr;
+   //! tags as key/value pairs, each string terminated by \0
+   struct o5w_buf kv;
+   //! members as type and role, each terminated by \0
+   struct o5w_buf mem;
+   //! node references or member references
+   int64_t *ref;
+   size_t nref, mref;
+   //! encoded dataset, references section, and temporary buffer
+   struct o5w_buf ds, sec, tmp;
+   int err;
+};
+
+
+static void o5w_reserve(struct o5w_buf *b, size_t n)
+{
+   uint8_t *p;
+   size_t m;
+
+   if (b->len + n <= b->max)
+      return;
+
+   for (m = b->max ? b->max : 4096; m < b->len + n; m <<= 1);
+   if ((p = realloc(b->buf, m)) == NULL)
+   {
+      b->err = 1;
+      return;
+   }
+   b->buf = p;
+   b->max = m;
+}
+
+
+static void o5w_bytes(struct o5w_buf *b, const void *s, size_t len)
+{
+   o5w_reserve(b, len);
+   if (b->err)
+      return;
+   memcpy(b->buf + b->len, s, len);
+   b->len += len;
+}
+
+
+static void o5w_uvar(struct o5w_buf *b, uint64_t v)
+{
+   o5w_reserve(b, 10);
+   if (b->err)
+      return;
+   for (; v >= 0x80; v >>= 7)
+      b->buf[b->len++] = (v & 0x7f) | 0x80;
+   b->buf[b->len++] = v;
+}
+
+
+static void o5w_svar(struct o5w_buf *b, int64_t v)
+{
+   o5w_uvar(b, ((uint64_t) v << 1) ^ (uint64_t) (v >> 63));
+}
+
+
+/*! Write delta of v to counter c and update the counter.
+ */
+static void o5w_delta(struct o5w_buf *b, int64_t *c, int64_t v)
+{
+   o5w_svar(b, v - *c);
+   *c = v;
+}
+
+
+/*! Append XML attribute value unescaped and terminated by \0 to buffer.
+ */
+static void o5w_xstr(struct o5w_buf *b, bstring_t s)
+{
+   o5w_reserve(b, s.len + 1);
+   if (b->err)
+      return;
+   b->len += ev_unescape((char*) b->buf + b->len, s.buf, s.len);
+   b->buf[b->len++] = 0;
+}
+
+
+static uint32_t o5w_hash(const char *s, long len)
+{
+   uint32_t h = 2166136261u;
+
+   for (; len; len--, s++)
+      h = (h ^ (uint8_t) *s) * 16777619u;
+   return h;
+}
+
+
+/*! Write a string or string pair. If it is found in the string table, a
+ *  reference is written, otherwise it is written inline.
+ *  @param b Destination buffer.
+ *  @param s String(s) including the terminating \0 bytes.
+ *  @param len Length of s.
+ *  @param n Number of strings (1 or 2).
+ */
+static void o5w_str(o5m_wctrl_t *w, struct o5w_buf *b, const char *s, long len, int n)
+{
+   uint32_t h;
+   long c;
+
+   if (len - n > O5M_STR_MAX)
+   {
+      o5w_uvar(b, 0);
+      o5w_bytes(b, s, len);
+      return;
+   }
+
+   h = o5w_hash(s, len) & (O5W_HASH - 1);
+   c = w->hash[h] - 1;
+   if (c >= 0 && w->stn - c <= O5M_STR_TAB && !memcmp(w->st[c % O5M_STR_TAB], s, len))
+   {
+      o5w_uvar(b, w->stn - c);
+      return;
+   }
+
+   o5w_uvar(b, 0);
+   o5w_bytes(b, s, len);
+   memcpy(w->st[w->stn % O5M_STR_TAB], s, len);
+   w->hash[h] = ++w->stn;
+}
+
+
+/*! Write dataset to file.
+ */
+static int o5w_write(o5m_wctrl_t *w, int type, const struct o5w_buf *b)
+{
+   struct o5w_buf h;
+   uint8_t buf[16];
+
+   if (b->err)
+   {
+      errno = ENOMEM;
+      return -1;
+   }
+
+   h.buf = buf;
+   h.len = 0;
+   h.max = sizeof(buf);
+   h.err = 0;
+   buf[h.len++] = type;
+   o5w_uvar(&h, b->len);
+
+   if (fwrite(h.buf, h.len, 1, w->f) != 1)
+      return -1;
+   if (b->len && fwrite(b->buf, b->len, 1, w->f) != 1)
+      return -1;
+   return 0;
+}
+
+
+/*! Write file header (reset and header dataset) if not done yet.
+ */
+static int o5w_header(o5m_wctrl_t *w)
+{
+   if (w->hdr)
+      return 0;
+   w->hdr = 1;
+   return fwrite("\xff\xe0\x04o5m2", 7, 1, w->f) == 1 ? 0 : -1;
+}
+
+
+static void o5w_ref(o5m_wctrl_t *w, int64_t ref)
+{
+   int64_t *r;
+   size_t m;
+
+   if (w->nref >= w->mref)
+   {
+      m = w->mref ? w->mref << 1 : 1024;
+      if ((r = realloc(w->ref, m * sizeof(*r))) == NULL)
+      {
+         w->ds.err = 1;
+         return;
+      }
+      w->ref = r;
+      w->mref = m;
+   }
+   w->ref[w->nref++] = ref;
+}
+
+
+/*! Encode current object and write it.
+ *  @return 0 on success, -1 on error.
+ */
+static int o5w_obj_end(o5m_wctrl_t *w)
+{
+   struct o5w_buf *b = &w->ds;
+   const char *s, *e;
+   size_t i;
+   int t;
+
+   t = w->type;
+   w->type = 0;
+
+   if (o5w_header(w) == -1)
+      return -1;
+
+   b->len = 0;
+   o5w_delta(b, &w->d.id, w->id);
+   o5w_uvar(b, w->ver);
+   if (w->ver)
+   {
+      o5w_delta(b, &w->d.ts, w->ts);
+      if (w->ts)
+      {
+         o5w_delta(b, &w->d.cs, w->cs);
+         // pair of uid (as varint, 0 is an empty string) and user name
+         w->tmp.len = 0;
+         if (w->uid)
+            o5w_uvar(&w->tmp, w->uid);
+         o5w_bytes(&w->tmp, "", 1);
+         if (w->usr.len)
+            o5w_bytes(&w->tmp, w->usr.buf, w->usr.len);
+         o5w_bytes(&w->tmp, "", 1);
+         if (w->tmp.err)
+            b->err = 1;
+         else
+            o5w_str(w, b, (char*) w->tmp.buf, w->tmp.len, 2);
+      }
+   }
+
+   w->sec.len = 0;
+   switch (t)
+   {
+      case O5W_NODE:
+         o5w_delta(b, &w->d.lon, w->lon);
+         o5w_delta(b, &w->d.lat, w->lat);
+         break;
+
+      case O5W_WAY:
+         for (i = 0; i < w->nref; i++)
+            o5w_delta(&w->sec, &w->d.ref[0], w->ref[i]);
+         break;
+
+      case O5W_REL:
+         // member references are delta coded separately for each type
+         for (i = 0, s = (char*) w->mem.buf; i < w->nref; i++, s = e)
+         {
+            e = s + strlen(s) + 1;
+            o5w_delta(&w->sec, &w->d.ref[*s - '0'], w->ref[i]);
+            o5w_str(w, &w->sec, s, e - s, 1);
+         }
+         break;
+   }
+
+   if (t != O5W_NODE)
+   {
+      if (w->sec.err)
+         b->err = 1;
+      o5w_uvar(b, w->sec.len);
+      if (w->sec.len)
+         o5w_bytes(b, w->sec.buf, w->sec.len);
+   }
+
+   // tags
+   for (s = (char*) w->kv.buf; s < (char*) w->kv.buf + w->kv.len; s = e)
+   {
+      e = s + strlen(s) + 1;
+      e += strlen(e) + 1;
+      o5w_str(w, b, s, e - s, 2);
+   }
+   if (w->kv.err || w->mem.err || w->usr.err)
+      b->err = 1;
+
+   w->cnt++;
+   return o5w_write(w, t, b);
+}
+
+
+/*! Start new object from the attributes of an XML element.
+ */
+static void o5w_obj_start(o5m_wctrl_t *w, const hpx_tag_t *t, int type)
+{
+   const hpx_attr_t *a;
+   int i;
+
+   w->type = type;
+   w->id = w->ver = w->ts = w->cs = w->uid = w->lat = w->lon = 0;
+   w->usr.len = w->kv.len = w->mem.len = 0;
+   w->nref = 0;
+
+   for (i = 0, a = t->attr; i < t->nattr; i++, a++)
+   {
+      if (!bs_cmp(a->name, "id"))
+         w->id = bs_tol(a->value);
+      else if (!bs_cmp(a->name, "lat"))
+         w->lat = ev_parse_coord(a->value);
+      else if (!bs_cmp(a->name, "lon"))
+         w->lon = ev_parse_coord(a->value);
+      else if (!bs_cmp(a->name, "version"))
+         w->ver = bs_tol(a->value);
+      else if (!bs_cmp(a->name, "timestamp"))
+      {
+         if ((w->ts = ev_parse_time(a->value)) == -1)
+            w->ts = 0;
+      }
+      else if (!bs_cmp(a->name, "changeset"))
+         w->cs = bs_tol(a->value);
+      else if (!bs_cmp(a->name, "uid"))
+         w->uid = bs_tol(a->value);
+      else if (!bs_cmp(a->name, "user"))
+      {
+         o5w_xstr(&w->usr, a->value);
+         // the terminating \0 is added when the pair is assembled
+         if (w->usr.len)
+            w->usr.len--;
+      }
+   }
+}
+
+
+/*! Add tag, node reference, or member to the current object.
+ */
+static void o5w_obj_sub(o5m_wctrl_t *w, const hpx_tag_t *t)
+{
+   bstring_t k = {0, ""}, v = {0, ""}, role = {0, ""};
+   int64_t ref = 0;
+   int i, type = -1;
+
+   if (!bs_cmp(t->tag, "tag"))
+   {
+      for (i = 0; i < t->nattr; i++)
+      {
+         if (!bs_cmp(t->attr[i].name, "k"))
+            k = t->attr[i].value;
+         else if (!bs_cmp(t->attr[i].name, "v"))
+            v = t->attr[i].value;
+      }
+      o5w_xstr(&w->kv, k);
+      o5w_xstr(&w->kv, v);
+   }
+   else if (!bs_cmp(t->tag, "nd") && w->type == O5W_WAY)
+   {
+      for (i = 0; i < t->nattr; i++)
+         if (!bs_cmp(t->attr[i].name, "ref"))
+            o5w_ref(w, bs_tol(t->attr[i].value));
+   }
+   else if (!bs_cmp(t->tag, "member") && w->type == O5W_REL)
+   {
+      for (i = 0; i < t->nattr; i++)
+      {
+         if (!bs_cmp(t->attr[i].name, "ref"))
+            ref = bs_tol(t->attr[i].value);
+         else if (!bs_cmp(t->attr[i].name, "type"))
+            type = !bs_cmp(t->attr[i].value, "node") ? 0 : !bs_cmp(t->attr[i].value, "way") ? 1 : 2;
+         else if (!bs_cmp(t->attr[i].name, "role"))
+            role = t->attr[i].value;
+      }
+      if (type == -1)
+         return;
+      o5w_ref(w, ref);
+      o5w_bytes(&w->mem, &"012"[type], 1);
+      o5w_xstr(&w->mem, role);
+   }
+}
+
+
+/*! Write bounding box dataset.
+ */
+static int o5w_bbox(o5m_wctrl_t *w, const hpx_tag_t *t)
+{
+   int64_t c[4] = {0, 0, 0, 0};
+   int i;
+
+   for (i = 0; i < t->nattr; i++)
+   {
+      if (!bs_cmp(t->attr[i].name, "minlon"))
+         c[0] = ev_parse_coord(t->attr[i].value);
+      else if (!bs_cmp(t->attr[i].name, "minlat"))
+         c[1] = ev_parse_coord(t->attr[i].value);
+      else if (!bs_cmp(t->attr[i].name, "maxlon"))
+         c[2] = ev_parse_coord(t->attr[i].value);
+      else if (!bs_cmp(t->attr[i].name, "maxlat"))
+         c[3] = ev_parse_coord(t->attr[i].value);
+   }
+
+   if (o5w_header(w) == -1)
+      return -1;
+
+   w->tmp.len = 0;
+   for (i = 0; i < 4; i++)
+      o5w_svar(&w->tmp, c[i]);
+   return o5w_write(w, O5W_BBOX, &w->tmp);
+}
+
+
+/*! Process XML element.
+ *  @param w Pointer to o5m writer.
+ *  @param t Element. Attribute values are expected to be XML-escaped.
+ *  @return 0 on success, -1 on error.
+ */
+int o5m_put_tag(o5m_wctrl_t *w, const hpx_tag_t *t)
+{
+   int type = 0;
+
+   if (w->err)
+      return -1;
+
+   if (!bs_cmp(t->tag, "node"))
+      type = O5W_NODE;
+   else if (!bs_cmp(t->tag, "way"))
+      type = O5W_WAY;
+   else if (!bs_cmp(t->tag, "relation"))
+      type = O5W_REL;
+
+   switch (t->type)
+   {
+      case HPX_OPEN:
+      case HPX_SINGLE:
+         if (w->type)
+         {
+            if (!type)
+               o5w_obj_sub(w, t);
+            break;
+         }
+
+         if (type)
+         {
+            o5w_obj_start(w, t, type);
+            if (t->type == HPX_SINGLE && o5w_obj_end(w) == -1)
+               goto o5w_err;
+            break;
+         }
+
+         // bounds are only written in front of the first object
+         if (!bs_cmp(t->tag, "bounds") && !w->cnt && o5w_bbox(w, t) == -1)
+            goto o5w_err;
+         break;
+
+      case HPX_CLOSE:
+         if (type && type == w->type && o5w_obj_end(w) == -1)
+            goto o5w_err;
+         break;
+   }
+
+   return 0;
+
+o5w_err:
+   w->err = errno ? errno : ENOMEM;
+   return -1;
+}
+
+
+/*! Create o5m writer.
+ *  @param f Output stream.
+ *  @return Pointer to writer or NULL on error with errno set.
+ */
+o5m_wctrl_t *o5m_wopen(FILE *f)
+{
+   o5m_wctrl_t *w;
+
+   if ((w = calloc(1, sizeof(*w))) == NULL)
+      return NULL;
+
+   if ((w->st = malloc(O5M_STR_TAB * sizeof(*w->st))) == NULL || (w->hash = calloc(O5W_HASH, sizeof(*w->hash))) == NULL)
+   {
+      free(w->st);
+      free(w);
+      return NULL;
+   }
+
+   w->f = f;
+   return w;
+}
+
+
+/*! Write end of file and free the writer. The output stream is not closed.
+ *  @return 0 on success, -1 if any error occured.
+ */
+int o5m_wclose(o5m_wctrl_t *w)
+{
+   int e = w->err ? -1 : 0;
+
+   if (!e && o5w_header(w) == -1)
+      e = -1;
+   if (!e && fputc(0xfe, w->f) == EOF)
+      e = -1;
+
+   free(w->st);
+   free(w->hash);
+   free(w->usr.buf);
+   free(w->kv.buf);
+   free(w->mem.buf);
+   free(w->ref);
+   free(w->ds.buf);
+   free(w->sec.buf);
+   free(w->tmp.buf);
+   if (w->err)
+      errno = w->err;
+   free(w);
+
+   return e;
+}
+
@@ -0,0 +1,1054 @@
+/* Copyright 2011 Bernhard R. Fischer, 2048R/5C5FFD47 <bf@abenteuerland.at>
+ *
+ * This file is part of smfilter.
+ *
+ * Smfilter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * Smfilter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with smfilter. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! This file contains the reader for the OSM PBF format. The blobs of the
+ *  file are read sequentially but they are inflated and decoded in parallel
+ *  by the threads of a job queue. Each block is converted into a list of XML
+ *  events which are returned in file order by pbf_get_tag(), thus the caller
+ *  sees the same hpx_tag_t structures as for OSM/XML input.
+ *
+ *  @author Bernhard R. Fischer
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <zlib.h>
+
+#include "osm_pbf.h"
+
+
+enum {PBF_UNKNOWN, PBF_HEADER, PBF_DATA};
+
+/*! Protobuf buffer.
+ */
+struct pb
+{
+   const uint8_t *p, *e;
+};
+
+/*! A file block. It holds the raw blob, the decoded data and the events.
+ */
+struct pbf_blk
+{
+   struct pbf_blk *next;
+   //! type of blob (PBF_HEADER, PBF_DATA)
+   int type;
+   //! raw blob as read from the file
+   char *raw;
+   size_t rlen, rmax;
+   //! uncompressed block
+   char *data;
+   size_t dmax;
+   //! references to string table entries
+   struct ev_ref *st;
+   int nst, mst;
+   //! resulting events
+   osm_evbuf_t eb;
+   //! errno if decoding failed, otherwise 0
+   int err;
+};
+
+/*! Parameters of a PrimitiveBlock.
+ */
+struct pbf_par
+{
+   int64_t gran, lat_off, lon_off, date_gran;
+};
+
+
+static int pb_varint(struct pb *b, uint64_t *v)
+{
+   uint64_t x = 0;
+   int s;
+
+   for (s = 0; b->p < b->e && s < 64; s += 7)
+   {
+      x |= (uint64_t) (*b->p & 0x7f) << s;
+      if (!(*b->p++ & 0x80))
+      {
+         *v = x;
+         return 0;
+      }
+   }
+
+   errno = EBADMSG;
+   return -1;
+}
+
+
+static int64_t pb_zz(uint64_t v)
+{
+   return (int64_t) (v >> 1) ^ -(int64_t) (v & 1);
+}
+
+
+/*! Read next field of a protobuf message.
+ *  @param b Buffer of message.
+ *  @param fn Receives the field number.
+ *  @param v Receives the value of varint fields.
+ *  @param d Receives the contents of length delimited fields.
+ *  @return 1 if a field was read, 0 at the end of the message, -1 on error.
+ */
+static int pb_next(struct pb *b, int *fn, uint64_t *v, struct pb *d)
+{
+   uint64_t k, l;
+
+   if (b->p >= b->e)
+      return 0;
+
+   if (pb_varint(b, &k) == -1)
+      return -1;
+
+   *fn = k >> 3;
+   *v = 0;
+   d->p = d->e = NULL;
+
+   switch (k & 7)
+   {
+      case 0:
+         return pb_varint(b, v) == -1 ? -1 : 1;
+
+      case 1:
+         l = 8;
+         break;
+
+      case 2:
+         if (pb_varint(b, &l) == -1)
+            return -1;
+         if (l > (uint64_t) (b->e - b->p))
+            break;
+         d->p = b->p;
+         d->e = b->p + l;
+         b->p += l;
+         return 1;
+
+      case 5:
+         l = 4;
+         break;
+
+      default:
+         errno = EBADMSG;
+         return -1;
+   }
+
+   if (l > (uint64_t) (b->e - b->p))
+   {
+      errno = EBADMSG;
+      return -1;
+   }
+   b->p += l;
+   return 1;
+}
+
+
+/*! Read exactly len bytes from file descriptor.
+ *  @return 1 on success, 0 on eof before the first byte, -1 on error. A
+ *  truncated read is an error (errno = EIO).
+ */
+static int pbf_read(int fd, void *buf, size_t len)
+{
+   size_t n;
+   ssize_t s;
+
+   for (n = 0; n < len; n += s)
+   {
+      if ((s = read(fd, (char*) buf + n, len - n)) == -1)
+      {
+         if (errno == EINTR)
+         {
+            s = 0;
+            continue;
+         }
+         return -1;
+      }
+      if (!s)
+      {
+         if (!n)
+            return 0;
+         errno = EIO;
+         return -1;
+      }
+   }
+   return 1;
+}
+
+
+/*! Read next BlobHeader and Blob from file.
+ *  @return 1 on success, 0 on eof, -1 on error.
+ */
+static int pbf_read_blob(int fd, struct pbf_blk *blk)
+{
+   uint8_t hbuf[PBF_MAX_HDR], l[4];
+   struct pb b, d;
+   uint64_t v, dsize = 0;
+   uint32_t hlen;
+   char *raw;
+   int e, fn;
+
+   if ((e = pbf_read(fd, l, 4)) <= 0)
+      return e;
+
+   hlen = (uint32_t) l[0] << 24 | l[1] << 16 | l[2] << 8 | l[3];
+   if (hlen > PBF_MAX_HDR)
+   {
+      errno = EBADMSG;
+      return -1;
+   }
+   if (pbf_read(fd, hbuf, hlen) != 1)
+   {
+      errno = EIO;
+      return -1;
+   }
+
+   blk->type = PBF_UNKNOWN;
+   b.p = hbuf;
+   b.e = hbuf + hlen;
+   while ((e = pb_next(&b, &fn, &v, &d)) == 1)
+   {
+      if (fn == 1 && d.p != NULL)
+      {
+         if (d.e - d.p == 9 && !memcmp(d.p, "OSMHeader", 9))
+            blk->type = PBF_HEADER;
+         else if (d.e - d.p == 7 && !memcmp(d.p, "OSMData", 7))
+            blk->type = PBF_DATA;
+      }
+      else if (fn == 3)
+         dsize = v;
+   }
+   if (e == -1)
+      return -1;
+
+   if (dsize > PBF_MAX_BLOB)
+   {
+      errno = EBADMSG;
+      return -1;
+   }
+
+   if (dsize > blk->rmax)
+   {
+      if ((raw = realloc(blk->raw, dsize)) == NULL)
+         return -1;
+      blk->raw = raw;
+      blk->rmax = dsize;
+   }
+   blk->rlen = dsize;
+
+   if (pbf_read(fd, blk->raw, dsize) != 1)
+   {
+      errno = EIO;
+      return -1;
+   }
+
+   return 1;
+}
+
+
+/*! Uncompress blob into blk->data.
+ *  @param len Receives the length of the block.
+ *  @return 0 on success, -1 on error.
+ */
+static int pbf_inflate(struct pbf_blk *blk, size_t *len)
+{
+   struct pb b, d, z = {NULL, NULL}, r = {NULL, NULL};
+   uint64_t v, rsize = 0;
+   uLongf dlen;
+   char *data;
+   int e, fn;
+
+   b.p = (uint8_t*) blk->raw;
+   b.e = b.p + blk->rlen;
+   while ((e = pb_next(&b, &fn, &v, &d)) == 1)
+   {
+      switch (fn)
+      {
+         case 1:
+            r = d;
+            break;
+         case 2:
+            rsize = v;
+            break;
+         case 3:
+            z = d;
+            break;
+         case 4:
+         case 5:
+         case 6:
+         case 7:
+            // lzma, bzip2, lz4, zstd
+            errno = ENOTSUP;
+            return -1;
+      }
+   }
+   if (e == -1)
+      return -1;
+
+   if (r.p != NULL)
+   {
+      rsize = r.e - r.p;
+      if (rsize > blk->dmax)
+      {
+         if ((data = realloc(blk->data, rsize)) == NULL)
+            return -1;
+         blk->data = data;
+         blk->dmax = rsize;
+      }
+      memcpy(blk->data, r.p, rsize);
+      *len = rsize;
+      return 0;
+   }
+
+   if (z.p == NULL || rsize > PBF_MAX_BLOB)
+   {
+      errno = EBADMSG;
+      return -1;
+   }
+
+   if (rsize > blk->dmax)
+   {
+      if ((data = realloc(blk->data, rsize)) == NULL)
+         return -1;
+      blk->data = data;
+      blk->dmax = rsize;
+   }
+
+   dlen = rsize;
+   if (uncompress((Bytef*) blk->data, &dlen, z.p, z.e - z.p) != Z_OK || dlen != rsize)
+   {
+      errno = EBADMSG;
+      return -1;
+   }
+   *len = dlen;
+
+   return 0;
+}
+
+
+/*! Convert coordinate of PBF into units of 10^-7 degrees.
+ */
+static int64_t pbf_coord(int64_t off, int64_t gran, int64_t v)
+{
+   v = off + gran * v;
+   return v >= 0 ? (v + 50) / 100 : (v - 50) / 100;
+}
+
+
+/*! Add attribute which is a string of the string table.
+ */
+static int pbf_strattr(struct pbf_blk *blk, int name, uint64_t i)
+{
+   if (i >= (uint64_t) blk->nst)
+   {
+      errno = EBADMSG;
+      return -1;
+   }
+   return ev_attr(&blk->eb, name, &blk->st[i]);
+}
+
+
+/*! Add a <tag k=.. v=../> event.
+ */
+static int pbf_tag(struct pbf_blk *blk, uint64_t k, uint64_t v)
+{
+   if (ev_add(&blk->eb, HPX_SINGLE, EV_TAG) == -1)
+      return -1;
+   if (pbf_strattr(blk, EV_K, k) == -1)
+      return -1;
+   return pbf_strattr(blk, EV_V, v);
+}
+
+
+/*! Add the tags of packed key and value index arrays.
+ */
+static int pbf_tags(struct pbf_blk *blk, struct pb k, struct pb v)
+{
+   uint64_t ki, vi;
+
+   while (k.p < k.e)
+   {
+      if (pb_varint(&k, &ki) == -1 || pb_varint(&v, &vi) == -1)
+         return -1;
+      if (pbf_tag(blk, ki, vi) == -1)
+         return -1;
+   }
+   return 0;
+}
+
+
+/*! Decode Info message and add its attributes to the last event.
+ */
+static int pbf_info(struct pbf_blk *blk, struct pb b, const struct pbf_par *par)
+{
+   int64_t ver = -1, ts = -1, cs = -1, uid = -1, usr = -1, vis = -1;
+   struct pb d;
+   uint64_t v;
+   int e, fn;
+
+   while ((e = pb_next(&b, &fn, &v, &d)) == 1)
+   {
+      switch (fn)
+      {
+         case 1: ver = v; break;
+         case 2: ts = v; break;
+         case 3: cs = v; break;
+         case 4: uid = v; break;
+         case 5: usr = v; break;
+         case 6: vis = v; break;
+      }
+   }
+   if (e == -1)
+      return -1;
+
+   if (ver != -1 && ev_long(&blk->eb, EV_VERSION, (int32_t) ver) == -1)
+      return -1;
+   if (ts != -1 && ev_time(&blk->eb, EV_TIMESTAMP, ts * par->date_gran / 1000) == -1)
+      return -1;
+   if (cs != -1 && ev_long(&blk->eb, EV_CHANGESET, cs) == -1)
+      return -1;
+   if (uid != -1 && ev_long(&blk->eb, EV_UID, (int32_t) uid) == -1)
+      return -1;
+   if (usr != -1 && pbf_strattr(blk, EV_USER, usr) == -1)
+      return -1;
+   if (vis != -1 && ev_cstr(&blk->eb, EV_VISIBLE, vis ? "true" : "false") == -1)
+      return -1;
+
+   return 0;
+}
+
+
+static int pbf_node(struct pbf_blk *blk, struct pb b, const struct pbf_par *par)
+{
+   struct pb d, k = {NULL, NULL}, v = {NULL, NULL}, info = {NULL, NULL};
+   int64_t id = 0, lat = 0, lon = 0;
+   uint64_t u;
+   int e, fn;
+
+   while ((e = pb_next(&b, &fn, &u, &d)) == 1)
+   {
+      switch (fn)
+      {
+         case 1: id = pb_zz(u); break;
+         case 2: k = d; break;
+         case 3: v = d; break;
+         case 4: info = d; break;
+         case 8: lat = pb_zz(u); break;
+         case 9: lon = pb_zz(u); break;
+      }
+   }
+   if (e == -1)
+      return -1;
+
+   if (ev_add(&blk->eb, k.p < k.e ? HPX_OPEN : HPX_SINGLE, EV_NODE) == -1)
+      return -1;
+   if (ev_long(&blk->eb, EV_ID, id) == -1)
+      return -1;
+   if (info.p != NULL && pbf_info(blk, info, par) == -1)
+      return -1;
+   if (ev_coord(&blk->eb, EV_LAT, pbf_coord(par->lat_off, par->gran, lat)) == -1)
+      return -1;
+   if (ev_coord(&blk->eb, EV_LON, pbf_coord(par->lon_off, par->gran, lon)) == -1)
+      return -1;
+   if (k.p == k.e)
+      return 0;
+   if (pbf_tags(blk, k, v) == -1)
+      return -1;
+   return ev_add(&blk->eb, HPX_CLOSE, EV_NODE);
+}
+
+
+static int pbf_dense(struct pbf_blk *blk, struct pb b, const struct pbf_par *par)
+{
+   struct pb d, id = {NULL, NULL}, lat = {NULL, NULL}, lon = {NULL, NULL}, kv = {NULL, NULL}, di = {NULL, NULL};
+   struct pb ver = {NULL, NULL}, ts = {NULL, NULL}, cs = {NULL, NULL}, uid = {NULL, NULL}, usr = {NULL, NULL}, vis = {NULL, NULL};
+   int64_t nid = 0, nlat = 0, nlon = 0, nts = 0, ncs = 0, nuid = 0, nusr = 0;
+   uint64_t u, k, v;
+   int e, fn;
+
+   while ((e = pb_next(&b, &fn, &u, &d)) == 1)
+   {
+      switch (fn)
+      {
+         case 1: id = d; break;
+         case 5: di = d; break;
+         case 8: lat = d; break;
+         case 9: lon = d; break;
+         case 10: kv = d; break;
+      }
+   }
+   if (e == -1)
+      return -1;
+
+   while ((e = pb_next(&di, &fn, &u, &d)) == 1)
+   {
+      switch (fn)
+      {
+         case 1: ver = d; break;
+         case 2: ts = d; break;
+         case 3: cs = d; break;
+         case 4: uid = d; break;
+         case 5: usr = d; break;
+         case 6: vis = d; break;
+      }
+   }
+   if (e == -1)
+      return -1;
+
+   while (id.p < id.e)
+   {
+      if (pb_varint(&id, &u) == -1)
+         return -1;
+      nid += pb_zz(u);
+      if (pb_varint(&lat, &u) == -1)
+         return -1;
+      nlat += pb_zz(u);
+      if (pb_varint(&lon, &u) == -1)
+         return -1;
+      nlon += pb_zz(u);
+
+      // the key/value list of each node is terminated by 0
+      k = 0;
+      if (kv.p < kv.e && pb_varint(&kv, &k) == -1)
+         return -1;
+
+      if (ev_add(&blk->eb, k ? HPX_OPEN : HPX_SINGLE, EV_NODE) == -1)
+         return -1;
+      if (ev_long(&blk->eb, EV_ID, nid) == -1)
+         return -1;
+
+      if (ver.p < ver.e)
+      {
+         if (pb_varint(&ver, &u) == -1)
+            return -1;
+         if (ev_long(&blk->eb, EV_VERSION, (int32_t) u) == -1)
+            return -1;
+      }
+      if (ts.p < ts.e)
+      {
+         if (pb_varint(&ts, &u) == -1)
+            return -1;
+         nts += pb_zz(u);
+         if (ev_time(&blk->eb, EV_TIMESTAMP, nts * par->date_gran / 1000) == -1)
+            return -1;
+      }
+      if (cs.p < cs.e)
+      {
+         if (pb_varint(&cs, &u) == -1)
+            return -1;
+         ncs += pb_zz(u);
+         if (ev_long(&blk->eb, EV_CHANGESET, ncs) == -1)
+            return -1;
+      }
+      if (uid.p < uid.e)
+      {
+         if (pb_varint(&uid, &u) == -1)
+            return -1;
+         nuid += pb_zz(u);
+         if (ev_long(&blk->eb, EV_UID, (int32_t) nuid) == -1)
+            return -1;
+      }
+      if (usr.p < usr.e)
+      {
+         if (pb_varint(&usr, &u) == -1)
+            return -1;
+         nusr += pb_zz(u);
+         if (pbf_strattr(blk, EV_USER, nusr) == -1)
+            return -1;
+      }
+      if (vis.p < vis.e)
+      {
+         if (pb_varint(&vis, &u) == -1)
+            return -1;
+         if (ev_cstr(&blk->eb, EV_VISIBLE, u ? "true" : "false") == -1)
+            return -1;
+      }
+
+      if (ev_coord(&blk->eb, EV_LAT, pbf_coord(par->lat_off, par->gran, nlat)) == -1)
+         return -1;
+      if (ev_coord(&blk->eb, EV_LON, pbf_coord(par->lon_off, par->gran, nlon)) == -1)
+         return -1;
+
+      if (!k)
+         continue;
+
+      for (; k; )
+      {
+         if (pb_varint(&kv, &v) == -1)
+            return -1;
+         if (pbf_tag(blk, k, v) == -1)
+            return -1;
+         if (pb_varint(&kv, &k) == -1)
+            return -1;
+      }
+
+      if (ev_add(&blk->eb, HPX_CLOSE, EV_NODE) == -1)
+         return -1;
+   }
+
+   return 0;
+}
+
+
+static int pbf_way(struct pbf_blk *blk, struct pb b, const struct pbf_par *par)
+{
+   struct pb d, k = {NULL, NULL}, v = {NULL, NULL}, info = {NULL, NULL}, refs = {NULL, NULL};
+   int64_t id = 0, ref = 0;
+   uint64_t u;
+   int e, fn;
+
+   while ((e = pb_next(&b, &fn, &u, &d)) == 1)
+   {
+      switch (fn)
+      {
+         case 1: id = u; break;
+         case 2: k = d; break;
+         case 3: v = d; break;
+         case 4: info = d; break;
+         case 8: refs = d; break;
+      }
+   }
+   if (e == -1)
+      return -1;
+
+   if (ev_add(&blk->eb, k.p < k.e || refs.p < refs.e ? HPX_OPEN : HPX_SINGLE, EV_WAY) == -1)
+      return -1;
+   if (ev_long(&blk->eb, EV_ID, id) == -1)
+      return -1;
+   if (info.p != NULL && pbf_info(blk, info, par) == -1)
+      return -1;
+   if (k.p == k.e && refs.p == refs.e)
+      return 0;
+
+   while (refs.p < refs.e)
+   {
+      if (pb_varint(&refs, &u) == -1)
+         return -1;
+      ref += pb_zz(u);
+      if (ev_add(&blk->eb, HPX_SINGLE, EV_ND) == -1)
+         return -1;
+      if (ev_long(&blk->eb, EV_REF, ref) == -1)
+         return -1;
+   }
+
+   if (pbf_tags(blk, k, v) == -1)
+      return -1;
+   return ev_add(&blk->eb, HPX_CLOSE, EV_WAY);
+}
+
+
+static int pbf_relation(struct pbf_blk *blk, struct pb b, const struct pbf_par *par)
+{
+   static const char *mtype[] = {"node", "way", "relation"};
+   struct pb d, k = {NULL, NULL}, v = {NULL, NULL}, info = {NULL, NULL};
+   struct pb roles = {NULL, NULL}, ids = {NULL, NULL}, types = {NULL, NULL};
+   int64_t id = 0, ref = 0;
+   uint64_t u, t, r;
+   int e, fn;
+
+   while ((e = pb_next(&b, &fn, &u, &d)) == 1)
+   {
+      switch (fn)
+      {
+         case 1: id = u; break;
+         case 2: k = d; break;
+         case 3: v = d; break;
+         case 4: info = d; break;
+         case 8: roles = d; break;
+         case 9: ids = d; break;
+         case 10: types = d; break;
+      }
+   }
+   if (e == -1)
+      return -1;
+
+   if (ev_add(&blk->eb, k.p < k.e || ids.p < ids.e ? HPX_OPEN : HPX_SINGLE, EV_RELATION) == -1)
+      return -1;
+   if (ev_long(&blk->eb, EV_ID, id) == -1)
+      return -1;
+   if (info.p != NULL && pbf_info(blk, info, par) == -1)
+      return -1;
+   if (k.p == k.e && ids.p == ids.e)
+      return 0;
+
+   while (ids.p < ids.e)
+   {
+      if (pb_varint(&ids, &u) == -1 || pb_varint(&types, &t) == -1 || pb_varint(&roles, &r) == -1)
+         return -1;
+      ref += pb_zz(u);
+      if (t > 2)
+      {
+         errno = EBADMSG;
+         return -1;
+      }
+      if (ev_add(&blk->eb, HPX_SINGLE, EV_MEMBER) == -1)
+         return -1;
+      if (ev_cstr(&blk->eb, EV_TYPE, mtype[t]) == -1)
+         return -1;
+      if (ev_long(&blk->eb, EV_REF, ref) == -1)
+         return -1;
+      if (pbf_strattr(blk, EV_ROLE, r) == -1)
+         return -1;
+   }
+
+   if (pbf_tags(blk, k, v) == -1)
+      return -1;
+   return ev_add(&blk->eb, HPX_CLOSE, EV_RELATION);
+}
+
+
+/*! Decode PrimitiveBlock.
+ */
+static int pbf_primblock(struct pbf_blk *blk, struct pb b)
+{
+   struct pbf_par par = {100, 0, 0, 1000};
+   struct pb d, s, g, st = {NULL, NULL}, grp = b;
+   struct ev_ref *r;
+   uint64_t v;
+   int e, fn, n;
+
+   // parameters may follow the groups, thus they are parsed first
+   while ((e = pb_next(&b, &fn, &v, &d)) == 1)
+   {
+      switch (fn)
+      {
+         case 1: st = d; break;
+         case 17: par.gran = (int32_t) v; break;
+         case 18: par.date_gran = (int32_t) v; break;
+         case 19: par.lat_off = v; break;
+         case 20: par.lon_off = v; break;
+      }
+   }
+   if (e == -1)
+      return -1;
+
+   // string table
+   blk->nst = 0;
+   while ((e = pb_next(&st, &fn, &v, &s)) == 1)
+   {
+      if (fn != 1 || s.p == NULL)
+         continue;
+      if (blk->nst >= blk->mst)
+      {
+         n = blk->mst ? blk->mst << 1 : 1024;
+         if ((r = realloc(blk->st, n * sizeof(*r))) == NULL)
+            return -1;
+         blk->st = r;
+         blk->mst = n;
+      }
+      if (ev_str(&blk->eb, (const char*) s.p, s.e - s.p, &blk->st[blk->nst]) == -1)
+         return -1;
+      blk->nst++;
+   }
+   if (e == -1)
+      return -1;
+
+   // primitive groups
+   while ((e = pb_next(&grp, &fn, &v, &g)) == 1)
+   {
+      if (fn != 2 || g.p == NULL)
+         continue;
+
+      while ((e = pb_next(&g, &fn, &v, &d)) == 1)
+      {
+         if (d.p == NULL)
+            continue;
+         switch (fn)
+         {
+            case 1: e = pbf_node(blk, d, &par); break;
+            case 2: e = pbf_dense(blk, d, &par); break;
+            case 3: e = pbf_way(blk, d, &par); break;
+            case 4: e = pbf_relation(blk, d, &par); break;
+         }
+         if (e == -1)
+            return -1;
+      }
+      if (e == -1)
+         return -1;
+   }
+
+   return e;
+}
+
+
+/*! Decode HeaderBlock. Unsupported required features result in an error.
+ */
+static int pbf_header(struct pbf_blk *blk, struct pb b)
+{
+   static const char *feat[] = {"OsmSchema-V0.6", "DenseNodes", "HistoricalInformation", NULL};
+   struct pb d, bb = {NULL, NULL}, prog = {NULL, NULL};
+   int64_t c[4] = {0, 0, 0, 0};
+   struct ev_ref r;
+   uint64_t v;
+   int e, fn, i;
+
+   while ((e = pb_next(&b, &fn, &v, &d)) == 1)
+   {
+      switch (fn)
+      {
+         case 1:
+            bb = d;
+            break;
+
+         case 4:
+            for (i = 0; feat[i] != NULL; i++)
+               if (strlen(feat[i]) == d.e - d.p && !memcmp(feat[i], d.p, d.e - d.p))
+                  break;
+            if (feat[i] == NULL)
+            {
+               errno = ENOTSUP;
+               return -1;
+            }
+            break;
+
+         case 16:
+            prog = d;
+            break;
+      }
+   }
+   if (e == -1)
+      return -1;
+
+   if (ev_add(&blk->eb, HPX_INSTR, EV_XML) == -1)
+      return -1;
+   if (ev_cstr(&blk->eb, EV_VERSION, "1.0") == -1 || ev_cstr(&blk->eb, EV_ENCODING, "UTF-8") == -1)
+      return -1;
+   if (ev_add(&blk->eb, HPX_OPEN, EV_OSM) == -1)
+      return -1;
+   if (ev_cstr(&blk->eb, EV_VERSION, "0.6") == -1)
+      return -1;
+   if (prog.p != NULL)
+   {
+      if (ev_str(&blk->eb, (const char*) prog.p, prog.e - prog.p, &r) == -1)
+         return -1;
+      if (ev_attr(&blk->eb, EV_GENERATOR, &r) == -1)
+         return -1;
+   }
+
+   if (bb.p == NULL)
+      return 0;
+
+   // left, right, top, bottom
+   while ((e = pb_next(&bb, &fn, &v, &d)) == 1)
+      if (fn >= 1 && fn <= 4)
+         c[fn - 1] = pb_zz(v);
+   if (e == -1)
+      return -1;
+
+   if (ev_add(&blk->eb, HPX_SINGLE, EV_BOUNDS) == -1)
+      return -1;
+   if (ev_coord(&blk->eb, EV_MINLAT, pbf_coord(0, 1, c[3])) == -1 ||
+         ev_coord(&blk->eb, EV_MINLON, pbf_coord(0, 1, c[0])) == -1 ||
+         ev_coord(&blk->eb, EV_MAXLAT, pbf_coord(0, 1, c[2])) == -1 ||
+         ev_coord(&blk->eb, EV_MAXLON, pbf_coord(0, 1, c[1])) == -1)
+      return -1;
+
+   return 0;
+}
+
+
+/*! Job function which decodes a block. It is called by the threads of the
+ *  job queue.
+ */
+static void pbf_decode(void *p)
+{
+   struct pbf_blk *blk = p;
+   struct pb b;
+   size_t len;
+   int e = 0;
+
+   ev_clear(&blk->eb);
+   blk->eb.data = NULL;
+   blk->err = 0;
+
+   if (blk->type == PBF_UNKNOWN)
+      return;
+
+   if (pbf_inflate(blk, &len) == -1)
+   {
+      blk->err = errno;
+      return;
+   }
+
+   blk->eb.data = blk->data;
+   b.p = (uint8_t*) blk->data;
+   b.e = b.p + len;
+
+   if (blk->type == PBF_HEADER)
+      e = pbf_header(blk, b);
+   else
+      e = pbf_primblock(blk, b);
+
+   if (e == -1)
+      blk->err = errno ? errno : EBADMSG;
+}
+
+
+static void pbf_blk_free(struct pbf_blk *blk)
+{
+   ev_free(&blk->eb);
+   free(blk->st);
+   free(blk->data);
+   free(blk->raw);
+   free(blk);
+}
+
+
+/*! Create control structure of PBF reader.
+ *  @param fd File descriptor of input file.
+ *  @param nthreads Number of decoder threads. If 0, blocks are decoded
+ *  synchronously.
+ *  @return Pointer to pbf_ctrl_t structure or NULL on error with errno set.
+ */
+pbf_ctrl_t *pbf_init(int fd, int nthreads)
+{
+   pbf_ctrl_t *ctl;
+
+   if ((ctl = calloc(1, sizeof(*ctl))) == NULL)
+      return NULL;
+
+   if ((ctl->jq = jq_init(nthreads, pbf_decode)) == NULL)
+   {
+      free(ctl);
+      return NULL;
+   }
+
+   ctl->fd = fd;
+   ctl->maxflight = nthreads ? nthreads * 2 : 1;
+   if (ctl->maxflight > JQ_MAX)
+      ctl->maxflight = JQ_MAX;
+
+   return ctl;
+}
+
+
+void pbf_free(pbf_ctrl_t *ctl)
+{
+   struct pbf_blk *blk;
+
+   while ((blk = jq_next(ctl->jq)) != NULL)
+      pbf_blk_free(blk);
+   jq_free(ctl->jq);
+
+   if (ctl->cur != NULL)
+      pbf_blk_free(ctl->cur);
+
+   while ((blk = ctl->pool) != NULL)
+   {
+      ctl->pool = blk->next;
+      pbf_blk_free(blk);
+   }
+
+   ev_free(&ctl->eb);
+   free(ctl);
+}
+
+
+/*! Read blobs and submit them to the decoder threads until the maximum
+ *  number of blocks is in flight.
+ *  @return 0 on success, -1 on error.
+ */
+static int pbf_fill(pbf_ctrl_t *ctl)
+{
+   struct pbf_blk *blk;
+   int e;
+
+   while (!ctl->eof && jq_pending(ctl->jq) < ctl->maxflight)
+   {
+      if ((blk = ctl->pool) != NULL)
+         ctl->pool = blk->next;
+      else if ((blk = calloc(1, sizeof(*blk))) == NULL)
+         return -1;
+
+      if ((e = pbf_read_blob(ctl->fd, blk)) <= 0)
+      {
+         blk->next = ctl->pool;
+         ctl->pool = blk;
+         if (e == -1)
+            return -1;
+         ctl->eof = 1;
+         break;
+      }
+
+      if (jq_submit(ctl->jq, blk) == -1)
+         return -1;
+   }
+
+   return 0;
+}
+
+
+/*! Get next element of the PBF file as hpx_tag_t structure. The strings
+ *  within tag are valid until the next call to pbf_get_tag().
+ *  @param ctl Pointer to pbf_ctrl_t structure.
+ *  @param tag Pointer to tag which receives the element. The number of
+ *  attributes is limited to tag->mattr.
+ *  @return 1 if a tag was returned, 0 on eof, -1 on error with errno set.
+ */
+int pbf_get_tag(pbf_ctrl_t *ctl, hpx_tag_t *tag)
+{
+   struct pbf_blk *blk;
+
+   for (;;)
+   {
+      if (ctl->cur != NULL)
+      {
+         if (ev_get_tag(&ctl->cur->eb, tag))
+         {
+            tag->line = 0;
+            return 1;
+         }
+
+         ctl->cur->next = ctl->pool;
+         ctl->pool = ctl->cur;
+         ctl->cur = NULL;
+      }
+
+      if (ctl->fin)
+      {
+         if (!ev_get_tag(&ctl->eb, tag))
+            return 0;
+         tag->line = 0;
+         return 1;
+      }
+
+      if (pbf_fill(ctl) == -1)
+         return -1;
+
+      if ((blk = jq_next(ctl->jq)) == NULL)
+      {
+         ctl->fin = 1;
+         ev_clear(&ctl->eb);
+         if (ctl->open && ev_add(&ctl->eb, HPX_CLOSE, EV_OSM) == -1)
+            return -1;
+         continue;
+      }
+
+      if (blk->err)
+      {
+         errno = blk->err;
+         blk->next = ctl->pool;
+         ctl->pool = blk;
+         return -1;
+      }
+
+      if (blk->type == PBF_HEADER)
+         ctl->open = 1;
+      ctl->cur = blk;
+   }
+}
+
@@ -0,0 +1,69 @@
+/* Copyright 2011 Bernhard R. Fischer, 2048R/5C5FFD47 <bf@abenteuerland.at>
+ *
+ * This file is part of smfilter.
+ *
+ * Smfilter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * Smfilter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with smfilter. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OSM_PBF_H
+#define OSM_PBF_H
+
+#include <stdio.h>
+
+#include "libhpxml.h"
+#include "osm_evbuf.h"
+#include "jobq.h"
+
+
+//! maximum size of a BlobHeader
+#define PBF_MAX_HDR (64 * 1024)
+//! maximum size of a Blob
+#define PBF_MAX_BLOB (32 * 1024 * 1024)
+//! number of entities per block written by the PBF writer
+#define PBF_BLK_ENTITIES 8000
+
+
+typedef struct pbf_ctrl
+{
+   //! file descriptor of input file
+   int fd;
+   //! job queue of block decoder threads
+   jobq_t *jq;
+   //! maximum number of blocks in flight
+   int maxflight;
+   //! block which is currently returned to the caller
+   struct pbf_blk *cur;
+   //! list of unused blocks
+   struct pbf_blk *pool;
+   //! flag set if eof of input
+   short eof;
+   //! flag set if <osm> was opened
+   short open;
+   //! flag set if closing events are returned
+   short fin;
+   //! events after the last block
+   osm_evbuf_t eb;
+} pbf_ctrl_t;
+
+typedef struct pbf_wctrl pbf_wctrl_t;
+
+
+pbf_ctrl_t *pbf_init(int fd, int nthreads);
+void pbf_free(pbf_ctrl_t *ctl);
+int pbf_get_tag(pbf_ctrl_t *ctl, hpx_tag_t *tag);
+pbf_wctrl_t *pbf_wopen(FILE *f, int nthreads);
+int pbf_put_tag(pbf_wctrl_t *w, const hpx_tag_t *t);
+int pbf_wclose(pbf_wctrl_t *w);
+
+#endif
+
@@ -0,0 +1,928 @@
+/* Copyright 2011 Bernhard R. Fischer, 2048R/5C5FFD47 <bf@abenteuerland.at>
+ *
+ * This file is part of smfilter.
+ *
+ * Smfilter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * Smfilter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with smfilter. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! This file contains the writer for the OSM PBF format. It receives XML
+ *  elements (hpx_tag_t) and assembles them into OSM objects. The objects are
+ *  collected into PrimitiveBlocks with dense nodes, ways and relations. Each
+ *  block is serialized by the calling thread but deflated in parallel by the
+ *  threads of a job queue. The blobs are written in order.
+ *
+ *  @author Bernhard R. Fischer
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <zlib.h>
+
+#include "osm_pbf.h"
+
+
+//! group types
+enum {PW_NONE, PW_DENSE, PW_WAY, PW_REL};
+
+/*! Growable buffer for protobuf encoding. Allocation errors are sticky and
+ *  checked when the block is finished.
+ */
+struct pbuf
+{
+   uint8_t *buf;
+   size_t len, max;
+   int err;
+};
+
+/*! Growable array of 64 bit integers.
+ */
+struct i64a
+{
+   int64_t *v;
+   size_t n, max;
+   int err;
+};
+
+/*! OSM object which is assembled from XML elements.
+ */
+struct pw_obj
+{
+   int type;
+   int64_t id, ver, ts, cs, uid, lat, lon;
+   int64_t usr;
+   //! string indices of keys and values (alternating)
+   struct i64a kv;
+   //! node references or member ids
+   struct i64a ref;
+   //! member types and role string indices (alternating)
+   struct i64a mem;
+};
+
+/*! Block which is assembled and encoded.
+ */
+struct pw_blk
+{
+   struct pw_blk *next;
+   //! serialized PrimitiveBlock
+   struct pbuf pb;
+   //! resulting blob including BlobHeader
+   struct pbuf out;
+   //! offset and length of the blob within out
+   size_t off, size;
+   //! type of blob ("OSMHeader" or "OSMData")
+   const char *type;
+   int err;
+};
+
+struct pbf_wctrl
+{
+   FILE *f;
+   jobq_t *jq;
+   int maxflight;
+   struct pw_blk *pool;
+   //! flag set if header block was written
+   int hdr;
+   //! bounding box of <bounds> element (left, right, top, bottom)
+   int64_t bbox[4];
+   int has_bbox;
+   //! current object
+   struct pw_obj obj;
+   //! number of entities in current block
+   int cnt;
+   //! string table
+   struct pbuf st;
+   //! offset and length of each string within the string table
+   struct i64a sidx;
+   //! hash table of string indices (0 = unused)
+   int32_t *hash;
+   int hsize;
+   //! finished groups of current block
+   struct pbuf grp;
+   //! type of current group
+   int gtype;
+   //! dense nodes of current group
+   struct i64a d_id, d_lat, d_lon, d_ver, d_ts, d_cs, d_uid, d_usr, d_kv;
+   //! ways or relations of current group
+   struct pbuf g;
+   //! temporary buffers
+   struct pbuf t0, t1;
+   //! buffer for unescaped strings
+   char *ubuf;
+   long ulen;
+   int err;
+};
+
+
+static void pw_reserve(struct pbuf *b, size_t n)
+{
+   uint8_t *p;
+   size_t m;
+
+   if (b->len + n <= b->max)
+      return;
+
+   for (m = b->max ? b->max : 4096; m < b->len + n; m <<= 1);
+   if ((p = realloc(b->buf, m)) == NULL)
+   {
+      b->err = 1;
+      return;
+   }
+   b->buf = p;
+   b->max = m;
+}
+
+
+static void pw_varint(struct pbuf *b, uint64_t v)
+{
+   pw_reserve(b, 10);
+   if (b->err)
+      return;
+   for (; v >= 0x80; v >>= 7)
+      b->buf[b->len++] = (v & 0x7f) | 0x80;
+   b->buf[b->len++] = v;
+}
+
+
+static uint64_t pw_zz(int64_t v)
+{
+   return ((uint64_t) v << 1) ^ (uint64_t) (v >> 63);
+}
+
+
+static void pw_uint(struct pbuf *b, int fn, uint64_t v)
+{
+   pw_varint(b, fn << 3);
+   pw_varint(b, v);
+}
+
+
+static void pw_sint(struct pbuf *b, int fn, int64_t v)
+{
+   pw_uint(b, fn, pw_zz(v));
+}
+
+
+static void pw_bytes(struct pbuf *b, int fn, const void *d, size_t len)
+{
+   pw_varint(b, fn << 3 | 2);
+   pw_varint(b, len);
+   pw_reserve(b, len);
+   if (b->err)
+      return;
+   memcpy(b->buf + b->len, d, len);
+   b->len += len;
+}
+
+
+/*! Append contents of buffer s as length delimited field to b and clear s.
+ */
+static void pw_msg(struct pbuf *b, int fn, struct pbuf *s)
+{
+   if (s->err)
+      b->err = 1;
+   pw_bytes(b, fn, s->buf, s->len);
+   s->len = 0;
+}
+
+
+static void i64_add(struct i64a *a, int64_t v)
+{
+   int64_t *p;
+   size_t m;
+
+   if (a->n >= a->max)
+   {
+      m = a->max ? a->max << 1 : 1024;
+      if ((p = realloc(a->v, m * sizeof(*p))) == NULL)
+      {
+         a->err = 1;
+         return;
+      }
+      a->v = p;
+      a->max = m;
+   }
+   a->v[a->n++] = v;
+}
+
+
+/*! Add packed field of array a to b.
+ *  @param delta Delta and zigzag encode values if set to 1, plain varints if
+ *  set to 0.
+ */
+static void pw_packed(struct pbuf *b, struct pbuf *t, int fn, const struct i64a *a, int delta)
+{
+   int64_t p = 0;
+   size_t i;
+
+   if (a->err)
+      b->err = 1;
+   if (!a->n)
+      return;
+
+   t->len = 0;
+   for (i = 0; i < a->n; i++)
+   {
+      if (delta)
+      {
+         pw_varint(t, pw_zz(a->v[i] - p));
+         p = a->v[i];
+      }
+      else
+         pw_varint(t, a->v[i]);
+   }
+   pw_msg(b, fn, t);
+}
+
+
+static uint32_t pw_hash(const char *s, long len)
+{
+   uint32_t h = 2166136261u;
+
+   for (; len; len--, s++)
+      h = (h ^ (uint8_t) *s) * 16777619u;
+   return h;
+}
+
+
+/*! Resize hash table of string table.
+ *  @return 0 on success, -1 on error.
+ */
+static int pw_rehash(struct pbf_wctrl *w, int size)
+{
+   int32_t *h;
+   size_t i;
+   uint32_t j;
+
+   if ((h = calloc(size, sizeof(*h))) == NULL)
+      return -1;
+
+   // index 0 is the empty string which is never hashed
+   for (i = 1; i < w->sidx.n / 2; i++)
+   {
+      j = pw_hash((char*) w->st.buf + w->sidx.v[i * 2], w->sidx.v[i * 2 + 1]) & (size - 1);
+      while (h[j])
+         j = (j + 1) & (size - 1);
+      h[j] = i;
+   }
+
+   free(w->hash);
+   w->hash = h;
+   w->hsize = size;
+   return 0;
+}
+
+
+/*! Get index of a string in the string table. New strings are added.
+ *  @param s String which is XML-escaped if esc is set.
+ *  @return Index or -1 on error.
+ */
+static int64_t pw_str(struct pbf_wctrl *w, const char *s, long len, int esc)
+{
+   uint32_t j;
+   int32_t i;
+   char *u;
+
+   if (esc && memchr(s, '&', len) != NULL)
+   {
+      if (len > w->ulen)
+      {
+         if ((u = realloc(w->ubuf, len)) == NULL)
+            return -1;
+         w->ubuf = u;
+         w->ulen = len;
+      }
+      len = ev_unescape(w->ubuf, s, len);
+      s = w->ubuf;
+   }
+
+   if (!len)
+      return 0;
+
+   if (w->sidx.n >= (size_t) w->hsize && pw_rehash(w, w->hsize ? w->hsize << 1 : 4096) == -1)
+      return -1;
+
+   for (j = pw_hash(s, len) & (w->hsize - 1); (i = w->hash[j]); j = (j + 1) & (w->hsize - 1))
+      if (w->sidx.v[i * 2 + 1] == len && !memcmp(w->st.buf + w->sidx.v[i * 2], s, len))
+         return i;
+
+   i = w->sidx.n / 2;
+   w->hash[j] = i;
+   i64_add(&w->sidx, w->st.len);
+   i64_add(&w->sidx, len);
+   pw_reserve(&w->st, len);
+   if (w->st.err || w->sidx.err)
+      return -1;
+   memcpy(w->st.buf + w->st.len, s, len);
+   w->st.len += len;
+
+   return i;
+}
+
+
+/*! Reset string table of a new block.
+ */
+static void pw_st_reset(struct pbf_wctrl *w)
+{
+   w->st.len = 0;
+   w->sidx.n = 0;
+   // index 0 must be the empty string
+   i64_add(&w->sidx, 0);
+   i64_add(&w->sidx, 0);
+   if (w->hash != NULL)
+      memset(w->hash, 0, w->hsize * sizeof(*w->hash));
+}
+
+
+/*! Finish current group and append it to the groups of the block.
+ */
+static void pw_group_end(struct pbf_wctrl *w)
+{
+   struct pbuf *t = &w->t1;
+
+   switch (w->gtype)
+   {
+      case PW_DENSE:
+         t->len = 0;
+         pw_packed(t, &w->t0, 1, &w->d_id, 1);
+         pw_packed(&w->g, &w->t0, 1, &w->d_ver, 0);
+         pw_packed(&w->g, &w->t0, 2, &w->d_ts, 1);
+         pw_packed(&w->g, &w->t0, 3, &w->d_cs, 1);
+         pw_packed(&w->g, &w->t0, 4, &w->d_uid, 1);
+         pw_packed(&w->g, &w->t0, 5, &w->d_usr, 1);
+         pw_msg(t, 5, &w->g);
+         pw_packed(t, &w->t0, 8, &w->d_lat, 1);
+         pw_packed(t, &w->t0, 9, &w->d_lon, 1);
+         pw_packed(t, &w->t0, 10, &w->d_kv, 0);
+         pw_msg(&w->g, 2, t);
+         w->d_id.n = w->d_lat.n = w->d_lon.n = w->d_ver.n = w->d_ts.n = 0;
+         w->d_cs.n = w->d_uid.n = w->d_usr.n = w->d_kv.n = 0;
+         // fall through
+      case PW_WAY:
+      case PW_REL:
+         pw_msg(&w->grp, 2, &w->g);
+         break;
+   }
+   w->gtype = PW_NONE;
+}
+
+
+/*! Frame a block as blob and compress it. This function is called by the
+ *  threads of the job queue.
+ */
+static void pw_encode(void *p)
+{
+   struct pw_blk *blk = p;
+   struct pbuf h = {NULL, 0, 0, 0};
+   uLongf zlen;
+   size_t n;
+
+   blk->err = 0;
+
+   // reserve space for BlobHeader and Blob fields
+   zlen = compressBound(blk->pb.len);
+   pw_reserve(&blk->out, zlen + 128);
+   if (blk->out.err || blk->pb.err)
+   {
+      blk->err = ENOMEM;
+      return;
+   }
+
+   // the compressed data is written at offset 64, the headers are put in
+   // front of it afterwards
+   if (compress2(blk->out.buf + 64, &zlen, blk->pb.buf, blk->pb.len, Z_DEFAULT_COMPRESSION) != Z_OK)
+   {
+      blk->err = ENOMEM;
+      return;
+   }
+
+   // Blob: raw_size, zlib_data (without data bytes)
+   pw_uint(&h, 2, blk->pb.len);
+   pw_varint(&h, 3 << 3 | 2);
+   pw_varint(&h, zlen);
+   n = h.len;
+   // BlobHeader
+   pw_bytes(&h, 1, blk->type, strlen(blk->type));
+   pw_uint(&h, 3, n + zlen);
+   if (h.err)
+   {
+      free(h.buf);
+      blk->err = ENOMEM;
+      return;
+   }
+
+   // 4 bytes length + BlobHeader + Blob header
+   blk->off = 64 - (4 + h.len);
+   blk->size = 4 + h.len + zlen;
+   memcpy(blk->out.buf + blk->off + 4, h.buf + n, h.len - n);
+   memcpy(blk->out.buf + blk->off + 4 + h.len - n, h.buf, n);
+   blk->out.buf[blk->off] = (h.len - n) >> 24;
+   blk->out.buf[blk->off + 1] = (h.len - n) >> 16;
+   blk->out.buf[blk->off + 2] = (h.len - n) >> 8;
+   blk->out.buf[blk->off + 3] = h.len - n;
+   free(h.buf);
+}
+
+
+/*! Write finished blobs until at most n blocks are in flight.
+ *  @return 0 on success, -1 on error.
+ */
+static int pw_drain(struct pbf_wctrl *w, int n)
+{
+   struct pw_blk *blk;
+   int e = 0;
+
+   while (jq_pending(w->jq) > n)
+   {
+      blk = jq_next(w->jq);
+      if (!e && blk->err)
+      {
+         errno = blk->err;
+         e = -1;
+      }
+      if (!e && fwrite(blk->out.buf + blk->off, blk->size, 1, w->f) != 1)
+         e = -1;
+      blk->next = w->pool;
+      w->pool = blk;
+   }
+   return e;
+}
+
+
+/*! Submit serialized block to the job queue.
+ */
+static int pw_submit(struct pbf_wctrl *w, struct pbuf *pb, const char *type)
+{
+   struct pw_blk *blk;
+   struct pbuf t;
+
+   if (pb->err)
+   {
+      errno = ENOMEM;
+      return -1;
+   }
+
+   if ((blk = w->pool) != NULL)
+      w->pool = blk->next;
+   else if ((blk = calloc(1, sizeof(*blk))) == NULL)
+      return -1;
+
+   // swap buffers to avoid copying
+   t = blk->pb;
+   blk->pb = *pb;
+   *pb = t;
+   pb->len = 0;
+   pb->err = 0;
+   blk->type = type;
+
+   if (jq_submit(w->jq, blk) == -1)
+      return -1;
+
+   return pw_drain(w, w->maxflight);
+}
+
+
+/*! Write HeaderBlock.
+ */
+static int pw_header(struct pbf_wctrl *w)
+{
+   struct pbuf *b = &w->t1;
+   int i;
+
+   w->hdr = 1;
+   b->len = 0;
+   if (w->has_bbox)
+   {
+      for (i = 0; i < 4; i++)
+         pw_sint(&w->t0, i + 1, w->bbox[i]);
+      pw_msg(b, 1, &w->t0);
+   }
+   pw_bytes(b, 4, "OsmSchema-V0.6", 14);
+   pw_bytes(b, 4, "DenseNodes", 10);
+   pw_bytes(b, 16, "smfilter", 8);
+
+   return pw_submit(w, b, "OSMHeader");
+}
+
+
+/*! Serialize current block and submit it.
+ */
+static int pw_flush(struct pbf_wctrl *w)
+{
+   struct pbuf *b = &w->t1;
+   size_t i;
+
+   if (!w->hdr && pw_header(w) == -1)
+      return -1;
+
+   if (!w->cnt)
+      return 0;
+
+   pw_group_end(w);
+
+   // StringTable
+   w->t0.len = 0;
+   for (i = 0; i < w->sidx.n / 2; i++)
+      pw_bytes(&w->t0, 1, w->st.buf + w->sidx.v[i * 2], w->sidx.v[i * 2 + 1]);
+   if (w->sidx.err || w->st.err)
+      w->t0.err = 1;
+
+   b->len = 0;
+   pw_msg(b, 1, &w->t0);
+   if (w->grp.err)
+      b->err = 1;
+   pw_reserve(b, w->grp.len);
+   if (!b->err)
+   {
+      memcpy(b->buf + b->len, w->grp.buf, w->grp.len);
+      b->len += w->grp.len;
+   }
+   w->grp.len = 0;
+   w->cnt = 0;
+   pw_st_reset(w);
+
+   return pw_submit(w, b, "OSMData");
+}
+
+
+/*! Add Info message of current object to b.
+ */
+static void pw_info(struct pbf_wctrl *w, struct pbuf *b)
+{
+   struct pw_obj *o = &w->obj;
+
+   w->t0.len = 0;
+   pw_uint(&w->t0, 1, o->ver);
+   pw_uint(&w->t0, 2, o->ts);
+   pw_uint(&w->t0, 3, o->cs);
+   pw_uint(&w->t0, 4, o->uid);
+   pw_uint(&w->t0, 5, o->usr);
+   pw_msg(b, 4, &w->t0);
+}
+
+
+/*! Add keys and values of current object to b.
+ */
+static void pw_kv(struct pbf_wctrl *w, struct pbuf *b)
+{
+   struct pw_obj *o = &w->obj;
+   size_t i;
+
+   if (!o->kv.n)
+      return;
+
+   w->t0.len = 0;
+   for (i = 0; i < o->kv.n; i += 2)
+      pw_varint(&w->t0, o->kv.v[i]);
+   pw_msg(b, 2, &w->t0);
+   for (i = 1; i < o->kv.n; i += 2)
+      pw_varint(&w->t0, o->kv.v[i]);
+   pw_msg(b, 3, &w->t0);
+}
+
+
+/*! Add current object to block.
+ *  @return 0 on success, -1 on error.
+ */
+static int pw_obj_end(struct pbf_wctrl *w)
+{
+   struct pw_obj *o = &w->obj;
+   struct pbuf *t = &w->t1;
+   int type;
+   size_t i;
+
+   type = o->type == EV_NODE ? PW_DENSE : o->type == EV_WAY ? PW_WAY : PW_REL;
+   o->type = -1;
+
+   if (!w->hdr && pw_header(w) == -1)
+      return -1;
+
+   if (w->gtype != type)
+   {
+      pw_group_end(w);
+      w->gtype = type;
+   }
+
+   switch (type)
+   {
+      case PW_DENSE:
+         i64_add(&w->d_id, o->id);
+         i64_add(&w->d_lat, o->lat);
+         i64_add(&w->d_lon, o->lon);
+         i64_add(&w->d_ver, o->ver);
+         i64_add(&w->d_ts, o->ts);
+         i64_add(&w->d_cs, o->cs);
+         i64_add(&w->d_uid, o->uid);
+         i64_add(&w->d_usr, o->usr);
+         for (i = 0; i < o->kv.n; i++)
+            i64_add(&w->d_kv, o->kv.v[i]);
+         i64_add(&w->d_kv, 0);
+         break;
+
+      case PW_WAY:
+         t->len = 0;
+         pw_uint(t, 1, o->id);
+         pw_kv(w, t);
+         pw_info(w, t);
+         pw_packed(t, &w->t0, 8, &o->ref, 1);
+         pw_msg(&w->g, 3, t);
+         break;
+
+      case PW_REL:
+         t->len = 0;
+         pw_uint(t, 1, o->id);
+         pw_kv(w, t);
+         pw_info(w, t);
+         if (o->mem.n)
+         {
+            w->t0.len = 0;
+            for (i = 1; i < o->mem.n; i += 2)
+               pw_varint(&w->t0, o->mem.v[i]);
+            pw_msg(t, 8, &w->t0);
+            pw_packed(t, &w->t0, 9, &o->ref, 1);
+            for (i = 0; i < o->mem.n; i += 2)
+               pw_varint(&w->t0, o->mem.v[i]);
+            pw_msg(t, 10, &w->t0);
+         }
+         pw_msg(&w->g, 4, t);
+         break;
+   }
+
+   if (o->kv.err || o->ref.err || o->mem.err)
+   {
+      errno = ENOMEM;
+      return -1;
+   }
+
+   if (++w->cnt >= PBF_BLK_ENTITIES)
+      return pw_flush(w);
+
+   return 0;
+}
+
+
+/*! Start new object from the attributes of an XML element.
+ */
+static int pw_obj_start(struct pbf_wctrl *w, const hpx_tag_t *t, int type)
+{
+   struct pw_obj *o = &w->obj;
+   const hpx_attr_t *a;
+   int i;
+
+   o->type = type;
+   o->id = o->ver = o->cs = o->uid = o->usr = o->lat = o->lon = o->ts = 0;
+   o->kv.n = o->ref.n = o->mem.n = 0;
+
+   for (i = 0, a = t->attr; i < t->nattr; i++, a++)
+   {
+      if (!bs_cmp(a->name, "id"))
+         o->id = bs_tol(a->value);
+      else if (!bs_cmp(a->name, "lat"))
+         o->lat = ev_parse_coord(a->value);
+      else if (!bs_cmp(a->name, "lon"))
+         o->lon = ev_parse_coord(a->value);
+      else if (!bs_cmp(a->name, "version"))
+         o->ver = bs_tol(a->value);
+      else if (!bs_cmp(a->name, "timestamp"))
+      {
+         if ((o->ts = ev_parse_time(a->value)) == -1)
+            o->ts = 0;
+      }
+      else if (!bs_cmp(a->name, "changeset"))
+         o->cs = bs_tol(a->value);
+      else if (!bs_cmp(a->name, "uid"))
+         o->uid = bs_tol(a->value);
+      else if (!bs_cmp(a->name, "user"))
+      {
+         if ((o->usr = pw_str(w, a->value.buf, a->value.len, 1)) == -1)
+            return -1;
+      }
+   }
+
+   return 0;
+}
+
+
+/*! Add tag, node reference, or member to the current object.
+ */
+static int pw_obj_sub(struct pbf_wctrl *w, const hpx_tag_t *t)
+{
+   struct pw_obj *o = &w->obj;
+   int64_t k = 0, v = 0, role = 0, type = -1, ref = 0;
+   int i;
+
+   if (!bs_cmp(t->tag, "tag"))
+   {
+      for (i = 0; i < t->nattr; i++)
+      {
+         if (!bs_cmp(t->attr[i].name, "k"))
+            k = pw_str(w, t->attr[i].value.buf, t->attr[i].value.len, 1);
+         else if (!bs_cmp(t->attr[i].name, "v"))
+            v = pw_str(w, t->attr[i].value.buf, t->attr[i].value.len, 1);
+         if (k == -1 || v == -1)
+            return -1;
+      }
+      i64_add(&o->kv, k);
+      i64_add(&o->kv, v);
+   }
+   else if (!bs_cmp(t->tag, "nd") && o->type == EV_WAY)
+   {
+      for (i = 0; i < t->nattr; i++)
+         if (!bs_cmp(t->attr[i].name, "ref"))
+            i64_add(&o->ref, bs_tol(t->attr[i].value));
+   }
+   else if (!bs_cmp(t->tag, "member") && o->type == EV_RELATION)
+   {
+      for (i = 0; i < t->nattr; i++)
+      {
+         if (!bs_cmp(t->attr[i].name, "ref"))
+            ref = bs_tol(t->attr[i].value);
+         else if (!bs_cmp(t->attr[i].name, "type"))
+            type = !bs_cmp(t->attr[i].value, "node") ? 0 : !bs_cmp(t->attr[i].value, "way") ? 1 : 2;
+         else if (!bs_cmp(t->attr[i].name, "role"))
+         {
+            if ((role = pw_str(w, t->attr[i].value.buf, t->attr[i].value.len, 1)) == -1)
+               return -1;
+         }
+      }
+      if (type == -1)
+         return 0;
+      i64_add(&o->ref, ref);
+      i64_add(&o->mem, type);
+      i64_add(&o->mem, role);
+   }
+
+   return 0;
+}
+
+
+/*! Process XML element.
+ *  @param w Pointer to PBF writer.
+ *  @param t Element. Attribute values are expected to be XML-escaped.
+ *  @return 0 on success, -1 on error.
+ */
+int pbf_put_tag(pbf_wctrl_t *w, const hpx_tag_t *t)
+{
+   int type = -1;
+
+   if (w->err)
+      return -1;
+
+   if (!bs_cmp(t->tag, "node"))
+      type = EV_NODE;
+   else if (!bs_cmp(t->tag, "way"))
+      type = EV_WAY;
+   else if (!bs_cmp(t->tag, "relation"))
+      type = EV_RELATION;
+
+   switch (t->type)
+   {
+      case HPX_OPEN:
+      case HPX_SINGLE:
+         if (type != -1)
+         {
+            if (w->obj.type != -1)
+               break;
+            if (pw_obj_start(w, t, type) == -1)
+               goto pw_err;
+            if (t->type == HPX_SINGLE && pw_obj_end(w) == -1)
+               goto pw_err;
+            break;
+         }
+
+         if (w->obj.type != -1)
+         {
+            if (pw_obj_sub(w, t) == -1)
+               goto pw_err;
+            break;
+         }
+
+         if (!bs_cmp(t->tag, "bounds") && !w->hdr)
+         {
+            int i;
+            for (i = 0; i < t->nattr; i++)
+            {
+               if (!bs_cmp(t->attr[i].name, "minlon"))
+                  w->bbox[0] = ev_parse_coord(t->attr[i].value) * 100;
+               else if (!bs_cmp(t->attr[i].name, "maxlon"))
+                  w->bbox[1] = ev_parse_coord(t->attr[i].value) * 100;
+               else if (!bs_cmp(t->attr[i].name, "maxlat"))
+                  w->bbox[2] = ev_parse_coord(t->attr[i].value) * 100;
+               else if (!bs_cmp(t->attr[i].name, "minlat"))
+                  w->bbox[3] = ev_parse_coord(t->attr[i].value) * 100;
+            }
+            w->has_bbox = 1;
+         }
+         break;
+
+      case HPX_CLOSE:
+         if (type != -1 && type == w->obj.type && pw_obj_end(w) == -1)
+            goto pw_err;
+         break;
+   }
+
+   return 0;
+
+pw_err:
+   w->err = errno ? errno : ENOMEM;
+   return -1;
+}
+
+
+/*! Create PBF writer.
+ *  @param f Output stream.
+ *  @param nthreads Number of compression threads, 0 means that blocks are
+ *  compressed synchronously.
+ *  @return Pointer to writer or NULL on error with errno set.
+ */
+pbf_wctrl_t *pbf_wopen(FILE *f, int nthreads)
+{
+   pbf_wctrl_t *w;
+
+   if ((w = calloc(1, sizeof(*w))) == NULL)
+      return NULL;
+
+   if ((w->jq = jq_init(nthreads, pw_encode)) == NULL)
+   {
+      free(w);
+      return NULL;
+   }
+
+   w->f = f;
+   w->maxflight = nthreads ? nthreads * 2 : 0;
+   if (w->maxflight > JQ_MAX - 1)
+      w->maxflight = JQ_MAX - 1;
+   w->obj.type = -1;
+   pw_st_reset(w);
+
+   return w;
+}
+
+
+static void pw_blk_free(struct pw_blk *blk)
+{
+   free(blk->pb.buf);
+   free(blk->out.buf);
+   free(blk);
+}
+
+
+/*! Write all remaining data and free the writer. The output stream is not
+ *  closed.
+ *  @return 0 on success, -1 if any error occured.
+ */
+int pbf_wclose(pbf_wctrl_t *w)
+{
+   struct pw_blk *blk;
+   int e = w->err ? -1 : 0;
+
+   if (!e && pw_flush(w) == -1)
+      e = -1;
+   if (pw_drain(w, 0) == -1)
+      e = -1;
+   jq_free(w->jq);
+
+   while ((blk = w->pool) != NULL)
+   {
+      w->pool = blk->next;
+      pw_blk_free(blk);
+   }
+
+   free(w->obj.kv.v);
+   free(w->obj.ref.v);
+   free(w->obj.mem.v);
+   free(w->st.buf);
+   free(w->sidx.v);
+   free(w->hash);
+   free(w->grp.buf);
+   free(w->g.buf);
+   free(w->t0.buf);
+   free(w->t1.buf);
+   free(w->ubuf);
+   free(w->d_id.v);
+   free(w->d_lat.v);
+   free(w->d_lon.v);
+   free(w->d_ver.v);
+   free(w->d_ts.v);
+   free(w->d_cs.v);
+   free(w->d_uid.v);
+   free(w->d_usr.v);
+   free(w->d_kv.v);
+   if (w->err)
+      errno = w->err;
+   free(w);
+
+   return e;
+}
+
@@ -0,0 +1,128 @@
+/* Copyright 2011 Bernhard R. Fischer, 2048R/5C5FFD47 <bf@abenteuerland.at>
+ *
+ * This file is part of smfilter.
+ *
+ * Smfilter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * Smfilter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with smfilter. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! This is an example of the reader of sector files (see smsect.h). It maps
+ *  a sector file which was written with smfilter -s and prints its records
+ *  as text, one record per line:
+ *
+ *     lights <n> sectors <n> subsectors <n>
+ *     light <id> <lat> <lon> <nsec>
+ *     sector <id> <nr> <start> <end> <dir> <r> <col> <col2> <cat> <nfrac>
+ *     frac <id> <nr> <r> <start> <end> <type> <col> <startr> <endr>
+ *
+ *  Undefined values are printed as "-". The id is that of the light the
+ *  record belongs to, e.g.
+ *
+ *     ./smfilter -s lights.sct < testlight.osm > /dev/null
+ *     ./sctdump lights.sct
+ *
+ *  @author Bernhard R. Fischer
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+#include "smsect.h"
+
+
+/*! The writer of smsect.o refers to the color names of smfilter. The
+ *  reader takes them from the header of the file instead.
+ */
+const char *color(int n)
+{
+   return NULL;
+}
+
+
+/*! Print float value or "-" if it is NaN.
+ */
+static void pval(double v)
+{
+   if (isnan(v))
+      printf(" -");
+   else
+      printf(" %.2f", v);
+}
+
+
+/*! Print name of color c or "-" if it is undefined.
+ */
+static void pcol(const sct_file_t *sf, int c)
+{
+   printf(" %s", c >= 0 && (unsigned) c < sf->hdr->ncol ? sf->hdr->col[c] : "-");
+}
+
+
+int main(int argc, char *argv[])
+{
+   const struct sct_light *l;
+   const struct sct_sector *s;
+   const struct sct_frac *f;
+   sct_file_t sf;
+   uint64_t i, j, k;
+
+   if (argc < 2)
+      fprintf(stderr, "usage: %s <sector file>\n", argv[0]), exit(EXIT_FAILURE);
+
+   if (sct_map(argv[1], &sf) == -1)
+      fprintf(stderr, "*** cannot map '%s': %s\n", argv[1], strerror(errno)), exit(EXIT_FAILURE);
+
+   printf("lights %lu sectors %lu subsectors %lu\n", (unsigned long) sf.hdr->nlight,
+         (unsigned long) sf.hdr->nsec, (unsigned long) sf.hdr->nfrac);
+
+   for (i = 0; i < sf.hdr->nlight; i++)
+   {
+      l = &sf.light[i];
+      printf("light %ld %.7f %.7f %u\n", (long) l->id, l->lat, l->lon, l->nsec);
+      if ((uint64_t) l->sec + l->nsec > sf.hdr->nsec)
+         fprintf(stderr, "*** sectors of light %ld out of range\n", (long) l->id), exit(EXIT_FAILURE);
+
+      for (j = l->sec; j < (uint64_t) l->sec + l->nsec; j++)
+      {
+         s = &sf.sec[j];
+         printf("sector %ld %d", (long) l->id, s->nr);
+         pval(s->start);
+         pval(s->end);
+         pval(s->dir);
+         pval(s->r);
+         pcol(&sf, s->col[0]);
+         pcol(&sf, s->col[1]);
+         printf(" %d %u\n", s->cat, s->nfrac);
+         if ((uint64_t) s->frac + s->nfrac > sf.hdr->nfrac)
+            fprintf(stderr, "*** subsectors of light %ld out of range\n", (long) l->id), exit(EXIT_FAILURE);
+
+         for (k = s->frac; k < (uint64_t) s->frac + s->nfrac; k++)
+         {
+            f = &sf.frac[k];
+            printf("frac %ld %d", (long) l->id, s->nr);
+            pval(f->r);
+            pval(f->start);
+            pval(f->end);
+            printf(" %d", f->type);
+            pcol(&sf, f->col);
+            printf(" %d %d\n", f->startr, f->endr);
+         }
+      }
+   }
+
+   sct_unmap(&sf);
+   return EXIT_SUCCESS;
+}
+
@@ -20,6 +20,14 @@
 
 #include "bstring.h"
 #include "libhpxml.h"
+#include "smout.h"
+
+//! number of bits of stable ids which are used for numbering
+#define GEN_ID_BITS 16
+//! offset of the stable ids of source nodes with non-positive ids
+#define GEN_ID_NEG (1L << 62)
+//! maximum absolute value of a source node id which gets stable ids
+#define GEN_ID_MAX ((GEN_ID_NEG >> GEN_ID_BITS) - 1)
 
 #define ARC_DIV 6.0
 #define ARC_MAX 0.1
@@ -93,6 +101,12 @@ const char *color_abbr(int);
 long get_id(void);
 void pchar(const struct osm_node *, const struct sector *);
 void set_id(long);
+void set_base_id(long);
+long gen_id(long, int);
+void get_gen_cnt(int *, int *);
+void reset_gen_bbox(void);
+int get_gen_bbox(double *);
+void set_output(smout_t *);
 
 #endif
 
@@ -21,6 +21,7 @@
  *  @author Bernhard R. Fischer
  */
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include <time.h>
@@ -30,6 +31,8 @@
 #include "libhpxml.h"
 #include "seamark.h"
 #include "smlog.h"
+#include "smout.h"
+#include "smstat.h"
 
 
 #define DEG2RAD(x) ((x) * M_PI / 180.0)
@@ -49,6 +52,18 @@ static const char *col_[] = {"white", "red", "green", "yellow", "orange", "blue"
 static const char *col_abbr_[] = {"W", "R", "G", "Y", "Or", "Bu", "Vi", "Am", NULL};
 static const int col_cnt_ = 8;
 static long node_id_ = -1;
+//! flag set if stable ids are used and id of their source node
+static int stable_ = 0;
+static long base_id_ = 0;
+//! number of nodes and ways generated since set_base_id()
+static int gen_nodes_ = 0, gen_ways_ = 0;
+//! bounding box of nodes generated since reset_gen_bbox() (min lat, min lon, max lat, max lon)
+static double gen_bb_[4];
+static int gen_bb_cnt_ = 0;
+//! vertex buffer of arc nodes
+static double *vlat_ = NULL, *vlon_ = NULL;
+static int vmax_ = 0;
+static smout_t *out_ = NULL;
 static const char *atype_[] = {"undef", "solid", "suppress", "dashed", 
 #ifdef RENDER_TAPERING
    "taper_up", "taper_down", "taper_1", "taper_2", "taper_3", "taper_4", "taper_5", "taper_6", "taper_7",
@@ -56,14 +71,134 @@ static const char *atype_[] = {"undef", "solid", "suppress", "dashed",
    NULL};
 
 
+/*! Set output stream for generated nodes and ways.
+ */
+void set_output(smout_t *o)
+{
+   out_ = o;
+}
+
+
 void set_id(long id)
 {
    node_id_ = id;
 }
 
 
+/*! Return the stable id of the n-th generated node or way of the source
+ *  node src. It is -(src * 2^GEN_ID_BITS + n). Source nodes with
+ *  non-positive ids (e.g. new objects of an editor) are mapped to the
+ *  separate range -(GEN_ID_NEG + -src * 2^GEN_ID_BITS + n), thus they
+ *  never collide with those of positive ids.
+ */
+long gen_id(long src, int n)
+{
+   if (src > 0)
+      return -((src << GEN_ID_BITS) + n);
+   return -(GEN_ID_NEG + (-src << GEN_ID_BITS) + n);
+}
+
+
+/*! Use stable ids which are derived from the id of the source node instead
+ *  of sequential ids (see gen_id()). Nodes and ways are numbered
+ *  separately. The program is terminated if the id is out of range.
+ *  @param src Id of source node.
+ */
+void set_base_id(long src)
+{
+   if (src > GEN_ID_MAX || src < -GEN_ID_MAX)
+   {
+      log_err(LOG_ID_RANGE, -1, "node id %ld out of range of stable ids", src);
+      fprintf(stderr, "*** node id %ld out of range of stable ids\n", src);
+      exit(EXIT_FAILURE);
+   }
+   stable_ = 1;
+   base_id_ = src;
+   gen_nodes_ = gen_ways_ = 0;
+}
+
+
+/*! Get number of nodes and ways generated since the last call to
+ *  set_base_id().
+ */
+void get_gen_cnt(int *nodes, int *ways)
+{
+   *nodes = gen_nodes_;
+   *ways = gen_ways_;
+}
+
+
+void reset_gen_bbox(void)
+{
+   gen_bb_cnt_ = 0;
+}
+
+
+/*! Get bounding box of all nodes generated since the last call to
+ *  reset_gen_bbox().
+ *  @param bb Array which receives min lat, min lon, max lat, max lon.
+ *  @return 0 on success, -1 if no nodes were generated.
+ */
+int get_gen_bbox(double *bb)
+{
+   if (!gen_bb_cnt_)
+      return -1;
+   memcpy(bb, gen_bb_, sizeof(gen_bb_));
+   return 0;
+}
+
+
+static void gen_bbox_add(double lat, double lon)
+{
+   if (!gen_bb_cnt_++)
+   {
+      gen_bb_[0] = gen_bb_[2] = lat;
+      gen_bb_[1] = gen_bb_[3] = lon;
+      return;
+   }
+   gen_bb_[0] = fmin(gen_bb_[0], lat);
+   gen_bb_[1] = fmin(gen_bb_[1], lon);
+   gen_bb_[2] = fmax(gen_bb_[2], lat);
+   gen_bb_[3] = fmax(gen_bb_[3], lon);
+}
+
+
+/*! Return next stable id. If all 2^GEN_ID_BITS numbers of the source
+ *  node are used up, the ids would overlap with those of the next source
+ *  node, thus the program is terminated.
+ *  @param cnt Pointer to counter of generated nodes or ways.
+ *  @param type Name of object type for the error message.
+ */
+static long next_stable_id(int *cnt, const char *type)
+{
+   if (*cnt >= 1 << GEN_ID_BITS)
+   {
+      log_err(LOG_ID_RANGE, -1, "more than %d %s generated for node %ld, stable ids exhausted",
+            1 << GEN_ID_BITS, type, base_id_);
+      fprintf(stderr, "*** more than %d %s generated for node %ld, stable ids exhausted\n",
+            1 << GEN_ID_BITS, type, base_id_);
+      exit(EXIT_FAILURE);
+   }
+   return gen_id(base_id_, (*cnt)++);
+}
+
+
+/*! Return id for next generated node.
+ */
 long get_id(void)
 {
+   if (stable_)
+      return next_stable_id(&gen_nodes_, "nodes");
+   return node_id_--;
+}
+
+
+/*! Return id for next generated way.
+ */
+static long get_way_id(void)
+{
+   if (stable_)
+      return next_stable_id(&gen_ways_, "ways");
    return node_id_--;
 }
 
@@ -225,7 +360,7 @@ int get_sectors(const hpx_tree_t *t, struct sector *sec, int nmax)
                   // continue if color was not found
                   if (col_[l] == NULL)
                   {
-                     log_msg("unknown color: %.*s", c.len, c.buf);
+                     log_err(LOG_COLOR, k, "unknown color: %.*s", (int) c.len, c.buf);
                      continue;
                   }
                }
@@ -274,7 +409,7 @@ int get_sectors(const hpx_tree_t *t, struct sector *sec, int nmax)
                // check if it is in range
                if ((k <= 0) || (k >= nmax))
                {
-                  log_msg("sector number out of range: %d", k);
+                  log_err(LOG_SECNR, k, "sector number out of range: %d", k);
                   continue;
                }
 
@@ -354,7 +489,7 @@ int get_sectors(const hpx_tree_t *t, struct sector *sec, int nmax)
                   // continue if color was not found
                   if (col_[l] == NULL)
                   {
-                     log_msg("unknown color: %.*s", c.len, c.buf);
+                     log_err(LOG_COLOR, k, "unknown color: %.*s", (int) c.len, c.buf);
                      continue;
                   }
 
@@ -374,7 +509,7 @@ int get_sectors(const hpx_tree_t *t, struct sector *sec, int nmax)
                   // continue if color was not found
                   if (col_[l] == NULL)
                   {
-                     log_msg("unknown color: %.*s", c.len, c.buf);
+                     log_err(LOG_COLOR, k, "unknown color: %.*s", (int) c.len, c.buf);
                      continue;
                   }
                }
@@ -422,7 +557,7 @@ int get_sectors(const hpx_tree_t *t, struct sector *sec, int nmax)
                            (sec + k)->sf[(sec + k)->fused].type = l;
                         else
                         {
-                           log_msg("arc_type unknown: %.*s", c.len, c.buf);
+                           log_err(LOG_ARC_TYPE, k, "arc_type unknown: %.*s", (int) c.len, c.buf);
                            (sec + k)->sf[(sec + k)->fused].type = ARC_SUPPRESS;
                         }
                      }
@@ -433,7 +568,7 @@ int get_sectors(const hpx_tree_t *t, struct sector *sec, int nmax)
                            (sec + k)->sf[(sec + k)->fused].type = l;
                         else
                         {
-                           log_msg("arc_type unknown: %.*s", c.len, c.buf);
+                           log_err(LOG_ARC_TYPE, k, "arc_type unknown: %.*s", (int) c.len, c.buf);
                            (sec + k)->sf[(sec + k)->fused].type = ARC_SUPPRESS;
                         }
                          // find next colon
@@ -494,6 +629,123 @@ void node_calc(const struct osm_node *nd, double r, double a, double *lat, doubl
 }
 
 
+/*! Output generated tag.
+ */
+static void gen_tag(const char *k, const char *v)
+{
+   if (OUT_RAW(out_))
+   {
+      out_printf(out_, "<tag k=\"%s\" v=\"%s\"/>\n", k, v);
+      return;
+   }
+   out_elem(out_, HPX_SINGLE, "tag");
+   out_attr(out_, "k", "%s", k);
+   out_attr(out_, "v", "%s", v);
+   out_end(out_);
+}
+
+
+/*! Output generated tag with a bstring value.
+ */
+static void gen_btag(const char *k, bstring_t v)
+{
+   if (OUT_RAW(out_))
+   {
+      out_printf(out_, "<tag k=\"%s\" v=\"", k);
+      out_write(out_, v.buf, v.len);
+      out_printf(out_, "\"/>\n");
+      return;
+   }
+   out_elem(out_, HPX_SINGLE, "tag");
+   out_attr(out_, "k", "%s", k);
+   out_battr(out_, "v", v);
+   out_end(out_);
+}
+
+
+/*! Output node reference of generated way.
+ */
+static void gen_nd(long ref)
+{
+   if (OUT_RAW(out_))
+   {
+      out_printf(out_, "<nd ref=\"%ld\"/>\n", ref);
+      return;
+   }
+   out_elem(out_, HPX_SINGLE, "nd");
+   out_attr(out_, "ref", "%ld", ref);
+   out_end(out_);
+}
+
+
+/*! Output generated node.
+ */
+static void gen_node(long id, const char *ts, double lat, double lon)
+{
+   gen_bbox_add(lat, lon);
+   if (OUT_RAW(out_))
+   {
+      ST_COUNT(SC_GNODE);
+      out_printf(out_, "<node id=\"%ld\" version=\"1\" timestamp=\"%s\" lat=\"%f\" lon=\"%f\"/>\n",
+            id, ts, lat, lon);
+      return;
+   }
+   out_elem(out_, HPX_SINGLE, "node");
+   out_attr(out_, "id", "%ld", id);
+   out_attr(out_, "version", "1");
+   out_attr(out_, "timestamp", "%s", ts);
+   out_attr(out_, "lat", "%f", lat);
+   out_attr(out_, "lon", "%f", lon);
+   out_end(out_);
+}
+
+
+/*! Open generated way.
+ */
+static void gen_way(long id, const char *ts)
+{
+   if (OUT_RAW(out_))
+   {
+      ST_COUNT(SC_GWAY);
+      out_printf(out_, "<way id=\"%ld\" version=\"1\" timestamp=\"%s\">\n", id, ts);
+      return;
+   }
+   out_elem(out_, HPX_OPEN, "way");
+   out_attr(out_, "id", "%ld", id);
+   out_attr(out_, "version", "1");
+   out_attr(out_, "timestamp", "%s", ts);
+   out_end(out_);
+}
+
+
+static void gen_way_end(void)
+{
+   if (OUT_RAW(out_))
+   {
+      out_printf(out_, "</way>\n");
+      return;
+   }
+   out_elem(out_, HPX_CLOSE, "way");
+   out_end(out_);
+}
+
+
+/*! Output radial way between the nodes n0 and n1.
+ */
+static void gen_radial(long id, const char *ts, long n0, long n1, int nr, bstring_t st)
+{
+   char buf[16];
+
+   gen_way(id, ts);
+   gen_nd(n0);
+   gen_nd(n1);
+   snprintf(buf, sizeof(buf), "%d", nr);
+   gen_tag("seamark:light_radial", buf);
+   gen_btag("seamark:light:object", st);
+   gen_way_end();
+}
+
+
 /*! This function creates the combined light character tag
  * 'seamark:light_character'.
  */
@@ -516,19 +768,173 @@ void pchar(const struct osm_node *nd, const struct sector *sec)
       snprintf(col, sizeof(col), "%s%s.", sec->lc.group ? "" : " ", color_abbr(sec->col[0]));
 
    if (snprintf(buf, sizeof(buf), "%.*s%s%s%s%s",
-         sec->lc.lc.len, sec->lc.lc.buf, group, col, period, range))
-      printf("<node id=\"%ld\" lat=\"%f\" lon=\"%f\" ver=\"1\" timestamp=\"%s\">\n<tag k=\"seamark:type\" v=\"virtual\"/>\n<tag k=\"seamark:light_character\" v=\"%s\"/>\n</node>\n",
-            get_id(), nd->lat, nd->lon, ts, buf);
+         (int) sec->lc.lc.len, sec->lc.lc.buf, group, col, period, range))
+   {
+      if (OUT_FEATURES(out_))
+      {
+         out_elem(out_, HPX_SINGLE, "light");
+         out_attr(out_, "seamark:type", "virtual");
+         out_attr(out_, "seamark:light_character", "%s", buf);
+         out_vertex(out_, nd->lat, nd->lon);
+         out_feature(out_);
+         return;
+      }
+
+      gen_bbox_add(nd->lat, nd->lon);
+      if (OUT_RAW(out_))
+      {
+         ST_COUNT(SC_GNODE);
+         out_printf(out_, "<node id=\"%ld\" lat=\"%f\" lon=\"%f\" ver=\"1\" timestamp=\"%s\">\n"
+               "<tag k=\"seamark:type\" v=\"virtual\"/>\n<tag k=\"seamark:light_character\" v=\"%s\"/>\n</node>\n",
+               get_id(), nd->lat, nd->lon, ts, buf);
+         return;
+      }
+      out_elem(out_, HPX_OPEN, "node");
+      out_attr(out_, "id", "%ld", get_id());
+      out_attr(out_, "lat", "%f", nd->lat);
+      out_attr(out_, "lon", "%f", nd->lon);
+      out_attr(out_, "ver", "1");
+      out_attr(out_, "timestamp", "%s", ts);
+      out_end(out_);
+      gen_tag("seamark:type", "virtual");
+      gen_tag("seamark:light_character", buf);
+      out_elem(out_, HPX_CLOSE, "node");
+      out_end(out_);
+   }
+}
+
+
+/*! Calculate the nodes of the arc of sector fraction f from angle s to e.
+ *  The absolute coordinates are stored in the vertex buffer vlat_/vlon_.
+ *  @return Number of nodes.
+ */
+static int arc_calc(const struct osm_node *nd, const struct sector_frac *f, double s, double e)
+{
+   double d, w, *p;
+   int n;
+
+   // calculate distance of nodes on arc
+   if ((arc_max_ > 0.0) && ((f->r / arc_div_) > arc_max_))
+      d = arc_max_;
+   else
+      d = f->r / arc_div_;
+   d = 2.0 * asin((d / 60.0) / (2.0 * (f->r / 60.0)));
+
+   // if end angle is greater than start, wrap around 360 degrees
+   if (e > s)
+      e -= 2.0 * M_PI;
+
+   //printf("<!-- s = %f, e = %f, d = %f -->\n", s, e, d);
+
+   for (w = s - d, n = 0; w > e; w -= d, n++)
+   {
+      if (n >= vmax_)
+      {
+         if ((p = realloc(vlat_, sizeof(*p) * (vmax_ ? vmax_ * 2 : 256))) == NULL)
+            break;
+         vlat_ = p;
+         if ((p = realloc(vlon_, sizeof(*p) * (vmax_ ? vmax_ * 2 : 256))) == NULL)
+            break;
+         vlon_ = p;
+         vmax_ = vmax_ ? vmax_ * 2 : 256;
+      }
+      node_calc(nd, f->r / 60.0, w, &vlat_[n], &vlon_[n]);
+      vlat_[n] += nd->lat;
+      vlon_[n] += nd->lon;
+   }
+
+   if (w > e)
+      log_err(LOG_NOMEM, -1, "cannot allocate memory for arc, arc truncated");
+
+   return n;
+}
+
+
+/*! Write radial line as GeoJSON feature.
+ */
+static void geo_radial(double lat0, double lon0, double lat1, double lon1, int nr, bstring_t st)
+{
+   out_elem(out_, HPX_SINGLE, "radial");
+   out_attr(out_, "seamark:light_radial", "%d", nr);
+   out_battr(out_, "seamark:light:object", st);
+   out_vertex(out_, lat0, lon0);
+   out_vertex(out_, lat1, lon1);
+   out_feature(out_);
+}
+
+
+/*! This is the GeoJSON counterpart of sector_calc2(). Each arc and radial
+ *  is written as a LineString feature whose coordinates are taken directly
+ *  from the vertex buffer. The properties are the tags the corresponding
+ *  OSM way would have.
+ */
+static void sector_geojson(const struct osm_node *nd, const struct sector *sec, bstring_t st)
+{
+   double lat[2], lon[2], s, e;
+   char buf[32];
+   int i, j, n;
+
+   for (i = 0; i < sec->fused; i++)
+   {
+      s = M_PI - DEG2RAD(sec->sf[i].start) + M_PI_2;
+      e = M_PI - DEG2RAD(sec->sf[i].end) + M_PI_2;
+
+      node_calc(nd, sec->sf[i].r / 60.0, s, &lat[0], &lon[0]);
+      lat[0] += nd->lat;
+      lon[0] += nd->lon;
+      if (sec->sf[i].startr && !(sec->sf[i].start == 0.0 && sec->sf[i].end == 360.0))
+         geo_radial(nd->lat, nd->lon, lat[0], lon[0], sec->nr, st);
+
+      // lat[1]/lon[1] still contains end point of previous segment
+      if (i && (sec->sf[i].r != sec->sf[i - 1].r) && (sec->sf[i].type != ARC_SUPPRESS) && (sec->sf[i - 1].type != ARC_SUPPRESS))
+         geo_radial(lat[1], lon[1], lat[0], lon[0], sec->nr, st);
+
+      node_calc(nd, sec->sf[i].r / 60.0, e, &lat[1], &lon[1]);
+      lat[1] += nd->lat;
+      lon[1] += nd->lon;
+      if (sec->sf[i].endr && !(sec->sf[i].start == 0.0 && sec->sf[i].end == 360.0))
+         geo_radial(nd->lat, nd->lon, lat[1], lon[1], sec->nr, st);
+
+      if ((sec->sf[i].type == ARC_SUPPRESS) || (sec->sf[i].r == 0.0))
+         continue;
+
+      n = arc_calc(nd, &sec->sf[i], s, e);
+
+      out_elem(out_, HPX_SINGLE, "arc");
+      out_attr(out_, "seamark:light:sector_nr", "%d", sec->nr);
+      out_battr(out_, "seamark:light:object", st);
+      out_attr(out_, "seamark:arc_style", "%s", atype_[sec->sf[i].type]);
+      if (sec->al)
+      {
+         snprintf(buf, sizeof(buf), "seamark:light_arc_al%d", sec->al);
+         out_attr(out_, buf, "%s", col_[sec->col[1]]);
+      }
+      else
+         out_attr(out_, "seamark:light_arc", "%s", col_[sec->col[0]]);
+
+      out_vertex(out_, lat[0], lon[0]);
+      for (j = 0; j < n; j++)
+         out_vertex(out_, vlat_[j], vlon_[j]);
+      out_vertex(out_, lat[1], lon[1]);
+      out_feature(out_);
+   }
 }
 
 
 void sector_calc2(const struct osm_node *nd, const struct sector *sec, bstring_t st)
 {
-   double lat[3], lon[3], d, s, e, w, la, lo;
+   double lat[3], lon[3], s, e;
    long sn, id[5];
    struct tm *tm;
    char ts[TBUFLEN] = "0000-00-00T00:00:00Z";
-   int i;
+   char buf[32];
+   int i, j, n;
+
+   if (OUT_FEATURES(out_))
+   {
+      sector_geojson(nd, sec, st);
+      return;
+   }
 
    if ((tm = gmtime(&nd->tim)) != NULL)
       strftime(ts, TBUFLEN, "%Y-%m-%dT%H:%M:%SZ", tm);
@@ -540,65 +946,61 @@ void sector_calc2(const struct osm_node *nd, const struct sector *sec, bstring_t
 
       // node and radial way of sector_start
       node_calc(nd, sec->sf[i].r / 60.0, s, &lat[0], &lon[0]);
-      id[0] = node_id_--;
-      printf("<node id=\"%ld\" version=\"1\" timestamp=\"%s\" lat=\"%f\" lon=\"%f\"/>\n", id[0], ts, lat[0] + nd->lat, lon[0] + nd->lon);
+      id[0] = get_id();
+      gen_node(id[0], ts, lat[0] + nd->lat, lon[0] + nd->lon);
 
       if (sec->sf[i].startr && !(sec->sf[i].start == 0.0 && sec->sf[i].end == 360.0))
-         printf("<way id=\"%ld\" version=\"1\" timestamp=\"%s\">\n<nd ref=\"%ld\"/>\n<nd ref=\"%ld\"/>\n<tag k=\"seamark:light_radial\" v=\"%d\"/>\n<tag k=\"seamark:light:object\" v=\"%.*s\"/>\n</way>\n", node_id_--, ts, nd->id, id[0], sec->nr, st.len, st.buf);
+         gen_radial(get_way_id(), ts, nd->id, id[0], sec->nr, st);
 
       // if radii of two segments differ and they are not suppressed then draw a radial line
       // (id[1] still contains end node of previous segment)
       if (i && (sec->sf[i].r != sec->sf[i - 1].r) && (sec->sf[i].type != ARC_SUPPRESS) && (sec->sf[i - 1].type != ARC_SUPPRESS))
-         printf("<way id=\"%ld\" version=\"1\" timestamp=\"%s\">\n<nd ref=\"%ld\"/>\n<nd ref=\"%ld\"/>\n<tag k=\"seamark:light_radial\" v=\"%d\"/>\n<tag k=\"seamark:light:object\" v=\"%.*s\"/>\n</way>\n", node_id_--, ts, id[1], id[0], sec->nr, st.len, st.buf);
+         gen_radial(get_way_id(), ts, id[1], id[0], sec->nr, st);
            
       // node and radial way of sector_end
       node_calc(nd, sec->sf[i].r / 60.0, e, &lat[1], &lon[1]);
-      id[1] = node_id_--;
-      printf("<node id=\"%ld\" version=\"1\" timestamp=\"%s\" lat=\"%f\" lon=\"%f\"/>\n", id[1], ts, lat[1] + nd->lat, lon[1] + nd->lon);
+      id[1] = get_id();
+      gen_node(id[1], ts, lat[1] + nd->lat, lon[1] + nd->lon);
       if (sec->sf[i].endr && !(sec->sf[i].start == 0.0 && sec->sf[i].end == 360.0))
-         printf("<way id=\"%ld\" version=\"1\" timestamp=\"%s\">\n<nd ref=\"%ld\"/>\n<nd ref=\"%ld\"/>\n<tag k=\"seamark:light_radial\" v=\"%d\"/>\n<tag k=\"seamark:light:object\" v=\"%.*s\"/>\n</way>\n", node_id_--, ts, nd->id, id[1], sec->nr, st.len, st.buf);
+         gen_radial(get_way_id(), ts, nd->id, id[1], sec->nr, st);
 
       // do not generate arc if radius is explicitly set to 0 or type of arc is
       // set to 'suppress'
       if ((sec->sf[i].type == ARC_SUPPRESS) || (sec->sf[i].r == 0.0))
          continue;
 
-      // calculate distance of nodes on arc
-      if ((arc_max_ > 0.0) && ((sec->sf[i].r / arc_div_) > arc_max_))
-         d = arc_max_;
-      else
-         d = sec->sf[i].r / arc_div_;
-      d = 2.0 * asin((d / 60.0) / (2.0 * (sec->sf[i].r / 60.0)));
-
-      // if end angle is greater than start, wrap around 360 degrees
-      if (e > s)
-         e -= 2.0 * M_PI;
-
-      //printf("<!-- s = %f, e = %f, d = %f -->\n", s, e, d);
-
       // make nodes of arc
-      for (w = s - d, sn = node_id_; w > e; w -= d)
+      n = arc_calc(nd, &sec->sf[i], s, e);
+      for (j = 0, sn = 0; j < n; j++)
       {
-
-         node_calc(nd, sec->sf[i].r / 60.0, w, &la, &lo);
-         printf("<node id=\"%ld\" version=\"1\" timestamp=\"%s\" lat=\"%f\" lon=\"%f\"/>\n", node_id_--, ts, la + nd->lat, lo + nd->lon);
+         id[2] = get_id();
+         if (!j)
+            sn = id[2];
+         gen_node(id[2], ts, vlat_[j], vlon_[j]);
       }
 
-      // connect nodes of arc to a way
-      id[3] = node_id_--;
-      printf("<way id=\"%ld\" version=\"1\" timestamp=\"%s\">\n<tag k=\"seamark:light:sector_nr\" v=\"%d\"/>\n<tag k=\"seamark:light:object\" v=\"%.*s\"/>\n<tag k=\"seamark:arc_style\" v=\"%s\"/>\n",
-            id[3], ts, sec->nr, st.len, st.buf, atype_[sec->sf[i].type]);
+      // connect nodes of arc to a way (the ids of the arc nodes are
+      // consecutive)
+      id[3] = get_way_id();
+      gen_way(id[3], ts);
+      snprintf(buf, sizeof(buf), "%d", sec->nr);
+      gen_tag("seamark:light:sector_nr", buf);
+      gen_btag("seamark:light:object", st);
+      gen_tag("seamark:arc_style", atype_[sec->sf[i].type]);
       if (sec->al)
-         printf("<tag k=\"seamark:light_arc_al%d\" v=\"%s\"/>\n", sec->al, col_[sec->col[1]]);
+      {
+         snprintf(buf, sizeof(buf), "seamark:light_arc_al%d", sec->al);
+         gen_tag(buf, col_[sec->col[1]]);
+      }
       else
-         printf("<tag k=\"seamark:light_arc\" v=\"%s\"/>\n", col_[sec->col[0]]);
-      printf("<nd ref=\"%ld\"/>\n", id[0]);
-      for (w = s - d; sn > id[3]; sn--, w -= d)
+         gen_tag("seamark:light_arc", col_[sec->col[0]]);
+      gen_nd(id[0]);
+      for (j = 0; j < n; j++)
       {
-         printf("<nd ref=\"%ld\"/>\n", sn);
+         gen_nd(sn - j);
       }
-      printf("<nd ref=\"%ld\"/>\n", id[1]);
-      printf("</way>\n");
+      gen_nd(id[1]);
+      gen_way_end();
    }
 }
 
@@ -0,0 +1,488 @@
+/* Copyright 2011 Bernhard R. Fischer, 2048R/5C5FFD47 <bf@abenteuerland.at>
+ *
+ * This file is part of smfilter.
+ *
+ * Smfilter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * Smfilter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with smfilter. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! This program measures the hot functions of smfilter one by one. The
+ *  input, typically generated by smgen, is read from stdin which has to be
+ *  a regular file, e.g.
+ *
+ *     ./smgen -n 100000 -s 0.01 > bench.osm && ./smbench < bench.osm
+ *
+ *  The input is split into its elements and all data a function needs is
+ *  collected beforehand, then each function is called in a tight loop on
+ *  this data. The result is printed as time per call and throughput of
+ *  the data the function processes (elements, attribute values, seamark
+ *  nodes, or for sector_calc2() the generated XML).
+ *
+ *  @author Bernhard R. Fischer
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <math.h>
+#include <sys/stat.h>
+
+#include "bstring.h"
+#include "libhpxml.h"
+#include "osm_inplace.h"
+#include "seamark.h"
+#include "smout.h"
+
+
+//! default minimum run time of each benchmark in seconds
+#define BENCH_TIME 1.0
+//! maximum number of sectors of a light (same as in smfilter)
+#define MAX_SEC 32
+//! maximum number of attributes of a parsed element
+#define BENCH_MATTR 64
+
+
+// count_tag() is internal to libhpxml
+long count_tag(bstring_t);
+
+//! options of sector_calc.c which are defined in smfilter.c (defaults)
+int parse_rhint_ = 0;
+double dir_arc_ = 2.0;
+
+
+//! seamark node prepared for get_sectors() and sector_calc2()
+struct bench_light
+{
+   hpx_tree_t *tree;
+   struct osm_node nd;
+   bstring_t type;
+   //! bytes of the elements of the node
+   long len;
+   //! sectors prepared for sector_calc2()
+   struct sector *sec;
+   int nsec;
+};
+
+//! elements of the input
+static bstring_t *elem_;
+static long nelem_, melem_;
+//! values of the lat/lon and timestamp attributes
+static bstring_t *coord_, *tstamp_;
+static long ncoord_, ntstamp_;
+//! seamark nodes
+static struct bench_light *light_;
+static long nlight_;
+//! minimum run time in ns
+static int64_t bench_ns_;
+//! result sink which prevents that calls are optimized away
+static volatile double sink_;
+//! number of bytes written to the output of sector_calc2()
+static long out_bytes_;
+
+
+static int64_t bench_now(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+/*! Print result of benchmark.
+ *  @param name Name of the function.
+ *  @param ops Number of calls.
+ *  @param bytes Number of bytes processed by the calls.
+ *  @param ns Time in ns.
+ */
+static void bench_print(const char *name, long ops, long bytes, int64_t ns)
+{
+   char buf[32];
+   int n;
+
+   n = snprintf(buf, sizeof(buf), "%s ", name);
+   for (; n < 20 && n < (int) sizeof(buf) - 1; n++)
+      buf[n] = '.';
+   buf[n] = '\0';
+
+   if (!ops || !ns)
+   {
+      printf("%s no data\n", buf);
+      return;
+   }
+   printf("%s %10.1f ns/op %10.1f MB/s (%ld calls)\n", buf, (double) ns / ops,
+         bytes / 1048576.0 / (ns / 1E9), ops);
+}
+
+
+/*! Append bstring to array.
+ */
+static void bench_add(bstring_t **a, long *n, long *m, bstring_t b)
+{
+   if (*n >= *m)
+   {
+      *m = *m ? *m * 2 : 4096;
+      if ((*a = realloc(*a, sizeof(**a) * *m)) == NULL)
+         perror("realloc"), exit(EXIT_FAILURE);
+   }
+   (*a)[(*n)++] = b;
+}
+
+
+/*! Read the input and collect the data of the benchmarks.
+ */
+static void bench_load(int fd)
+{
+   hpx_ctrl_t *ctl;
+   hpx_tag_t *tag;
+   hpx_tree_t *tree = NULL;
+   struct bench_light *l;
+   struct sector sec[MAX_SEC];
+   struct stat st;
+   bstring_t b, v;
+   long mcoord = 0, mtstamp = 0, mlight = 0, start = 0;
+   int i, j, n;
+
+   if (fstat(fd, &st) == -1)
+      perror("fstat"), exit(EXIT_FAILURE);
+   if (!S_ISREG(st.st_mode) || !st.st_size)
+      fprintf(stderr, "*** input must be a regular file\n"), exit(EXIT_FAILURE);
+   if ((ctl = hpx_init(fd, -st.st_size)) == NULL)
+      perror("hpx_init"), exit(EXIT_FAILURE);
+
+   // the input is memory mapped, thus all elements stay valid
+   while (hpx_get_elem(ctl, &b, NULL, NULL) > 0)
+      if (b.len && *b.buf == '<')
+         bench_add(&elem_, &nelem_, &melem_, b);
+
+   if ((tag = hpx_tm_create(BENCH_MATTR)) == NULL)
+      perror("hpx_tm_create"), exit(EXIT_FAILURE);
+
+   for (i = 0; i < nelem_; i++)
+   {
+      if (hpx_process_elem(elem_[i], tag) == -1)
+         continue;
+
+      for (j = 0; j < tag->nattr; j++)
+      {
+         if (!bs_cmp(tag->attr[j].name, "lat") || !bs_cmp(tag->attr[j].name, "lon"))
+            bench_add(&coord_, &ncoord_, &mcoord, tag->attr[j].value);
+         else if (!bs_cmp(tag->attr[j].name, "timestamp"))
+            bench_add(&tstamp_, &ntstamp_, &mtstamp, tag->attr[j].value);
+      }
+
+      if (bs_cmp(tag->tag, "node") && tree == NULL)
+         continue;
+
+      // collect node and its tags into a tree
+      if (tag->type == HPX_OPEN && !bs_cmp(tag->tag, "node"))
+      {
+         tree = NULL;
+         if (hpx_tree_resize(&tree, 1) == -1 || (tree->tag = hpx_tm_create(BENCH_MATTR)) == NULL)
+            perror("hpx_tree_resize"), exit(EXIT_FAILURE);
+         tree->nsub = 0;
+         memcpy(tree->tag, tag, sizeof(*tag) + sizeof(*tag->attr) * tag->nattr);
+         start = i;
+         continue;
+      }
+      if (tree == NULL)
+         continue;
+      if (tag->type == HPX_SINGLE && !bs_cmp(tag->tag, "tag"))
+      {
+         if (tree->nsub >= tree->msub && hpx_tree_resize(&tree, tree->msub) == -1)
+            perror("hpx_tree_resize"), exit(EXIT_FAILURE);
+         if ((tree->subtag[tree->nsub] = malloc(sizeof(hpx_tree_t))) == NULL
+               || (tree->subtag[tree->nsub]->tag = hpx_tm_create(BENCH_MATTR)) == NULL)
+            perror("malloc"), exit(EXIT_FAILURE);
+         memcpy(tree->subtag[tree->nsub]->tag, tag, sizeof(*tag) + sizeof(*tag->attr) * tag->nattr);
+         tree->subtag[tree->nsub]->nsub = 0;
+         tree->nsub++;
+         continue;
+      }
+      if (tag->type != HPX_CLOSE || bs_cmp(tag->tag, "node"))
+         continue;
+
+      // keep node if it is a seamark
+      for (j = 0; j < tree->nsub; j++)
+         if (get_value("k", tree->subtag[j]->tag, &v) != -1 && !bs_cmp(v, "seamark:type")
+               && get_v(tree->subtag[j]->tag, &v) != -1)
+            break;
+      if (j >= tree->nsub)
+      {
+         for (j = 0; j < tree->nsub; j++)
+         {
+            free(tree->subtag[j]->tag);
+            free(tree->subtag[j]);
+         }
+         free(tree->tag);
+         free(tree);
+         tree = NULL;
+         continue;
+      }
+
+      if (nlight_ >= mlight)
+      {
+         mlight = mlight ? mlight * 2 : 256;
+         if ((light_ = realloc(light_, sizeof(*light_) * mlight)) == NULL)
+            perror("realloc"), exit(EXIT_FAILURE);
+      }
+      l = &light_[nlight_++];
+      memset(l, 0, sizeof(*l));
+      l->tree = tree;
+      l->type = v;
+      l->len = elem_[i].buf + elem_[i].len - elem_[start].buf;
+      proc_osm_node(tree->tag, &l->nd);
+      tree = NULL;
+
+      // prepare the valid sectors for sector_calc2() like gen_seamark()
+      for (j = 0; j < MAX_SEC; j++)
+         init_sector(&sec[j]);
+      if (!get_sectors(l->tree, sec, MAX_SEC))
+         continue;
+      for (j = 0, n = 0; j < MAX_SEC; j++)
+      {
+         if (!sec[j].used || isnan(sec[j].start) || isnan(sec[j].end) || !isnan(sec[j].dir))
+            continue;
+         if (sec[j].start > sec[j].end)
+            sec[j].end += 360;
+         if (proc_sfrac(&sec[j]) == -1)
+            continue;
+         sec[n++] = sec[j];
+      }
+      if (n && (l->sec = malloc(sizeof(*l->sec) * n)) == NULL)
+         perror("malloc"), exit(EXIT_FAILURE);
+      memcpy(l->sec, sec, sizeof(*l->sec) * n);
+      l->nsec = n;
+   }
+
+   free(tag);
+}
+
+
+static void bench_count_tag(void)
+{
+   int64_t t, ns;
+   long i, ops = 0, bytes = 0, s = 0;
+
+   t = bench_now();
+   do
+   {
+      for (i = 0; i < nelem_; i++)
+         s += count_tag((bstring_t) {elem_[i].len, elem_[i].buf});
+      ops += nelem_;
+      ns = bench_now() - t;
+   }
+   while (ns < bench_ns_ && nelem_);
+   sink_ = s;
+
+   for (i = 0; i < nelem_; i++)
+      bytes += elem_[i].len;
+   bench_print("count_tag", ops, bytes * (ops / (nelem_ ? nelem_ : 1)), ns);
+}
+
+
+static void bench_process_elem(void)
+{
+   hpx_tag_t *tag;
+   int64_t t, ns;
+   long i, ops = 0, bytes = 0, s = 0;
+
+   if ((tag = hpx_tm_create(BENCH_MATTR)) == NULL)
+      perror("hpx_tm_create"), exit(EXIT_FAILURE);
+
+   t = bench_now();
+   do
+   {
+      for (i = 0; i < nelem_; i++)
+      {
+         hpx_process_elem(elem_[i], tag);
+         s += tag->nattr;
+      }
+      ops += nelem_;
+      ns = bench_now() - t;
+   }
+   while (ns < bench_ns_ && nelem_);
+   sink_ = s;
+   free(tag);
+
+   for (i = 0; i < nelem_; i++)
+      bytes += elem_[i].len;
+   bench_print("hpx_process_elem", ops, bytes * (ops / (nelem_ ? nelem_ : 1)), ns);
+}
+
+
+static void bench_tod(void)
+{
+   int64_t t, ns;
+   long i, ops = 0, bytes = 0;
+   double s = 0;
+
+   t = bench_now();
+   do
+   {
+      for (i = 0; i < ncoord_; i++)
+         s += bs_tod(coord_[i]);
+      ops += ncoord_;
+      ns = bench_now() - t;
+   }
+   while (ns < bench_ns_ && ncoord_);
+   sink_ = s;
+
+   for (i = 0; i < ncoord_; i++)
+      bytes += coord_[i].len;
+   bench_print("bs_tod", ops, bytes * (ops / (ncoord_ ? ncoord_ : 1)), ns);
+}
+
+
+static void bench_parse_time(void)
+{
+   int64_t t, ns;
+   long i, ops = 0, bytes = 0;
+   double s = 0;
+
+   t = bench_now();
+   do
+   {
+      for (i = 0; i < ntstamp_; i++)
+         s += parse_time(tstamp_[i]);
+      ops += ntstamp_;
+      ns = bench_now() - t;
+   }
+   while (ns < bench_ns_ && ntstamp_);
+   sink_ = s;
+
+   for (i = 0; i < ntstamp_; i++)
+      bytes += tstamp_[i].len;
+   bench_print("parse_time", ops, bytes * (ops / (ntstamp_ ? ntstamp_ : 1)), ns);
+}
+
+
+/*! Benchmark get_sectors(). The sector array is initialized by copying a
+ *  template, thus init_sector() is not measured.
+ */
+static void bench_get_sectors(void)
+{
+   struct sector sec0[MAX_SEC], sec[MAX_SEC];
+   int64_t t, ns;
+   long i, ops = 0, bytes = 0, s = 0;
+
+   for (i = 0; i < MAX_SEC; i++)
+      init_sector(&sec0[i]);
+
+   t = bench_now();
+   do
+   {
+      for (i = 0; i < nlight_; i++)
+      {
+         memcpy(sec, sec0, sizeof(sec));
+         s += get_sectors(light_[i].tree, sec, MAX_SEC);
+      }
+      ops += nlight_;
+      ns = bench_now() - t;
+   }
+   while (ns < bench_ns_ && nlight_);
+   sink_ = s;
+
+   for (i = 0; i < nlight_; i++)
+      bytes += light_[i].len;
+   bench_print("get_sectors", ops, bytes * (ops / (nlight_ ? nlight_ : 1)), ns);
+}
+
+
+static ssize_t bench_write(void *cookie, const char *buf, size_t size)
+{
+   out_bytes_ += size;
+   return size;
+}
+
+
+/*! Benchmark sector_calc2(). The generated elements are written as XML to
+ *  a stream which just counts the bytes.
+ */
+static void bench_sector_calc(void)
+{
+   cookie_io_functions_t iof = {NULL, bench_write, NULL, NULL};
+   smout_t *out;
+   FILE *f;
+   int64_t t, ns;
+   long i, ops = 0;
+   int j;
+
+   if ((f = fopencookie(NULL, "w", iof)) == NULL)
+      perror("fopencookie"), exit(EXIT_FAILURE);
+   if ((out = out_open(f, FMT_OSM, 0)) == NULL)
+      perror("out_open"), exit(EXIT_FAILURE);
+   set_output(out);
+
+   t = bench_now();
+   do
+   {
+      for (i = 0; i < nlight_; i++)
+         for (j = 0; j < light_[i].nsec; j++, ops++)
+            sector_calc2(&light_[i].nd, &light_[i].sec[j], light_[i].type);
+      ns = bench_now() - t;
+   }
+   while (ns < bench_ns_ && ops);
+
+   out_close(out);
+   fclose(f);
+   bench_print("sector_calc2", ops, out_bytes_, ns);
+}
+
+
+void usage(const char *s)
+{
+   printf("Microbenchmarks of the hot functions of smfilter.\n"
+         "usage: %s [OPTIONS] < inputfile\n"
+         "   -t <sec> ..... Minimum run time of each benchmark (default = %.1f).\n",
+         s, BENCH_TIME);
+}
+
+
+int main(int argc, char *argv[])
+{
+   double sec = BENCH_TIME;
+   int n;
+
+   while ((n = getopt(argc, argv, "ht:")) != -1)
+      switch (n)
+      {
+         case 'h':
+            usage(argv[0]);
+            exit(EXIT_SUCCESS);
+
+         case 't':
+            sec = atof(optarg);
+            break;
+
+         default:
+            usage(argv[0]);
+            exit(EXIT_FAILURE);
+      }
+
+   bench_ns_ = sec * 1E9;
+   bench_load(STDIN_FILENO);
+   printf("%ld elements, %ld coordinates, %ld timestamps, %ld seamarks\n",
+         nelem_, ncoord_, ntstamp_, nlight_);
+
+   bench_count_tag();
+   bench_process_elem();
+   bench_tod();
+   bench_parse_time();
+   bench_get_sectors();
+   bench_sector_calc();
+
+   return EXIT_SUCCESS;
+}
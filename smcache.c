@@ -0,0 +1,241 @@
+/* Copyright 2011 Bernhard R. Fischer, 2048R/5C5FFD47 <bf@abenteuerland.at>
+ *
+ * This file is part of smfilter.
+ *
+ * Smfilter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * Smfilter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with smfilter. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! This file contains the cache of generated objects. The output which is
+ *  generated for a seamark is stored with a hash of its definition as key.
+ *  If the seamark did not change since the previous run, the output is
+ *  copied from the cache instead of being calculated again.
+ *
+ *  The cache of the previous run is mapped into memory read-only. The
+ *  entries which are used in the current run are written to a new cache
+ *  file, which replaces the old one in gc_close(). Thus the cache contains
+ *  just the seamarks of the last run and does not grow.
+ *
+ *  @author Bernhard R. Fischer
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "smcache.h"
+
+
+//! name of cache file
+static char *name_ = NULL;
+//! old cache which is mapped into memory
+static const char *map_ = NULL;
+static size_t map_len_ = 0;
+static const struct gc_ent *idx_ = NULL;
+static uint64_t cnt_ = 0;
+//! new cache file
+static FILE *f_ = NULL;
+static struct gc_hdr hdr_;
+static struct gc_ent *ent_ = NULL;
+static uint64_t nent_ = 0, ment_ = 0;
+static uint64_t off_ = 0;
+
+
+/*! FNV-1a hash.
+ *  @param h Previous hash value or GC_HASH_INIT.
+ */
+uint64_t gc_hash(uint64_t h, const void *buf, size_t len)
+{
+   const uint8_t *s = buf;
+
+   for (; len; len--, s++)
+      h = (h ^ *s) * 1099511628211ull;
+   return h;
+}
+
+
+/*! Map old cache file into memory. The cache is ignored if it does not
+ *  exist, is broken, or was generated with different parameters.
+ */
+static void gc_map(const char *name, uint64_t param)
+{
+   const struct gc_hdr *h;
+   struct stat st;
+   int fd;
+
+   if ((fd = open(name, O_RDONLY)) == -1)
+      return;
+
+   if (fstat(fd, &st) == -1 || (size_t) st.st_size < sizeof(*h))
+   {
+      close(fd);
+      return;
+   }
+
+   map_ = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+   close(fd);
+   if (map_ == MAP_FAILED)
+   {
+      map_ = NULL;
+      return;
+   }
+   map_len_ = st.st_size;
+
+   h = (const struct gc_hdr*) map_;
+   if (memcmp(h->magic, GC_MAGIC, sizeof(h->magic)) || h->param != param ||
+         h->idx_off > map_len_ || h->cnt > (map_len_ - h->idx_off) / sizeof(*idx_))
+   {
+      munmap((void*) map_, map_len_);
+      map_ = NULL;
+      return;
+   }
+
+   idx_ = (const struct gc_ent*) (map_ + h->idx_off);
+   cnt_ = h->cnt;
+}
+
+
+/*! Open cache.
+ *  @param name Name of cache file.
+ *  @param param Hash of all parameters which influence the output.
+ *  @return 0 on success, -1 on error.
+ */
+int gc_open(const char *name, uint64_t param)
+{
+   char tmp[strlen(name) + 5];
+
+   gc_map(name, param);
+
+   snprintf(tmp, sizeof(tmp), "%s.tmp", name);
+   if ((f_ = fopen(tmp, "w")) == NULL)
+      return -1;
+
+   if ((name_ = strdup(name)) == NULL)
+      return -1;
+
+   memset(&hdr_, 0, sizeof(hdr_));
+   memcpy(hdr_.magic, GC_MAGIC, sizeof(hdr_.magic));
+   hdr_.param = param;
+   if (fwrite(&hdr_, sizeof(hdr_), 1, f_) != 1)
+      return -1;
+   off_ = sizeof(hdr_);
+
+   return 0;
+}
+
+
+/*! Lookup entry in old cache.
+ *  @param key Key of entry.
+ *  @param len Receives the length of the data.
+ *  @return Pointer to data or NULL if the key was not found.
+ */
+const char *gc_get(uint64_t key, size_t *len)
+{
+   uint64_t l = 0, r = cnt_, m;
+
+   while (l < r)
+   {
+      m = (l + r) / 2;
+      if (idx_[m].key < key)
+         l = m + 1;
+      else
+         r = m;
+   }
+
+   if (l >= cnt_ || idx_[l].key != key || idx_[l].off > map_len_ || idx_[l].len > map_len_ - idx_[l].off)
+      return NULL;
+
+   *len = idx_[l].len;
+   return map_ + idx_[l].off;
+}
+
+
+/*! Add entry to new cache.
+ *  @return 0 on success, -1 on error.
+ */
+int gc_put(uint64_t key, const void *buf, size_t len)
+{
+   struct gc_ent *e;
+   uint64_t n;
+
+   if (nent_ >= ment_)
+   {
+      n = ment_ ? ment_ * 2 : 4096;
+      if ((e = realloc(ent_, n * sizeof(*e))) == NULL)
+         return -1;
+      ent_ = e;
+      ment_ = n;
+   }
+
+   if (len && fwrite(buf, len, 1, f_) != 1)
+      return -1;
+
+   e = &ent_[nent_++];
+   e->key = key;
+   e->off = off_;
+   e->len = len;
+   off_ += len;
+
+   return 0;
+}
+
+
+static int gc_cmp(const void *a, const void *b)
+{
+   const struct gc_ent *x = a, *y = b;
+
+   return x->key < y->key ? -1 : x->key > y->key;
+}
+
+
+/*! Write index of new cache and replace the old cache file by it.
+ *  @return 0 on success, -1 on error.
+ */
+int gc_close(void)
+{
+   char tmp[strlen(name_) + 5];
+   int e = 0;
+
+   // the index is aligned to 8 bytes because it is accessed directly within
+   // the memory map
+   for (; off_ & 7; off_++)
+      if (fputc(0, f_) == EOF)
+         e = -1;
+
+   qsort(ent_, nent_, sizeof(*ent_), gc_cmp);
+   hdr_.idx_off = off_;
+   hdr_.cnt = nent_;
+
+   if (nent_ && fwrite(ent_, sizeof(*ent_), nent_, f_) != nent_)
+      e = -1;
+   if (!e && (fseek(f_, 0, SEEK_SET) == -1 || fwrite(&hdr_, sizeof(hdr_), 1, f_) != 1))
+      e = -1;
+   if (fclose(f_) == EOF)
+      e = -1;
+
+   if (map_ != NULL)
+      munmap((void*) map_, map_len_);
+
+   snprintf(tmp, sizeof(tmp), "%s.tmp", name_);
+   if (!e)
+      e = rename(tmp, name_);
+
+   free(ent_);
+   free(name_);
+   return e;
+}
+
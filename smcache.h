@@ -0,0 +1,59 @@
+/* Copyright 2011 Bernhard R. Fischer, 2048R/5C5FFD47 <bf@abenteuerland.at>
+ *
+ * This file is part of smfilter.
+ *
+ * Smfilter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * Smfilter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with smfilter. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SMCACHE_H
+#define SMCACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+
+//! magic bytes at the beginning of a cache file
+#define GC_MAGIC "SMCACHE1"
+//! initial value of gc_hash()
+#define GC_HASH_INIT 14695981039346656037ull
+
+
+/*! Header of cache file. The file consists of the header, the data of the
+ *  entries, and the index (struct gc_ent) sorted by key.
+ */
+struct gc_hdr
+{
+   char magic[8];
+   //! hash of the parameters which were used to generate the data
+   uint64_t param;
+   //! offset and number of entries of the index
+   uint64_t idx_off;
+   uint64_t cnt;
+};
+
+struct gc_ent
+{
+   uint64_t key;
+   uint64_t off;
+   uint64_t len;
+};
+
+
+uint64_t gc_hash(uint64_t h, const void *buf, size_t len);
+int gc_open(const char *name, uint64_t param);
+const char *gc_get(uint64_t key, size_t *len);
+int gc_put(uint64_t key, const void *buf, size_t len);
+int gc_close(void);
+
+#endif
+
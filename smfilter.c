@@ -23,25 +23,92 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <limits.h>
 #include <unistd.h>
 #include <string.h>
 #include <time.h>
 #include <errno.h>
 #include <math.h>
+#include <sys/stat.h>
 
 #include "osm_inplace.h"
 #include "bstring.h"
 #include "libhpxml.h"
 #include "seamark.h"
 #include "smlog.h"
+#include "smzip.h"
+#include "osm_pbf.h"
+#include "osm_o5m.h"
+#include "smout.h"
+#include "smstate.h"
+#include "smcache.h"
+#include "smindex.h"
+#include "smregion.h"
+#include "smtile.h"
+#include "smmvt.h"
+#include "smsect.h"
+#include "smstat.h"
 
 
+#define MAX_SEC 32
+
+//! output modes
+enum {DELTA_OFF, DELTA_GEN, DELTA_SRC};
+
 int oline_ = 0;
 int parse_rhint_ = 0;
 int untagged_circle_ = 0;
 int gen_lc_ = 0;
 int gen_sec_ = 1;
 double dir_arc_ = 2.0;
+int zip_ = ZIP_NONE;
+int zip_level_ = -1;
+int ifmt_ = FMT_OSM;
+int ofmt_ = FMT_OSM;
+int threads_ = -1;
+int delta_ = DELTA_OFF;
+//! state file of incremental mode, NULL if not in incremental mode
+char *state_ = NULL;
+//! current action block of osmChange input
+int osc_act_ = -1;
+//! number of nodes and ways previously generated for the current seamark
+int osc_old_[2];
+//! flag set while objects are deleted
+int osc_del_ = 0;
+//! name of cache file, NULL if no cache is used
+char *cache_ = NULL;
+//! name of index file, NULL if no index is used
+char *index_ = NULL;
+//! file offset of last element read and of the byte following it
+long ioff_ = 0, iend_ = 0;
+//! segment of index which is read, -1 if the whole input is read
+int iseg_ = -1;
+//! end of current segment
+long iseg_end_ = 0;
+//! output directory of tiles, NULL if no tiles are written
+char *tile_dir_ = NULL;
+int tile_zoom_ = TILE_ZOOM;
+//! output directory and zoom range of vector tiles, NULL if not written
+char *mvt_dir_ = NULL;
+int mvt_zmin_ = MVT_ZMIN, mvt_zmax_ = MVT_ZMAX;
+//! name of metrics file, NULL if no metrics are written, and its interval
+char *mfile_ = NULL;
+int minterval_ = METRICS_INTERVAL;
+//! name of validation report, NULL if not in validation mode
+char *valid_ = NULL;
+//! name of sector file, NULL if it is not written
+char *sect_ = NULL;
+//! flag set if a region is set (-B, -P)
+int region_ = 0;
+//! flag set if the current node is outside of the region
+int rskip_ = 0;
+//! type of way or relation which is buffered (RGN_WAY...), -1 if none
+int robj_ = -1;
+//! id of buffered object and flag set if it references kept objects
+int64_t robj_id_;
+int rref_;
+//! initial size of the input buffer
+long bufsize_ = HPX_BUF_SIZE;
 
 
 int match_node(const hpx_tree_t *t, bstring_t *b)
@@ -66,6 +133,302 @@ int match_node(const hpx_tree_t *t, bstring_t *b)
 }
 
 
+/*! Read next element from the input and parse it into tag.
+ *  @param ctl Control structure of XML reader.
+ *  @param pbf Control structure of PBF reader. If it is not NULL, ctl is
+ *  ignored.
+ *  @param o5m Control structure of o5m reader. If it is not NULL, ctl is
+ *  ignored.
+ *  @param tag Tag which receives the element.
+ *  @return 1 if tag was filled, 0 if the element could not be parsed, -1 on
+ *  eof.
+ */
+int next_tag(hpx_ctrl_t *ctl, pbf_ctrl_t *pbf, o5m_ctrl_t *o5m, hpx_tag_t *tag)
+{
+   struct idx_seg seg;
+   bstring_t b;
+   int e, p;
+
+   ST_COUNT(SC_ELEM);
+   if (pbf != NULL)
+   {
+      p = st_switch(ST_PARSE);
+      if ((e = pbf_get_tag(pbf, tag)) == -1)
+         perror("pbf_get_tag"), exit(EXIT_FAILURE);
+      st_switch(p);
+      return e ? 1 : -1;
+   }
+
+   if (o5m != NULL)
+   {
+      p = st_switch(ST_PARSE);
+      if ((e = o5m_get_tag(o5m, tag)) == -1)
+         perror("o5m_get_tag"), exit(EXIT_FAILURE);
+      st_switch(p);
+      return e ? 1 : -1;
+   }
+
+   // skip to next segment of index if the current one is finished
+   while (iseg_ >= 0 && hpx_tell(ctl) >= iseg_end_)
+   {
+      if (idx_get(++iseg_, &seg) == -1)
+         return -1;
+      if (hpx_seek(ctl, seg.off, seg.line) == -1)
+         perror("hpx_seek"), exit(EXIT_FAILURE);
+      iseg_end_ = seg.off + seg.len;
+   }
+
+   p = st_switch(ST_SCAN);
+   // line numbers are computed on demand from the file offsets
+   if (hpx_get_elem(ctl, &b, NULL, NULL) <= 0)
+   {
+      st_switch(p);
+      return -1;
+   }
+   tag->line = 0;
+   iend_ = hpx_tell(ctl);
+   ioff_ = iend_ - b.len;
+
+   st_switch(ST_PARSE);
+   e = !hpx_process_elem(b, tag);
+   st_switch(p);
+   return e;
+}
+
+
+/*! Return current position within the input. The number of buffer
+ *  refills of the XML parser is copied to the statistics as well.
+ */
+long in_pos(const hpx_ctrl_t *ctl)
+{
+   off_t pos;
+
+   if (ctl != NULL)
+   {
+      st_cnt_[SC_REFILL] = ctl->nfill;
+      return hpx_tell(ctl);
+   }
+   return (pos = lseek(STDIN_FILENO, 0, SEEK_CUR)) == -1 ? 0 : pos;
+}
+
+
+/*! Return line number of file offset off of the XML input. This is called
+ *  by the log (see log_set_lineno()).
+ */
+long in_lineno(void *ctl, long off)
+{
+   return hpx_lineno(ctl, off);
+}
+
+
+/*! Return numerical value of attribute name of tag, 0 if it does not exist.
+ */
+int64_t attr_long(hpx_tag_t *tag, const char *name)
+{
+   bstring_t b;
+
+   return get_value(name, tag, &b) == -1 ? 0 : bs_tol(b);
+}
+
+
+/*! Spatial filter. It is called for each element and decides if the node
+ *  is within the region. Ways and relations are buffered if objects are
+ *  passed through, and they are output when they are closed if they
+ *  reference any kept object.
+ *  @return 1 if the element shall be passed through, otherwise 0.
+ */
+int region_elem(smout_t *out, hpx_tag_t *tag)
+{
+   // kept objects are tracked only if they are passed through
+   int pass = state_ == NULL && delta_ == DELTA_OFF;
+   struct osm_node nd;
+   bstring_t b;
+
+   if (robj_ != -1)
+   {
+      if (rgn_buf_add(tag) == -1)
+         perror("rgn_buf_add"), exit(EXIT_FAILURE);
+
+      if (!bs_cmp(tag->tag, "nd"))
+         rref_ |= rgn_kept(RGN_NODE, attr_long(tag, "ref"));
+      else if (!bs_cmp(tag->tag, "member") && !get_value("type", tag, &b))
+         rref_ |= rgn_kept(!bs_cmp(b, "node") ? RGN_NODE : !bs_cmp(b, "way") ? RGN_WAY : RGN_REL,
+               attr_long(tag, "ref"));
+      else if (tag->type == HPX_CLOSE && (!bs_cmp(tag->tag, "way") || !bs_cmp(tag->tag, "relation")))
+      {
+         if (rref_)
+         {
+            if (rgn_keep(robj_, robj_id_) == -1)
+               perror("rgn_keep"), exit(EXIT_FAILURE);
+            oline_ += rgn_buf_flush(out);
+         }
+         else
+            rgn_buf_clear();
+         robj_ = -1;
+      }
+      return 0;
+   }
+
+   if (!bs_cmp(tag->tag, "node"))
+   {
+      if (tag->type == HPX_OPEN || tag->type == HPX_SINGLE)
+      {
+         nd.id = attr_long(tag, "id");
+         nd.lat = get_value("lat", tag, &b) == -1 ? 0 : bs_tod(b);
+         nd.lon = get_value("lon", tag, &b) == -1 ? 0 : bs_tod(b);
+         nd.cl = NCL(nd.lat, nd.lon);
+         rskip_ = !rgn_inside(&nd);
+         if (pass && !rskip_ && rgn_keep(RGN_NODE, nd.id) == -1)
+            perror("rgn_keep"), exit(EXIT_FAILURE);
+      }
+      return !rskip_;
+   }
+
+   if (!bs_cmp(tag->tag, "way") || !bs_cmp(tag->tag, "relation"))
+   {
+      // empty ways and relations do not reference anything
+      if (pass && tag->type == HPX_OPEN)
+      {
+         robj_ = !bs_cmp(tag->tag, "way") ? RGN_WAY : RGN_REL;
+         robj_id_ = attr_long(tag, "id");
+         rref_ = 0;
+         if (rgn_buf_add(tag) == -1)
+            perror("rgn_buf_add"), exit(EXIT_FAILURE);
+      }
+      return 0;
+   }
+
+   // tags of dropped nodes
+   if (!bs_cmp(tag->tag, "tag"))
+      return !rskip_;
+
+   return 1;
+}
+
+
+/*! Output node which was collected in the tree t.
+ *  @param close Closing tag of node.
+ */
+void out_node(smout_t *out, const hpx_tree_t *t, const hpx_tag_t *close)
+{
+   int i;
+
+   out_tag(out, t->tag);
+   for (i = 0; i < t->nsub; i++)
+      out_tag(out, t->subtag[i]->tag);
+   out_tag(out, close);
+}
+
+
+/*! Output seamark node of the input. It is copied from the input buffer if
+ *  possible, otherwise it is written tag by tag with out_node().
+ *  @param start File offset of the node.
+ */
+void src_node(smout_t *out, const hpx_ctrl_t *ctl, const hpx_tree_t *t, const hpx_tag_t *close, long start)
+{
+   const char *s;
+
+   if (ctl != NULL && OUT_RAW(out) && (s = hpx_buf_at(ctl, start, iend_ - start)) != NULL)
+      out_raw(out, s, iend_ - start);
+   else
+      out_node(out, t, close);
+}
+
+
+/*! Adjust the tags of the current node if the input buffer was moved by a
+ *  refill. The data of the node is kept in the buffer (see hpx_keep()) but it
+ *  is moved to its beginning or into an enlarged buffer.
+ *  @param b Input buffer and its size at the time of the last call.
+ *  @param off Buffer offset at the time of the last call.
+ *  Both are updated.
+ */
+void reloc_node(hpx_tree_t *t, const hpx_ctrl_t *ctl, bstring_t *b, long *off)
+{
+   const char *lo;
+   int i;
+
+   if (b->buf == ctl->buf.buf && *off == ctl->off)
+      return;
+
+   // the data before ctl->off was discarded, the rest is at ctl->buf.buf now
+   lo = b->buf + (ctl->off - *off);
+   hpx_tm_reloc(t->tag, lo, b->buf + b->len, ctl->buf.buf);
+   for (i = 0; i < t->nsub; i++)
+      hpx_tm_reloc(t->subtag[i]->tag, lo, b->buf + b->len, ctl->buf.buf);
+
+   b->buf = ctl->buf.buf;
+   b->len = ctl->len;
+   *off = ctl->off;
+}
+
+
+/*! Return the osmChange action of a generated object. The objects which are
+ *  generated for a seamark replace those of the previous run. Because of
+ *  the stable ids, all objects with a number which already existed before
+ *  are modified, all others are created.
+ */
+int osc_route(const hpx_tag_t *t)
+{
+   long seq;
+   int i;
+
+   if (osc_del_)
+      return OSC_DELETE;
+
+   for (i = 0; i < t->nattr; i++)
+      if (!bs_cmp(t->attr[i].name, "id"))
+         break;
+   if (i >= t->nattr)
+      return OSC_CREATE;
+
+   seq = -bs_tol(t->attr[i].value) & ((1L << GEN_ID_BITS) - 1);
+   return seq < osc_old_[bs_cmp(t->tag, "node") ? 1 : 0] ? OSC_MODIFY : OSC_CREATE;
+}
+
+
+/*! Start processing of a node in incremental mode.
+ */
+void osc_begin(long id)
+{
+   gst_get(id, &osc_old_[0], &osc_old_[1]);
+   set_base_id(id);
+}
+
+
+/*! Finish processing of a node in incremental mode. All objects which were
+ *  generated in the previous run but not in this one are deleted.
+ */
+void osc_end(smout_t *out, long id)
+{
+   int n[2], i;
+
+   get_gen_cnt(&n[0], &n[1]);
+
+   // ways first because they refer to the nodes
+   osc_del_ = 1;
+   for (i = n[1]; i < osc_old_[1]; i++)
+   {
+      out_elem(out, HPX_SINGLE, "way");
+      out_attr(out, "id", "%ld", gen_id(id, i));
+      out_attr(out, "version", "1");
+      out_end(out);
+   }
+   for (i = n[0]; i < osc_old_[0]; i++)
+   {
+      out_elem(out, HPX_SINGLE, "node");
+      out_attr(out, "id", "%ld", gen_id(id, i));
+      out_attr(out, "version", "1");
+      out_end(out);
+   }
+   osc_del_ = 0;
+
+   if (gst_put(id, n[0], n[1]) == -1)
+      perror("gst_put"), exit(EXIT_FAILURE);
+   if (out_flush_route(out) == -1)
+      perror("out_flush_route"), exit(EXIT_FAILURE);
+}
+
+
 void usage(const char *s)
 {
    printf("Seamark filter V1.1, (c) 2011, Bernhard R. Fischer, <bf@abenteuerland.at>.\n\n"
@@ -78,16 +441,62 @@ void usage(const char *s)
           "   -a <dist> ...... Set maximum arc segment distance (default = %.2f nm).\n"
           "                    If this is set to 0, it is ignored.\n"
           "   -b <degrees> ... Set degrees (+/-) of arc for directional lights (default = %.1f deg).\n"
+          "   -B <l,b,r,t> ... Output only nodes within the bounding box (degrees) and ways and\n"
+          "                    relations which reference them.\n"
           "   -c ............. Generate nodes with 'seamark:light_character' tag.\n"
           "   -d <div> ....... Arc divisor (default = %.2f).\n"
+          "   -f <format> .... Format of input file: 'osm' (default), 'pbf', or 'o5m'.\n"
+          "   -g ............. Output generated nodes and ways only, not the input.\n"
           "   -h ............. This help.\n"
           "   -H ............. Parse renderer hint (seamark:light:#=<col>:<start>:<end>:<r>).\n"
+          "   -I <size> ...... Initial size of the input buffer in MB (default = %d). It grows\n"
+          "                    if an element does not fit.\n"
           "   -i <node id> ... Set first id for numbering new nodes (default = -1).\n"
-          "   -l <filename> .. Output errors to file <filename>. Use \"stderr\" for output to stderr.\n"
+          "   -k <file> ...... Cache generated objects in <file> and reuse them for unchanged\n"
+          "                    seamarks in subsequent runs. Ids are derived from the seamark ids.\n"
+          "   -l <file>[:<level>] Output errors to file <file>. Use \"stderr\" for output to stderr.\n"
+          "                    The file is written as JSON lines if it ends with '.json'. The\n"
+          "                    level is 'error', 'warning', 'notice', or 'info' (default).\n"
+          "                    Just the first %d messages of each type are logged.\n"
+          "   -m <file>[:<n>]  Write counters and progress every <n> seconds (default = %d) to the\n"
+          "                    metrics file <file>, as JSON if it ends with '.json', otherwise in\n"
+          "                    the Prometheus text format.\n"
+          "   -M <dir>[:<z0>[-<z1>]] Write generated arcs and radials as Mapbox vector tiles\n"
+          "                    <dir>/<z>/<x>/<y>.mvt of the zoom levels <z0> to <z1>\n"
+          "                    (default = %d-%d) instead of the output.\n"
+          "   -n ............. Output the seamark nodes of the input as well (implies -g). This\n"
+          "                    extracts just the seamarks, OSM/XML nodes are copied unchanged.\n"
+          "   -o <format> .... Format of output file: 'osm' (default), 'pbf', 'o5m', 'geojson', or\n"
+          "                    'geojsonl'. The GeoJSON formats contain just the generated arcs and\n"
+          "                    radials as features, 'geojsonl' writes one feature per line.\n"
+          "   -P <file> ...... Like -B but with the region read from a polygon file (Osmosis format).\n"
           "   -r <radius> .... Default radius (default = %.2f nm).\n"
+          "   -s <file> ...... Write the processed sectors of all lights to the binary file <file>\n"
+          "                    which can be mapped into memory by renderers (see smsect.h).\n"
           "   -S ............. Do not render sectors.\n"
-          "   -U ............. Render a circle if a sector has neither start nor end angle (default = %d).\n\n",
-          s, arc_max_, dir_arc_, arc_div_, sec_radius_, untagged_circle_);
+          "   -t <n> ......... Number of threads for en-/decoding PBF blocks and for writing\n"
+          "                    tiles (default = #cpus).\n"
+          "   -T <dir>[:<z>] . Write generated objects into tiles <dir>/<z>/<x>/<y>.osm of zoom\n"
+          "                    level <z> (default = %d) instead of the output. Objects crossing\n"
+          "                    tile boundaries are written to all tiles they intersect.\n"
+          "   -u <file> ...... Incremental mode: read an osmChange file and output an osmChange of\n"
+          "                    the generated objects with stable ids. The state is kept in <file>.\n"
+          "   -v[<n>] ........ Print statistics (counters, time per stage, throughput) to stderr at\n"
+          "                    exit and progress every <n> seconds if <n> is given.\n"
+          "   -V <file> ...... Validation mode: check the seamarks and write all errors as JSON\n"
+          "                    lines (node, line, sector, code, msg) to <file> ('-' for stdout).\n"
+          "                    Nothing is rendered and no OSM output is written.\n"
+          "   -x <file> ...... Keep byte offsets of the seamark nodes of the input file in <file>.\n"
+          "                    Subsequent runs with -g or -n on the unchanged file read only\n"
+          "                    these nodes. Input must be an OSM/XML file.\n"
+          "   -U ............. Render a circle if a sector has neither start nor end angle (default = %d).\n"
+          "   -z <type>[:<l>]  Compress output with <type> at level <l> in a separate thread.\n"
+          "                    <type> is 'gzip'"
+#ifdef WITH_ZSTD
+          " or 'zstd'"
+#endif
+          ".\n\n",
+          s, arc_max_, dir_arc_, arc_div_, HPX_BUF_SIZE / (1024 * 1024), LOG_RATE_LIMIT, METRICS_INTERVAL, MVT_ZMIN, MVT_ZMAX, sec_radius_, TILE_ZOOM, untagged_circle_);
 }
 
 
@@ -109,21 +518,302 @@ void sort_sectors(struct sector *sec, int n)
 }
 
 
+/*! Parse the sectors of a seamark node and generate the nodes and ways
+ *  which render them.
+ *  @param tlist Node and its tags.
+ *  @param nd Node.
+ *  @param b Value of tag 'seamark:type'.
+ */
+void gen_seamark(const hpx_tree_t *tlist, const struct osm_node *nd, bstring_t b)
+{
+   struct sector sec[MAX_SEC];
+   int i, j, k, n, p;
+
+   p = st_switch(ST_GEN);
+   // init sector list
+   for (i = 0; i < MAX_SEC; i++)
+      init_sector(&sec[i]);
+
+   log_set_node(nd->id, ioff_, oline_);
+   i = get_sectors(tlist, sec, MAX_SEC);
+   if (gen_lc_ && valid_ == NULL)
+      pchar(nd, &sec[0]);
+   if (i)
+   {
+      for (i = 0, n = 0; i < MAX_SEC; i++)
+      {
+         // check all parsed sectors for its validity and remove
+         // illegal sectors
+         if (sec[i].used)
+         {
+            // Skip 0 degree sector if it is a directional
+            // light. Such definitions are incorrect and have
+            // been accidently imported with the LoL import.
+            if (i && (sec[i].start == sec[i].end) && (sec[i].start == sec[0].dir))
+            {
+               log_err(LOG_DEPRECATED, sec[i].nr, "deprecated feature: %d:sector_start == %d:sector_end == orientation (node %ld)", sec[i].nr, sec[i].nr, nd->id);
+               sec[i].used = 0;
+               continue;
+            }
+
+            if ((!isnan(sec[i].dir) && (sec[i].cat != CAT_DIR)) ||
+                 (isnan(sec[i].dir) && (sec[i].cat == CAT_DIR)))
+            {
+               log_err(LOG_DIR_INCOMPLETE, sec[i].nr, "sector %d has incomplete definition of directional light (node %ld)", sec[i].nr, nd->id);
+               sec[i].dir = NAN;
+               sec[i].cat = 0;
+               sec[i].used = 0;
+               continue;
+            }
+            if (isnan(sec[i].start) && isnan(sec[i].end))
+            {
+               if (sec[i].cat == CAT_DIR)
+               {
+                  sec[i].start = sec[i].end = sec[i].dir;
+               }
+               else if (untagged_circle_)
+               {
+                  sec[i].start = 0.0;
+                  sec[i].end = 360.0;
+               }
+               else
+               {
+                  log_err(LOG_NO_ANGLES, sec[i].nr, "sector %d of node %ld seems to lack start/end angle", sec[i].nr, nd->id);
+                  sec[i].used = 0;
+                  continue;
+               }
+            }
+            else if (isnan(sec[i].start) || isnan(sec[i].end))
+            {
+               log_err(LOG_ONE_ANGLE, sec[i].nr, "sector %d of node %ld has either no start or no end angle!", sec[i].nr, nd->id);
+               sec[i].used = 0;
+               continue;
+            }
+
+            if (sec[i].start > sec[i].end)
+               sec[i].end += 360;
+
+            // increase counter for valid sectors
+            n++;
+         } // if (sec[i].used)
+      } // for (i = 0; i < MAX_SEC; i++)
+
+      // remove all unused (or invalid) sectors
+      for (i = 0, j = 0; i < MAX_SEC && j < n; i++, j++)
+      {
+         if (sec[i].used)
+         {
+            sec[i].mean = (sec[i].start + sec[i].end) / 2;
+            continue;
+         }
+         memmove(&sec[i], &sec[i + 1], sizeof(struct sector) * (MAX_SEC - i - 1));
+         init_sector(&sec[MAX_SEC - 1]);
+         i--;
+         j--;
+      }
+ 
+      // sort sectors ascending on der mean angle
+      sort_sectors(&sec[0], n);
+
+      sec[n - 1].espace = sec[0].sspace = sec[0].start - sec[n - 1].end;
+      for (i = 0; i < n - 1; i++)
+         sec[i].espace = sec[i + 1].sspace = sec[i + 1].start - sec[i].end;
+      /*
+      if (sec[n - 1].end - 360 > sec[0].start)
+         sec[n - 1].end = sec[0].start = (sec[n - 1].end  - 360 + sec[0].start) / 2;
+      else
+         sec[n - 1].espace = sec[0].sspace = sec[0].start - sec[n - 1].end + 360;
+
+      for (i = 0; i < n - 1; i++)
+      {
+         if (sec[i].end > sec[i + 1].start)
+            sec[i].end = sec[i + 1].start = (sec[i].end + sec[i + 1].start) / 2;
+         else
+            sec[i].espace = sec[i + 1].sspace = sec[i + 1].start - sec[i].end;
+      }
+      */
+
+      // render sectors
+      for (i = 0; i < MAX_SEC; i++)
+      {
+         if (sec[i].used && gen_sec_)
+         {
+            if (proc_sfrac(&sec[i]) == -1)
+            {
+               log_err(LOG_NEG_ANGLE, sec[i].nr, "negative angle definition is just allowed in last segment! (sector %d node %ld)", sec[i].nr, nd->id);
+               continue;
+            }
+            ST_COUNT(SC_SECTOR);
+            if (sect_ != NULL && sct_put(nd, &sec[i]) == -1)
+               perror("sct_put"), exit(EXIT_FAILURE);
+            // in validation mode the sectors are checked but not rendered
+            if (valid_ != NULL)
+               continue;
+            //printf("   <!-- [%d]: start = %.2f, end = %.2f, col = %d, r = %.2f, nr = %d -->\n",
+            //   i, sec[i].start, sec[i].end, sec[i].col, sec[i].r, sec[i].nr);
+            sector_calc2(nd, &sec[i], b);
+
+            if (sec[i].col[1] != -1)
+            {
+               sec[i].sf[0].startr = sec[i].sf[sec[i].fused - 1].endr = 0;
+               for (j = 0; j < 4; j++)
+               {
+                  for (k = 0; k < sec[i].fused; k++)
+                     sec[i].sf[k].r -= altr_[j];
+                  sec[i].al++;
+                  sector_calc2(nd, &sec[i], b);
+               }
+            }
+         }
+      } // for (i = 0; n && i < MAX_SEC; i++)
+   } // if (get_sectors(tlist, sec, MAX_SEC))
+   st_switch(p);
+}
+
+
+/*! Hash of all parameters which influence the generated objects.
+ */
+uint64_t param_hash(void)
+{
+   uint64_t h = GC_HASH_INIT;
+
+   h = gc_hash(h, &arc_max_, sizeof(arc_max_));
+   h = gc_hash(h, &arc_div_, sizeof(arc_div_));
+   h = gc_hash(h, &sec_radius_, sizeof(sec_radius_));
+   h = gc_hash(h, &dir_arc_, sizeof(dir_arc_));
+   h = gc_hash(h, &gen_lc_, sizeof(gen_lc_));
+   h = gc_hash(h, &gen_sec_, sizeof(gen_sec_));
+   h = gc_hash(h, &parse_rhint_, sizeof(parse_rhint_));
+   h = gc_hash(h, &untagged_circle_, sizeof(untagged_circle_));
+   return h;
+}
+
+
+/*! Hash of the definition of a seamark. It includes all attributes which
+ *  are used for the output and all seamark tags. Each string is followed
+ *  by a separator byte, thus the hash does not depend on the quoting of
+ *  the input or the bytes following the string.
+ */
+uint64_t light_hash(const hpx_tree_t *t)
+{
+   static const char *attr[] = {"id", "lat", "lon", "version", "timestamp", NULL};
+   uint64_t h = GC_HASH_INIT;
+   const hpx_attr_t *a;
+   int i, j;
+
+   for (i = 0; i < t->tag->nattr; i++)
+   {
+      a = &t->tag->attr[i];
+      for (j = 0; attr[j] != NULL && bs_cmp(a->name, attr[j]); j++);
+      if (attr[j] == NULL)
+         continue;
+      h = gc_hash(h, a->name.buf, a->name.len);
+      h = gc_hash(h, "", 1);
+      h = gc_hash(h, a->value.buf, a->value.len);
+      h = gc_hash(h, "", 1);
+   }
+
+   for (i = 0; i < t->nsub; i++)
+   {
+      if (t->subtag[i]->tag->nattr < 2)
+         continue;
+      for (j = 0; j < 2; j++)
+      {
+         a = &t->subtag[i]->tag->attr[j];
+         h = gc_hash(h, a->value.buf, a->value.len);
+         h = gc_hash(h, "", 1);
+      }
+   }
+
+   return h;
+}
+
+
+/*! Generate the objects of a seamark and add them to the tiles. The
+ *  seamark node itself is added as well because the radials reference it.
+ *  @param close Closing tag of seamark node.
+ *  @param cap Output which writes into the memory stream mf.
+ */
+void tile_seamark(const hpx_tree_t *tlist, const hpx_tag_t *close, const struct osm_node *nd, bstring_t b, smout_t *out, smout_t *cap, FILE *mf, char **buf, size_t *len)
+{
+   double bb[4];
+
+   rewind(mf);
+   reset_gen_bbox();
+   out_node(cap, tlist, close);
+   set_output(cap);
+   gen_seamark(tlist, nd, b);
+   set_output(out);
+   if (fflush(mf) == EOF)
+      perror("fflush"), exit(EXIT_FAILURE);
+
+   if (get_gen_bbox(bb) != -1 && tile_put(bb, *buf, *len) == -1)
+      perror("tile_put"), exit(EXIT_FAILURE);
+}
+
+
+/*! Generate the objects of a seamark and store them in the cache or copy
+ *  them from the cache if the seamark did not change.
+ *  @param cap Output which writes into the memory stream mf.
+ */
+void cache_seamark(const hpx_tree_t *tlist, const struct osm_node *nd, bstring_t b, smout_t *out, smout_t *cap, FILE *mf, char **buf, size_t *len)
+{
+   const char *p;
+   uint64_t key;
+   size_t n;
+
+   key = light_hash(tlist);
+   if ((p = gc_get(key, &n)) == NULL)
+   {
+      rewind(mf);
+      set_output(cap);
+      gen_seamark(tlist, nd, b);
+      set_output(out);
+      if (fflush(mf) == EOF)
+         perror("fflush"), exit(EXIT_FAILURE);
+      p = *buf;
+      n = *len;
+   }
+
+   if (gc_put(key, p, n) == -1)
+      perror("gc_put"), exit(EXIT_FAILURE);
+   if (n && fwrite(p, n, 1, stdout) != 1)
+      perror("fwrite"), exit(EXIT_FAILURE);
+}
+
+
 int main(int argc, char *argv[])
 {
-   FILE *f = NULL;
-   hpx_ctrl_t *ctl;
+   FILE *frep = NULL;
+   hpx_ctrl_t *ctl = NULL;
+   pbf_ctrl_t *pbf = NULL;
+   o5m_ctrl_t *o5m = NULL;
+   smout_t *out, *cap = NULL;
+   FILE *mf = NULL;
+   char *mbuf = NULL;
+   size_t mlen = 0;
    hpx_tag_t *tag;
    bstring_t b;
-   int i, j, k;
+   int e;
    struct osm_node *nd;
    hpx_tree_t *tlist = NULL;
-#define MAX_SEC 32
-   struct sector sec[MAX_SEC];
+   // index: end of header, trailer, start and line of current node
+   long ihead = -1, itail = -1, itline = 0, prev_end = 0, nstart = 0;
+   // input buffer and its offset at last relocation of the current node
+   bstring_t nbuf = {0, NULL};
+   long noff = 0;
+   int iwrite = 0;
+   struct idx_seg seg;
+   // strings where the input continues after skipping ways and relations
+   static const char *const skip_pat[] = {"<node", "</osm", NULL};
+   int skip;
+   struct stat st;
+   char *p;
+   long ivl;
 
    int n;
 
-   while ((n = getopt(argc, argv, "a:b:chHi:l:d:r:SU")) != -1)
+   while ((n = getopt(argc, argv, "a:b:B:cd:f:ghHi:I:k:l:m:M:no:P:r:s:St:T:u:Uv::V:x:z:")) != -1)
       switch (n)
       {
          case 'a':
@@ -134,20 +824,63 @@ int main(int argc, char *argv[])
             dir_arc_ = atof(optarg);
             break;
 
+         case 'B':
+         case 'P':
+            if (region_)
+               fprintf(stderr, "*** only one region may be set\n"), exit(EXIT_FAILURE);
+            if ((n == 'B' ? rgn_bbox(optarg) : rgn_poly(optarg)) == -1)
+               fprintf(stderr, "*** cannot set region '%s': %s\n", optarg, strerror(errno)),
+                  exit(EXIT_FAILURE);
+            region_ = 1;
+            break;
+
          case 'c':
             gen_lc_ = 1;
             break;
 
+         case 'k':
+            cache_ = optarg;
+            break;
+
          case 'l':
-            if (!strcmp(optarg, "stderr"))
+            if (log_open(optarg) == -1)
+               exit(EXIT_FAILURE);
+            break;
+
+         case 'f':
+            if ((ifmt_ = parse_fmt(optarg)) == -1 || ifmt_ == FMT_GEOJSON || ifmt_ == FMT_GEOJSONL)
+               fprintf(stderr, "*** unknown input format '%s'\n", optarg),
+                  exit(EXIT_FAILURE);
+            break;
+
+         case 'o':
+            if ((ofmt_ = parse_fmt(optarg)) == -1)
+               fprintf(stderr, "*** unknown output format '%s'\n", optarg),
+                  exit(EXIT_FAILURE);
+            break;
+
+         case 'M':
+            mvt_dir_ = optarg;
+            ofmt_ = FMT_MVT;
+            if ((p = strrchr(optarg, ':')) != NULL)
             {
-               f = stderr;
+               *p++ = '\0';
+               mvt_zmin_ = mvt_zmax_ = atoi(p);
+               if ((p = strchr(p, '-')) != NULL)
+                  mvt_zmax_ = atoi(p + 1);
             }
-            else if ((f = fopen(optarg, "w")) == NULL)
-               fprintf(stderr, "*** Cannot open file '%s': %s\n", optarg, strerror(errno)),
+            if (mvt_zmin_ < 0 || mvt_zmax_ > MVT_MAX_ZOOM || mvt_zmin_ > mvt_zmax_)
+               fprintf(stderr, "*** illegal zoom range of vector tiles (0-%d)\n", MVT_MAX_ZOOM),
                   exit(EXIT_FAILURE);
-            log_set_stream(f);
-            log_msg("\n# Smfilter log file. Numbers in square brackets show line numbers of\n# input/output file. The error is always in the node/way before\n# the printed line number.");
+            break;
+
+         case 'g':
+            if (delta_ == DELTA_OFF)
+               delta_ = DELTA_GEN;
+            break;
+
+         case 'n':
+            delta_ = DELTA_SRC;
             break;
 
          case 'h':
@@ -158,6 +891,11 @@ int main(int argc, char *argv[])
             parse_rhint_ = 1;
             break;
 
+         case 'I':
+            if ((bufsize_ = atof(optarg) * 1024 * 1024) < 4096)
+               fprintf(stderr, "*** input buffer too small\n"), exit(EXIT_FAILURE);
+            break;
+
          case 'i':
             set_id(atol(optarg));
             break;
@@ -170,20 +908,219 @@ int main(int argc, char *argv[])
             sec_radius_ = atof(optarg);
             break;
 
+         case 's':
+            sect_ = optarg;
+            break;
+
          case 'S':
             gen_sec_ = 0;
             break;
 
+         case 't':
+            threads_ = atoi(optarg);
+            break;
+
+         case 'T':
+            tile_dir_ = optarg;
+            if ((p = strrchr(optarg, ':')) != NULL)
+            {
+               *p = '\0';
+               tile_zoom_ = atoi(p + 1);
+            }
+            break;
+
+         case 'u':
+            state_ = optarg;
+            break;
+
          case 'U':
             untagged_circle_ = 1;
             break;
+
+         case 'm':
+            mfile_ = optarg;
+            if ((p = strrchr(optarg, ':')) != NULL)
+            {
+               *p = '\0';
+               minterval_ = atoi(p + 1);
+            }
+            break;
+
+         case 'v':
+            // a negative interval would print the progress endlessly
+            ivl = 0;
+            if (optarg != NULL && ((ivl = strtol(optarg, &p, 10)) < 0 || ivl > INT_MAX || p == optarg || *p != '\0'))
+               fprintf(stderr, "*** illegal progress interval '%s'\n", optarg), exit(EXIT_FAILURE);
+            st_init(ivl);
+            break;
+
+         case 'V':
+            valid_ = optarg;
+            break;
+
+         case 'x':
+            index_ = optarg;
+            break;
+
+         case 'z':
+            if ((zip_ = zip_parse(optarg, &zip_level_)) == -1)
+               fprintf(stderr, "*** unsupported compression type '%s'\n", optarg),
+                  exit(EXIT_FAILURE);
+            break;
       }
 
    if ((arc_div_ <= 0) || (sec_radius_ <= 0) || (dir_arc_ <= 0))
       fprintf(stderr, "*** illegal parameters!\n"), exit(EXIT_FAILURE);
 
-   if ((ctl = hpx_init_simple()) == NULL)
-      perror("hpx_init_simple"), exit(EXIT_FAILURE);
+   if (zip_ != ZIP_NONE)
+   {
+      // stdout is a normal variable in glibc and may be reassigned
+      fflush(stdout);
+      if ((stdout = zip_fdopen(STDOUT_FILENO, zip_, zip_level_)) == NULL)
+         perror("zip_fdopen"), exit(EXIT_FAILURE);
+   }
+
+   if (threads_ < 0 && (threads_ = sysconf(_SC_NPROCESSORS_ONLN)) == -1)
+      threads_ = 0;
+
+   if (mfile_ != NULL)
+   {
+      // the size is known only for regular files
+      if (st_metrics(mfile_, minterval_, fstat(STDIN_FILENO, &st) != -1 && S_ISREG(st.st_mode) ? st.st_size : 0) == -1)
+         perror("st_metrics"), exit(EXIT_FAILURE);
+   }
+
+   if (valid_ != NULL)
+   {
+      if (state_ != NULL || cache_ != NULL || tile_dir_ != NULL || mvt_dir_ != NULL || ofmt_ != FMT_OSM)
+         fprintf(stderr, "*** validation mode cannot be combined with output options\n"),
+            exit(EXIT_FAILURE);
+      if (!strcmp(valid_, "-"))
+         frep = stdout;
+      else if ((frep = fopen(valid_, "w")) == NULL)
+         fprintf(stderr, "*** Cannot open file '%s': %s\n", valid_, strerror(errno)),
+            exit(EXIT_FAILURE);
+      log_set_report(frep);
+      // nothing is passed through, ways and relations are skipped
+      delta_ = DELTA_GEN;
+   }
+
+   if (mvt_dir_ != NULL)
+   {
+      if (state_ != NULL || cache_ != NULL || tile_dir_ != NULL)
+         fprintf(stderr, "*** vector tiles cannot be written in incremental, cache, or tile mode\n"),
+            exit(EXIT_FAILURE);
+      if ((out = out_open_mvt(stdout, mvt_dir_, mvt_zmin_, mvt_zmax_, threads_)) == NULL)
+         fprintf(stderr, "*** cannot write vector tiles to '%s': %s\n", mvt_dir_, strerror(errno)),
+            exit(EXIT_FAILURE);
+   }
+   else if ((out = out_open(stdout, ofmt_, threads_)) == NULL)
+      perror("out_open"), exit(EXIT_FAILURE);
+   set_output(out);
+
+   if (cache_ != NULL)
+   {
+      if (ofmt_ != FMT_OSM || state_ != NULL || tile_dir_ != NULL)
+         fprintf(stderr, "*** cache requires OSM/XML output and cannot be used in incremental or tile mode\n"),
+            exit(EXIT_FAILURE);
+      if (gc_open(cache_, param_hash()) == -1)
+         fprintf(stderr, "*** cannot open cache '%s': %s\n", cache_, strerror(errno)),
+            exit(EXIT_FAILURE);
+   }
+
+   if (sect_ != NULL)
+   {
+      // cached and unchanged seamarks are not processed
+      if (state_ != NULL || cache_ != NULL)
+         fprintf(stderr, "*** sector file cannot be written in incremental or cache mode\n"),
+            exit(EXIT_FAILURE);
+      if (sct_open(sect_) == -1)
+         fprintf(stderr, "*** cannot write sector file '%s': %s\n", sect_, strerror(errno)),
+            exit(EXIT_FAILURE);
+   }
+
+   if (tile_dir_ != NULL)
+   {
+      if (state_ != NULL)
+         fprintf(stderr, "*** tiles cannot be written in incremental mode\n"), exit(EXIT_FAILURE);
+      if (tile_open(tile_dir_, tile_zoom_) == -1)
+         fprintf(stderr, "*** cannot write tiles to '%s': %s\n", tile_dir_, strerror(errno)),
+            exit(EXIT_FAILURE);
+   }
+
+   // generated objects are captured in memory for the cache and the tiles
+   if (cache_ != NULL || tile_dir_ != NULL)
+   {
+      if ((mf = open_memstream(&mbuf, &mlen)) == NULL)
+         perror("open_memstream"), exit(EXIT_FAILURE);
+      if ((cap = out_open(mf, FMT_OSM, 0)) == NULL)
+         perror("out_open"), exit(EXIT_FAILURE);
+   }
+
+   if (state_ != NULL)
+   {
+      if (ifmt_ != FMT_OSM || ofmt_ != FMT_OSM)
+         fprintf(stderr, "*** incremental mode requires OSM/XML input and output\n"),
+            exit(EXIT_FAILURE);
+      if (gst_load(state_) == -1)
+         fprintf(stderr, "*** cannot load state file '%s': %s\n", state_, strerror(errno)),
+            exit(EXIT_FAILURE);
+      if (out_route(out, osc_route) == -1)
+         perror("out_route"), exit(EXIT_FAILURE);
+      printf("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<osmChange version=\"0.6\" generator=\"smfilter\">\n");
+   }
+
+   if (index_ != NULL && (ifmt_ != FMT_OSM || state_ != NULL))
+      fprintf(stderr, "*** index requires OSM/XML input and cannot be used in incremental mode\n"),
+         exit(EXIT_FAILURE);
+
+   if (ifmt_ == FMT_PBF)
+   {
+      if ((pbf = pbf_init(STDIN_FILENO, threads_)) == NULL)
+         perror("pbf_init"), exit(EXIT_FAILURE);
+   }
+   else if (ifmt_ == FMT_O5M)
+   {
+      if ((o5m = o5m_init(STDIN_FILENO)) == NULL)
+         perror("o5m_init"), exit(EXIT_FAILURE);
+   }
+   else if (index_ != NULL)
+   {
+      if (fstat(STDIN_FILENO, &st) == -1)
+         perror("fstat"), exit(EXIT_FAILURE);
+      if (!S_ISREG(st.st_mode))
+         fprintf(stderr, "*** index requires a regular input file\n"), exit(EXIT_FAILURE);
+      if ((e = idx_load(index_, &st)) == -1)
+         fprintf(stderr, "*** cannot load index file '%s': %s\n", index_, strerror(errno)),
+            exit(EXIT_FAILURE);
+
+      // the input is skipped only if it is not passed through
+      if (e && delta_ != DELTA_OFF)
+      {
+         if ((ctl = hpx_init(STDIN_FILENO, -st.st_size)) == NULL)
+            perror("hpx_init"), exit(EXIT_FAILURE);
+         (void) idx_get(0, &seg);
+         iseg_ = 0;
+         iseg_end_ = seg.len;
+      }
+      else
+      {
+         // a stale index is rebuilt
+         iwrite = !e;
+         idx_free();
+         if ((ctl = hpx_init(STDIN_FILENO, bufsize_)) == NULL)
+            perror("hpx_init"), exit(EXIT_FAILURE);
+      }
+   }
+   else if ((ctl = hpx_init(STDIN_FILENO, bufsize_)) == NULL)
+      perror("hpx_init"), exit(EXIT_FAILURE);
+   if (ctl != NULL)
+   {
+      log_set_lineno(in_lineno, ctl);
+      // lines are counted on refills just if they are needed
+      ctl->lines = log_enabled() || iwrite;
+   }
+
    if ((nd = malloc_node()) == NULL)
       perror("malloc_node"), exit(EXIT_FAILURE);
 
@@ -195,19 +1132,73 @@ int main(int argc, char *argv[])
    tlist->nsub = 0;
    tag = tlist->tag;
    nd->type = OSM_NA;
+   skip = ctl != NULL && delta_ != DELTA_OFF && state_ == NULL && iseg_ < 0;
 
-   while (hpx_get_elem(ctl, &b, NULL, &tag->line) > 0)
+   while ((e = next_tag(ctl, pbf, o5m, tag)) != -1)
    {
-      if (!hpx_process_elem(b, tag))
+      if (st_due())
+         st_update(in_pos(ctl));
+
+      if (ctl != NULL && nd->type == OSM_NODE)
+         reloc_node(tlist, ctl, &nbuf, &noff);
+
+      if (iwrite)
+      {
+         if (e && ihead == -1 && (!bs_cmp(tag->tag, "node") || !bs_cmp(tag->tag, "way") || !bs_cmp(tag->tag, "relation")))
+            ihead = prev_end;
+         if (e && tag->type == HPX_CLOSE && !bs_cmp(tag->tag, "osm"))
+         {
+            itail = ioff_;
+            itline = hpx_lineno(ctl, ioff_);
+         }
+         prev_end = iend_;
+      }
+
+      if (e)
       {
-         hpx_fprintf_tag(stdout, tag);
-         oline_++;
+         // in delta mode just the document structure is passed through
+         if ((!region_ || region_elem(out, tag)) && state_ == NULL && valid_ == NULL
+               && (delta_ == DELTA_OFF || tag->type == HPX_INSTR || !bs_cmp(tag->tag, "osm")))
+         {
+            out_tag(out, tag);
+            oline_++;
+         }
+
+         // in delta mode ways and relations are not needed, thus the input
+         // is skipped up to the next node (or the end of the document)
+         if (skip && (tag->type == HPX_OPEN || tag->type == HPX_SINGLE)
+               && (!bs_cmp(tag->tag, "way") || !bs_cmp(tag->tag, "relation")))
+         {
+            (void) hpx_skip(ctl, skip_pat);
+            continue;
+         }
+
+         if (state_ != NULL && tag->type == HPX_OPEN)
+         {
+            if (!bs_cmp(tag->tag, "create"))
+               osc_act_ = OSC_CREATE;
+            else if (!bs_cmp(tag->tag, "modify"))
+               osc_act_ = OSC_MODIFY;
+            else if (!bs_cmp(tag->tag, "delete"))
+               osc_act_ = OSC_DELETE;
+         }
          if (!bs_cmp(tag->tag, "node"))
          {
+            if (tag->type == HPX_OPEN || tag->type == HPX_SINGLE)
+               ST_COUNT(SC_NODE);
+
             if (tag->type == HPX_OPEN)
             {
                nd->type = OSM_NODE;
                proc_osm_node(tag, nd);
+               nstart = ioff_;
+               if (ctl != NULL)
+               {
+                  hpx_keep(ctl, nstart);
+                  nbuf.buf = ctl->buf.buf;
+                  nbuf.len = ctl->len;
+                  noff = ctl->off;
+               }
                if (tlist->nsub >= tlist->msub)
                {
                   if (hpx_tree_resize(&tlist, 1) == -1)
@@ -220,145 +1211,50 @@ int main(int argc, char *argv[])
                tlist->subtag[tlist->nsub]->nsub = 0;
                tag = tlist->subtag[tlist->nsub]->tag;
             }
+            else if (tag->type == HPX_SINGLE && state_ != NULL)
+            {
+               // untagged or deleted node, remove generated objects if any
+               proc_osm_node(tag, nd);
+               osc_begin(nd->id);
+               osc_end(out, nd->id);
+            }
             else if (tag->type == HPX_CLOSE)
             {
-               if (match_node(tlist, &b))
+               if (state_ != NULL)
+                  osc_begin(nd->id);
+
+               if ((state_ == NULL || osc_act_ != OSC_DELETE) && match_node(tlist, &b))
                {
-                  // init sector list
-                  for (i = 0; i < MAX_SEC; i++)
-                     init_sector(&sec[i]);
-
-                  i = get_sectors(tlist, sec, MAX_SEC);
-                  if (gen_lc_)
-                     pchar(nd, &sec[0]);
-                  if (i)
+                  ST_COUNT(SC_SEAMARK);
+                  if (iwrite && idx_add(nstart, iend_ - nstart, hpx_lineno(ctl, nstart)) == -1)
+                     perror("idx_add"), exit(EXIT_FAILURE);
+
+                  // nodes outside of the region are indexed but not rendered
+                  if (!rskip_)
                   {
-                     for (i = 0, n = 0; i < MAX_SEC; i++)
-                     {
-                        // check all parsed sectors for its validity and remove
-                        // illegal sectors
-                        if (sec[i].used)
-                        {
-                           // Skip 0 degree sector if it is a directional
-                           // light. Such definitions are incorrect and have
-                           // been accidently imported with the LoL import.
-                           if (i && (sec[i].start == sec[i].end) && (sec[i].start == sec[0].dir))
-                           {
-                              log_msg("deprecated feature: %d:sector_start == %d:sector_end == orientation (node %ld)", sec[i].nr, sec[i].nr, nd->id);
-                              sec[i].used = 0;
-                              continue;
-                           }
-
-                           if ((!isnan(sec[i].dir) && (sec[i].cat != CAT_DIR)) ||
-                                (isnan(sec[i].dir) && (sec[i].cat == CAT_DIR)))
-                           {
-                              log_msg("sector %d has incomplete definition of directional light (node %ld)", sec[i].nr, nd->id);
-                              sec[i].dir = NAN;
-                              sec[i].cat = 0;
-                              sec[i].used = 0;
-                              continue;
-                           }
-                           if (isnan(sec[i].start) && isnan(sec[i].end))
-                           {
-                              if (sec[i].cat == CAT_DIR)
-                              {
-                                 sec[i].start = sec[i].end = sec[i].dir;
-                              }
-                              else if (untagged_circle_)
-                              {
-                                 sec[i].start = 0.0;
-                                 sec[i].end = 360.0;
-                              }
-                              else
-                              {
-                                 log_msg("sector %d of node %ld seems to lack start/end angle", sec[i].nr, nd->id);
-                                 sec[i].used = 0;
-                                 continue;
-                              }
-                           }
-                           else if (isnan(sec[i].start) || isnan(sec[i].end))
-                           {
-                              log_msg("sector %d of node %ld has either no start or no end angle!", sec[i].nr, nd->id);
-                              sec[i].used = 0;
-                              continue;
-                           }
-
-                           if (sec[i].start > sec[i].end)
-                              sec[i].end += 360;
-
-                           // increase counter for valid sectors
-                           n++;
-                        } // if (sec[i].used)
-                     } // for (i = 0; i < MAX_SEC; i++)
-
-                     // remove all unused (or invalid) sectors
-                     for (i = 0, j = 0; i < MAX_SEC && j < n; i++, j++)
-                     {
-                        if (sec[i].used)
-                        {
-                           sec[i].mean = (sec[i].start + sec[i].end) / 2;
-                           continue;
-                        }
-                        memcpy(&sec[i], &sec[i + 1], sizeof(struct sector) * (MAX_SEC - i - 1));
-                        init_sector(&sec[MAX_SEC - 1]);
-                        i--;
-                        j--;
-                     }
- 
-                     // sort sectors ascending on der mean angle
-                     sort_sectors(&sec[0], n);
-
-                     sec[n - 1].espace = sec[0].sspace = sec[0].start - sec[n - 1].end;
-                     for (i = 0; i < n - 1; i++)
-                        sec[i].espace = sec[i + 1].sspace = sec[i + 1].start - sec[i].end;
-                     /*
-                     if (sec[n - 1].end - 360 > sec[0].start)
-                        sec[n - 1].end = sec[0].start = (sec[n - 1].end  - 360 + sec[0].start) / 2;
-                     else
-                        sec[n - 1].espace = sec[0].sspace = sec[0].start - sec[n - 1].end + 360;
+                     if (delta_ == DELTA_SRC && state_ == NULL)
+                        src_node(out, ctl, tlist, tag, nstart);
 
-                     for (i = 0; i < n - 1; i++)
+                     if (tile_dir_ != NULL)
+                        tile_seamark(tlist, tag, nd, b, out, cap, mf, &mbuf, &mlen);
+                     else if (cache_ != NULL)
                      {
-                        if (sec[i].end > sec[i + 1].start)
-                           sec[i].end = sec[i + 1].start = (sec[i].end + sec[i + 1].start) / 2;
-                        else
-                           sec[i].espace = sec[i + 1].sspace = sec[i + 1].start - sec[i].end;
+                        set_base_id(nd->id);
+                        cache_seamark(tlist, nd, b, out, cap, mf, &mbuf, &mlen);
                      }
-                     */
-
-                     // render sectors
-                     for (i = 0; i < MAX_SEC; i++)
-                     {
-                        if (sec[i].used && gen_sec_)
-                        {
-                           if (proc_sfrac(&sec[i]) == -1)
-                           {
-                              log_msg("negative angle definition is just allowed in last segment! (sector %d node %ld)", sec[i].nr, nd->id);
-                              continue;
-                           }
-                           //printf("   <!-- [%d]: start = %.2f, end = %.2f, col = %d, r = %.2f, nr = %d -->\n",
-                           //   i, sec[i].start, sec[i].end, sec[i].col, sec[i].r, sec[i].nr);
-                           sector_calc2(nd, &sec[i], b);
-
-                           if (sec[i].col[1] != -1)
-                           {
-                              sec[i].sf[0].startr = sec[i].sf[sec[i].fused - 1].endr = 0;
-                              for (j = 0; j < 4; j++)
-                              {
-                                 for (k = 0; k < sec[i].fused; k++)
-                                    sec[i].sf[k].r -= altr_[j];
-                                 sec[i].al++;
-                                 sector_calc2(nd, &sec[i], b);
-                              }
-                           }
-                        }
-                     } // for (i = 0; n && i < MAX_SEC; i++)
-                  } // if (get_sectors(tlist, sec, MAX_SEC))
+                     else
+                        gen_seamark(tlist, nd, b);
+                  }
                } // if (match_node(tlist))
 
+               if (state_ != NULL)
+                  osc_end(out, nd->id);
+
                tlist->nsub = 0;
                tag = tlist->tag;
                nd->type = OSM_NA;
+               if (ctl != NULL)
+                  hpx_keep(ctl, -1);
             }
             continue;
          } //if (!bs_cmp(tag->tag, "node"))
@@ -384,11 +1280,71 @@ int main(int argc, char *argv[])
       }
    }
 
-   if (f != NULL)
-      fclose(f);
+   if (frep != NULL && (fflush(frep) == EOF || (frep != stdout && fclose(frep) == EOF)))
+      fprintf(stderr, "*** cannot write validation report '%s': %s\n", valid_, strerror(errno)),
+         exit(EXIT_FAILURE);
+
+   if (state_ != NULL)
+      printf("</osmChange>\n");
+
+   if (cache_ != NULL && gc_close() == -1)
+      fprintf(stderr, "*** cannot write cache '%s': %s\n", cache_, strerror(errno)),
+         exit(EXIT_FAILURE);
+
+   if (sect_ != NULL && sct_close() == -1)
+      fprintf(stderr, "*** cannot write sector file '%s': %s\n", sect_, strerror(errno)),
+         exit(EXIT_FAILURE);
+
+   if (tile_dir_ != NULL && tile_close(threads_) == -1)
+      fprintf(stderr, "*** cannot write tiles to '%s': %s\n", tile_dir_, strerror(errno)),
+         exit(EXIT_FAILURE);
+
+   if (cap != NULL)
+   {
+      if (out_close(cap) == -1)
+         perror("out_close"), exit(EXIT_FAILURE);
+      fclose(mf);
+      free(mbuf);
+   }
+
+   if (out_close(out) == -1)
+      perror("out_close"), exit(EXIT_FAILURE);
+   st_print(in_pos(ctl));
+   log_close();
+
+   if (iwrite)
+   {
+      if (itail == -1)
+         itail = prev_end;
+      if (ihead == -1)
+         ihead = itail;
+      if (idx_save(index_, &st, ihead, itail, itline) == -1)
+         fprintf(stderr, "*** cannot save index file '%s': %s\n", index_, strerror(errno)),
+            exit(EXIT_FAILURE);
+   }
+   if (index_ != NULL)
+      idx_free();
+   if (region_)
+      rgn_free();
+
+   if (state_ != NULL)
+   {
+      if (gst_save(state_) == -1)
+         fprintf(stderr, "*** cannot save state file '%s': %s\n", state_, strerror(errno)),
+            exit(EXIT_FAILURE);
+      gst_free();
+   }
+
+   if (zip_ != ZIP_NONE && fclose(stdout) == EOF)
+      perror("fclose"), exit(EXIT_FAILURE);
 
    hpx_tm_free(tag);
-   hpx_free(ctl);
+   if (pbf != NULL)
+      pbf_free(pbf);
+   else if (o5m != NULL)
+      o5m_free(o5m);
+   else
+      hpx_free(ctl);
    free(nd);
 
    exit(EXIT_SUCCESS);
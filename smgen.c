@@ -0,0 +1,238 @@
+/* Copyright 2011 Bernhard R. Fischer, 2048R/5C5FFD47 <bf@abenteuerland.at>
+ *
+ * This file is part of smfilter.
+ *
+ * Smfilter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * Smfilter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with smfilter. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! This program writes a synthetic OSM/XML file to stdout. It is used to
+ *  generate input of arbitrary size for performance measurements of
+ *  smfilter, e.g.
+ *
+ *     ./smgen -n 1000000 -s 0.01 | ./smfilter -v > /dev/null
+ *
+ *  The output depends only on the options, i.e. it is identical for the same
+ *  seed on all platforms.
+ *
+ *  @author Bernhard R. Fischer
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+
+
+//! default number of nodes
+#define GEN_NODES 100000
+//! default number of tags of a tagged node
+#define GEN_TAGS 3
+//! default fraction of tagged nodes
+#define GEN_TAGGED 0.1
+//! default fraction of seamark lights
+#define GEN_SEAMARK 0.001
+//! default number of sectors of a light
+#define GEN_SECTORS 4
+//! default number of radius segments of a sector
+#define GEN_SEGMENTS 2
+//! number of node references of a way
+#define GEN_WAY_ND 5
+
+
+static uint64_t seed_ = 1;
+
+static const char *colour_[] = {"white", "red", "green", "yellow", "blue", "orange", "violet"};
+static const char *style_[] = {"solid", "dashed", "suppress"};
+static const char *key_[] = {"name", "amenity", "highway", "natural", "place", "source", "note", "created_by"};
+
+
+/*! Pseudo random number generator (xorshift64*). It is used instead of
+ *  random(3) to guarantee the same sequence on all systems.
+ */
+static uint64_t rnd(void)
+{
+   seed_ ^= seed_ >> 12;
+   seed_ ^= seed_ << 25;
+   seed_ ^= seed_ >> 27;
+   return seed_ * 2685821657736338717ULL;
+}
+
+
+//! return random number 0 <= x < n
+static int rnd_int(int n)
+{
+   return rnd() % n;
+}
+
+
+//! return random number 0 <= x < 1
+static double rnd_dbl(void)
+{
+   return (rnd() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+
+/*! Write the tags of a sectored light with nsec sectors. Each sector has nseg
+ * radius segments.
+ */
+static void gen_light(int nsec, int nseg)
+{
+   double a, w;
+   int i, j;
+
+   printf("      <tag k='seamark:type' v='light_minor'/>\n"
+         "      <tag k='seamark:light:character' v='Fl'/>\n"
+         "      <tag k='seamark:light:period' v='%d'/>\n", 2 + rnd_int(10));
+
+   // sectors are placed clockwise with random widths
+   a = rnd_dbl() * 360;
+   w = 360.0 / (nsec > 0 ? nsec : 1);
+   for (i = 1; i <= nsec; i++)
+   {
+      printf("      <tag k='seamark:light:%d:sector_start' v='%.1f'/>\n", i, a);
+      a += w * (0.2 + rnd_dbl() * 0.8);
+      if (a >= 360)
+         a -= 360;
+      printf("      <tag k='seamark:light:%d:sector_end' v='%.1f'/>\n"
+            "      <tag k='seamark:light:%d:colour' v='%s'/>\n",
+            i, a, i, colour_[rnd_int(sizeof(colour_) / sizeof(*colour_))]);
+
+      if (nseg > 0)
+      {
+         printf("      <tag k='seamark:light:%d:radius' v='", i);
+         for (j = 0; j < nseg; j++)
+            printf("%s%.1f:%d:%s", j ? ";" : "", 0.5 + rnd_dbl() * 2, 5 + rnd_int(20),
+                  style_[rnd_int(sizeof(style_) / sizeof(*style_))]);
+         printf("'/>\n");
+      }
+   }
+}
+
+
+void usage(const char *s)
+{
+   printf("Synthetic OSM data generator for smfilter.\n"
+         "usage: %s [OPTIONS]\n"
+         "   -c <n> ....... Number of sectors per light (default = %d).\n"
+         "   -d <f> ....... Fraction of tagged nodes (default = %.2f).\n"
+         "   -n <n> ....... Number of nodes (default = %d).\n"
+         "   -r <n> ....... Number of radius segments per sector (default = %d).\n"
+         "   -s <f> ....... Fraction of seamark lights (default = %.3f).\n"
+         "   -S <n> ....... Seed of the random number generator (default = %d).\n"
+         "   -t <n> ....... Number of tags per tagged node (default = %d).\n"
+         "   -w <n> ....... Number of ways (default = nodes / 10).\n",
+         s, GEN_SECTORS, GEN_TAGGED, GEN_NODES, GEN_SEGMENTS, GEN_SEAMARK, 1, GEN_TAGS);
+}
+
+
+int main(int argc, char *argv[])
+{
+   long nodes = GEN_NODES, ways = -1, i;
+   int tags = GEN_TAGS, nsec = GEN_SECTORS, nseg = GEN_SEGMENTS, j, n;
+   double tagged = GEN_TAGGED, seamark = GEN_SEAMARK, r;
+
+   while ((n = getopt(argc, argv, "c:d:hn:r:s:S:t:w:")) != -1)
+      switch (n)
+      {
+         case 'c':
+            nsec = atoi(optarg);
+            break;
+
+         case 'd':
+            tagged = atof(optarg);
+            break;
+
+         case 'h':
+            usage(argv[0]);
+            exit(EXIT_SUCCESS);
+
+         case 'n':
+            nodes = atol(optarg);
+            break;
+
+         case 'r':
+            nseg = atoi(optarg);
+            break;
+
+         case 's':
+            seamark = atof(optarg);
+            break;
+
+         case 'S':
+            // seed must not be 0 otherwise xorshift returns 0 forever
+            if (!(seed_ = strtoull(optarg, NULL, 0)))
+               seed_ = 1;
+            break;
+
+         case 't':
+            tags = atoi(optarg);
+            break;
+
+         case 'w':
+            ways = atol(optarg);
+            break;
+
+         default:
+            usage(argv[0]);
+            exit(EXIT_FAILURE);
+      }
+
+   if (nodes < 1 || tags < 0 || nsec < 0 || nseg < 0)
+   {
+      fprintf(stderr, "*** illegal argument\n");
+      exit(EXIT_FAILURE);
+   }
+
+   if (ways < 0)
+      ways = nodes / 10;
+
+   printf("<?xml version='1.0' encoding='UTF-8'?>\n"
+         "<osm version='0.6' generator='smgen'>\n");
+
+   for (i = 1; i <= nodes; i++)
+   {
+      printf("   <node id='%ld' version='1' timestamp='2011-01-01T00:00:00Z' lat='%.7f' lon='%.7f'",
+            i, rnd_dbl() * 170 - 85, rnd_dbl() * 360 - 180);
+
+      r = rnd_dbl();
+      if (r < seamark)
+      {
+         printf(">\n");
+         gen_light(nsec, nseg);
+         printf("   </node>\n");
+      }
+      else if (r < seamark + tagged && tags > 0)
+      {
+         printf(">\n");
+         for (j = 0; j < tags; j++)
+            printf("      <tag k='%s' v='value %d'/>\n",
+                  key_[rnd_int(sizeof(key_) / sizeof(*key_))], rnd_int(1000));
+         printf("   </node>\n");
+      }
+      else
+         printf("/>\n");
+   }
+
+   for (i = 1; i <= ways; i++)
+   {
+      printf("   <way id='%ld' version='1' timestamp='2011-01-01T00:00:00Z'>\n", i);
+      for (j = 0; j < GEN_WAY_ND; j++)
+         printf("      <nd ref='%ld'/>\n", 1 + (long) (rnd() % nodes));
+      printf("      <tag k='highway' v='track'/>\n"
+            "   </way>\n");
+   }
+
+   printf("</osm>\n");
+
+   return EXIT_SUCCESS;
+}
+
@@ -0,0 +1,174 @@
+/* Copyright 2011 Bernhard R. Fischer, 2048R/5C5FFD47 <bf@abenteuerland.at>
+ *
+ * This file is part of smfilter.
+ *
+ * Smfilter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * Smfilter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with smfilter. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! This file contains the index of the seamark nodes of an input file.
+ *  During a regular run the file offsets of all nodes which were accepted
+ *  by match_node() are collected. On subsequent runs on the same file the
+ *  reader seeks directly to these nodes and skips the rest of the file.
+ *  The index is a text file. The first line contains a magic, the size and
+ *  modification time of the input file, the end of the header (the offset
+ *  following the element in front of the first object), and the offset and
+ *  line number of the trailer ("</osm>"). Every
+ *  following line "<offset> <length> <line>" describes one seamark node.
+ *
+ *  @author Bernhard R. Fischer
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "smindex.h"
+
+
+#define IDX_MAGIC "smindex1"
+
+
+static struct idx_seg *idx_ = NULL;
+static int idx_cnt_ = 0, idx_max_ = 0;
+//! end of header, beginning of trailer and its line number
+static long idx_head_ = 0, idx_tail_ = 0, idx_tline_ = 0, idx_size_ = 0;
+
+
+/*! Add seamark node to index.
+ *  @return 0 on success, -1 on error.
+ */
+int idx_add(long off, long len, long line)
+{
+   struct idx_seg *s;
+
+   if (idx_cnt_ >= idx_max_)
+   {
+      if ((s = realloc(idx_, sizeof(*s) * (idx_max_ ? idx_max_ * 2 : 1024))) == NULL)
+         return -1;
+      idx_ = s;
+      idx_max_ = idx_max_ ? idx_max_ * 2 : 1024;
+   }
+
+   idx_[idx_cnt_].off = off;
+   idx_[idx_cnt_].len = len;
+   idx_[idx_cnt_].line = line;
+   idx_cnt_++;
+
+   return 0;
+}
+
+
+/*! Load index file.
+ *  @param st File status of the input file.
+ *  @return 1 if the index was loaded, 0 if it does not exist or if it does
+ *  not belong to the input file (it was modified), -1 on error.
+ */
+int idx_load(const char *name, const struct stat *st)
+{
+   long size, sec, nsec, off, len, line;
+   char magic[16];
+   FILE *f;
+   int n;
+
+   if ((f = fopen(name, "r")) == NULL)
+      return errno == ENOENT ? 0 : -1;
+
+   if (fscanf(f, "%15s %ld %ld %ld %ld %ld %ld", magic, &size, &sec, &nsec, &idx_head_, &idx_tail_, &idx_tline_) != 7
+         || strcmp(magic, IDX_MAGIC) || size != st->st_size
+         || sec != st->st_mtim.tv_sec || nsec != st->st_mtim.tv_nsec)
+   {
+      fclose(f);
+      return 0;
+   }
+
+   while ((n = fscanf(f, "%ld %ld %ld", &off, &len, &line)) == 3)
+      if (off < idx_head_ || off + len > idx_tail_ || idx_add(off, len, line) == -1)
+         break;
+
+   if (n != EOF || ferror(f))
+   {
+      if (!ferror(f))
+         errno = EINVAL;
+      fclose(f);
+      return -1;
+   }
+
+   fclose(f);
+   idx_size_ = size;
+   return 1;
+}
+
+
+/*! Save index. The file is written to a temporary file first which is
+ *  renamed afterwards.
+ *  @param head Offset of first object in the input file.
+ *  @param tail Offset of trailer of the input file.
+ *  @param tline Line number of trailer.
+ *  @return 0 on success, -1 on error.
+ */
+int idx_save(const char *name, const struct stat *st, long head, long tail, long tline)
+{
+   char tmp[strlen(name) + 5];
+   FILE *f;
+   int i;
+
+   snprintf(tmp, sizeof(tmp), "%s.tmp", name);
+   if ((f = fopen(tmp, "w")) == NULL)
+      return -1;
+
+   fprintf(f, "%s %ld %ld %ld %ld %ld %ld\n", IDX_MAGIC, (long) st->st_size,
+         (long) st->st_mtim.tv_sec, (long) st->st_mtim.tv_nsec, head, tail, tline);
+   for (i = 0; i < idx_cnt_; i++)
+      fprintf(f, "%ld %ld %ld\n", idx_[i].off, idx_[i].len, idx_[i].line);
+
+   if (fclose(f) == EOF)
+      return -1;
+
+   return rename(tmp, name);
+}
+
+
+/*! Get n-th segment of input file which has to be read. Segment 0 is the
+ *  header, followed by the seamark nodes and the trailer.
+ *  @return 0 on success, -1 if there are no more segments.
+ */
+int idx_get(int n, struct idx_seg *s)
+{
+   if (n < 0 || n > idx_cnt_ + 1)
+      return -1;
+
+   if (!n)
+   {
+      s->off = 0;
+      s->len = idx_head_;
+      s->line = 1;
+   }
+   else if (n <= idx_cnt_)
+      *s = idx_[n - 1];
+   else
+   {
+      s->off = idx_tail_;
+      s->len = idx_size_ - idx_tail_;
+      s->line = idx_tline_;
+   }
+   return 0;
+}
+
+
+void idx_free(void)
+{
+   free(idx_);
+   idx_ = NULL;
+   idx_cnt_ = idx_max_ = 0;
+}
+
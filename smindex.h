@@ -0,0 +1,40 @@
+/* Copyright 2011 Bernhard R. Fischer, 2048R/5C5FFD47 <bf@abenteuerland.at>
+ *
+ * This file is part of smfilter.
+ *
+ * Smfilter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * Smfilter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with smfilter. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SMINDEX_H
+#define SMINDEX_H
+
+#include <sys/stat.h>
+
+
+//! segment of the input file
+struct idx_seg
+{
+   long off;   //!< file offset
+   long len;   //!< length in bytes
+   long line;  //!< line number at off
+};
+
+
+int idx_load(const char *name, const struct stat *st);
+int idx_add(long off, long len, long line);
+int idx_save(const char *name, const struct stat *st, long head, long tail, long tline);
+int idx_get(int n, struct idx_seg *s);
+void idx_free(void);
+
+#endif
+
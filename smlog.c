@@ -15,37 +15,270 @@
  * along with smfilter. If not, see <http://www.gnu.org/licenses/>.
  */
 
+/*! The log is written line by line. Each line is formatted into a buffer of
+ *  the calling thread and written with a single call, thus lines of several
+ *  threads are not mixed. The log is written as text or as JSON lines if the
+ *  file name ends with '.json'.
+ *
+ *  @author Bernhard R. Fischer
+ */
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdarg.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
 
-#include "libhpxml.h"
+#include "smlog.h"
 
 
-extern int oline_;
 static FILE *flog_ = NULL;
+//! flag set if log is written as JSON lines
+static int json_ = 0;
+//! maximum level of messages which are logged
+static int level_ = LL_INFO;
+//! stream of validation report
+static FILE *frep_ = NULL;
+//! number of messages per error code, protected by mtx_
+static long cnt_[LOG_NCODE];
+static pthread_mutex_t mtx_ = PTHREAD_MUTEX_INITIALIZER;
+//! node, its input file offset and output line which are currently processed
+static __thread int64_t node_ = 0;
+static __thread long off_ = 0, oline_ = 0;
+//! function which converts input file offsets to line numbers
+static long (*lineno_)(void *, long) = NULL;
+static void *lctx_ = NULL;
+//! names of error codes in the report
+static const char *code_[] = {"unknown_color", "sector_out_of_range", "unknown_arc_type",
+   "deprecated_directional", "incomplete_directional", "missing_angles", "missing_angle",
+   "negative_angle", "out_of_memory", "id_out_of_range"};
+//! level of error codes
+static const int code_lvl_[] = {LL_WARN, LL_WARN, LL_WARN, LL_NOTICE, LL_WARN, LL_WARN,
+   LL_WARN, LL_WARN, LL_ERROR, LL_ERROR};
+static const char *lvl_[] = {"error", "warning", "notice", "info", "debug"};
 
 
-void log_set_stream(FILE *f)
+/*! Open log. The name "stderr" logs to stderr. The level is appended to the
+ *  name separated by a colon, either as name (e.g. "warning") or as number.
+ *  @return 0 on success, -1 on error.
+ */
+int log_open(const char *name)
 {
-   flog_ = f;
+   char *s, *p;
+   int i, n;
+
+   if ((s = strdup(name)) == NULL)
+      return -1;
+
+   if ((p = strrchr(s, ':')) != NULL)
+   {
+      *p++ = '\0';
+      for (i = 0; i <= LL_DEBUG && strcmp(p, lvl_[i]); i++);
+      if (i > LL_DEBUG && (sscanf(p, "%d%n", &i, &n) != 1 || p[n] || i < LL_ERROR || i > LL_DEBUG))
+      {
+         fprintf(stderr, "*** unknown log level '%s'\n", p);
+         free(s);
+         return -1;
+      }
+      level_ = i;
+   }
+
+   n = strlen(s);
+   json_ = n > 5 && !strcmp(s + n - 5, ".json");
+
+   if (!strcmp(s, "stderr"))
+      flog_ = stderr;
+   else if ((flog_ = fopen(s, "w")) == NULL)
+   {
+      fprintf(stderr, "*** Cannot open file '%s': %s\n", s, strerror(errno));
+      free(s);
+      return -1;
+   }
+   free(s);
+
+   if (!json_)
+      fprintf(flog_, "\n# Smfilter log file. Numbers in square brackets show line numbers of\n"
+            "# input/output file. The error is always in the node/way before\n"
+            "# the printed line number.\n");
+   return 0;
 }
 
 
-int log_msg(const char *fmt, ...)
+/*! Log the number of suppressed messages and close the log.
+ */
+void log_close(void)
 {
-   int n;
-   va_list ap;
+   int i;
 
    if (flog_ == NULL)
-      return 0;
+      return;
+
+   for (i = 0; i < LOG_NCODE; i++)
+      if (cnt_[i] > LOG_RATE_LIMIT && code_lvl_[i] <= level_)
+         log_msg(LL_NOTICE, "%ld more messages of type %s suppressed", cnt_[i] - LOG_RATE_LIMIT, code_[i]);
+
+   if (flog_ != stderr)
+      fclose(flog_);
+   else
+      fflush(flog_);
+   flog_ = NULL;
+}
+
+
+/*! Set stream of validation report. Each error reported with log_err() is
+ *  written as single line JSON object into the report.
+ */
+void log_set_report(FILE *f)
+{
+   frep_ = f;
+}
+
+
+/*! Return 1 if either the log or the report is written, otherwise 0.
+ */
+int log_enabled(void)
+{
+   return flog_ != NULL || frep_ != NULL;
+}
+
+
+/*! Set function f which returns the line number of an input file offset. It
+ *  is called with the argument p just if a message is written, and in the
+ *  thread which logs.
+ */
+void log_set_lineno(long (*f)(void *, long), void *p)
+{
+   lineno_ = f;
+   lctx_ = p;
+}
+
+
+/*! Set id, input file offset, and output line of the node which is currently
+ *  processed by the calling thread. They are included in the log and the
+ *  report.
+ */
+void log_set_node(int64_t id, long off, long oline)
+{
+   node_ = id;
+   off_ = off;
+   oline_ = oline;
+}
+
+
+//! return input line number of the current node, 0 if unknown
+static long log_line_no(void)
+{
+   return lineno_ != NULL ? lineno_(lctx_, off_) : 0;
+}
+
+
+/*! Append string s as JSON string to buf.
+ *  @return New length of the string in buf.
+ */
+static int log_json_str(char *buf, int len, int size, const char *s)
+{
+   for (; *s && len < size - 8; s++)
+   {
+      if (*s == '"' || *s == '\\')
+         len += snprintf(buf + len, size - len, "\\%c", *s);
+      else if ((unsigned char) *s < 0x20)
+         len += snprintf(buf + len, size - len, "\\u%04x", *s);
+      else
+         buf[len++] = *s;
+   }
+   buf[len] = '\0';
+   return len;
+}
+
+
+/*! Write a line to the log. The line is formatted in buf which is passed by
+ *  the caller.
+ *  @param code Error code or -1 if it is no error of a seamark.
+ */
+static void log_line(char *buf, int size, int lvl, int code, const char *msg)
+{
+   int len;
+
+   if (json_)
+   {
+      len = snprintf(buf, size, "{\"level\":\"%s\",\"line\":%ld,\"oline\":%ld,\"node\":%lld,\"code\":%s%s%s,\"msg\":\"",
+            lvl_[lvl], log_line_no(), oline_, (long long) node_, code < 0 ? "" : "\"",
+            code < 0 ? "null" : code_[code], code < 0 ? "" : "\"");
+      len = log_json_str(buf, len, size - 3, msg);
+      len += snprintf(buf + len, size - len, "\"}\n");
+   }
+   else
+   {
+      len = snprintf(buf, size, "[%ld/%ld] %s: %s\n", log_line_no(), oline_, lvl_[lvl], msg);
+      if (len >= size)
+      {
+         buf[size - 2] = '\n';
+         len = size - 1;
+      }
+   }
+
+   (void) fwrite(buf, 1, len, flog_);
+}
+
+
+void log_msg(int lvl, const char *fmt, ...)
+{
+   static __thread char msg[LOG_LINE_MAX], buf[LOG_LINE_MAX];
+   va_list ap;
+
+   if (flog_ == NULL || lvl > level_)
+      return;
 
-   fprintf(flog_, "[%ld/%d] ", hpx_lineno(), oline_);
    va_start(ap, fmt);
-   n = vfprintf(flog_, fmt, ap);
+   vsnprintf(msg, sizeof(msg), fmt, ap);
    va_end(ap);
-   fprintf(flog_, "\n");
 
-   return n;
+   log_line(buf, sizeof(buf), lvl, -1, msg);
 }
 
 
+/*! Log error of seamark definition. The message is written to the log and to
+ *  the validation report. Just the first LOG_RATE_LIMIT messages of each code
+ *  are logged, the report is always complete.
+ *  @param code Error code (LOG_COLOR...).
+ *  @param sec Number of sector, -1 if the error does not refer to a sector.
+ */
+void log_err(int code, int sec, const char *fmt, ...)
+{
+   static __thread char msg[LOG_LINE_MAX], buf[LOG_LINE_MAX];
+   va_list ap;
+   long n;
+   int len;
+
+   if ((flog_ == NULL || code_lvl_[code] > level_) && frep_ == NULL)
+      return;
+
+   pthread_mutex_lock(&mtx_);
+   n = ++cnt_[code];
+   pthread_mutex_unlock(&mtx_);
+
+   if (n > LOG_RATE_LIMIT && frep_ == NULL)
+      return;
+
+   va_start(ap, fmt);
+   vsnprintf(msg, sizeof(msg), fmt, ap);
+   va_end(ap);
+
+   if (flog_ != NULL && code_lvl_[code] <= level_ && n <= LOG_RATE_LIMIT)
+      log_line(buf, sizeof(buf), code_lvl_[code], code, msg);
+
+   if (frep_ == NULL)
+      return;
+
+   len = snprintf(buf, sizeof(buf), "{\"node\":%lld,\"line\":%ld,\"sector\":", (long long) node_, log_line_no());
+   if (sec < 0)
+      len += snprintf(buf + len, sizeof(buf) - len, "null");
+   else
+      len += snprintf(buf + len, sizeof(buf) - len, "%d", sec);
+   len += snprintf(buf + len, sizeof(buf) - len, ",\"code\":\"%s\",\"msg\":\"", code_[code]);
+   len = log_json_str(buf, len, sizeof(buf) - 3, msg);
+   len += snprintf(buf + len, sizeof(buf) - len, "\"}\n");
+   (void) fwrite(buf, 1, len, frep_);
+}
+
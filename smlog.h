@@ -18,9 +18,31 @@
 #ifndef SMLOG_H
 #define SMLOG_H
 
+#include <stdio.h>
+#include <stdint.h>
 
-void log_set_stream(FILE *);
-int log_msg(const char *, ...);
+
+//! error codes of log_err()
+enum {LOG_COLOR, LOG_SECNR, LOG_ARC_TYPE, LOG_DEPRECATED, LOG_DIR_INCOMPLETE, LOG_NO_ANGLES,
+   LOG_ONE_ANGLE, LOG_NEG_ANGLE, LOG_NOMEM, LOG_ID_RANGE, LOG_NCODE};
+
+//! log levels
+enum {LL_ERROR, LL_WARN, LL_NOTICE, LL_INFO, LL_DEBUG};
+
+//! maximum number of messages logged per error code, others are just counted
+#define LOG_RATE_LIMIT 100
+//! maximum length of a log line
+#define LOG_LINE_MAX 1024
+
+
+int log_open(const char *);
+void log_close(void);
+void log_set_report(FILE *);
+int log_enabled(void);
+void log_set_lineno(long (*)(void *, long), void *);
+void log_set_node(int64_t, long, long);
+void log_msg(int, const char *, ...);
+void log_err(int, int, const char *, ...);
 
 
 #endif
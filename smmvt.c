@@ -0,0 +1,676 @@
+/* Copyright 2011 Bernhard R. Fischer, 2048R/5C5FFD47 <bf@abenteuerland.at>
+ *
+ * This file is part of smfilter.
+ *
+ * Smfilter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * Smfilter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with smfilter. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! This file contains the Mapbox Vector Tile (MVT) encoder. The features
+ *  (arcs, radials, and light characters) are collected in memory with
+ *  their coordinates projected to Web Mercator. When the output is closed,
+ *  the features of every tile of each zoom level are encoded into one
+ *  layer MVT_LAYER. The tiles are written to <dir>/<z>/<x>/<y>.mvt in
+ *  parallel by the threads of a job queue.
+ *
+ *  Features are assigned to all tiles which intersect their bounding box
+ *  (including the tile buffer). The coordinates are not clipped, this is
+ *  left to the renderer.
+ *
+ *  @author Bernhard R. Fischer
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <sys/stat.h>
+
+#include "smmvt.h"
+#include "osm_evbuf.h"
+#include "jobq.h"
+
+
+//! geometry types of MVT
+enum {MVT_POINT = 1, MVT_LINESTRING = 2};
+
+
+/*! Growable buffer for protobuf encoding. Allocation errors are sticky.
+ */
+struct mbuf
+{
+   uint8_t *buf;
+   size_t len, max;
+   int err;
+};
+
+struct mvt_feat
+{
+   //! index of first vertex and number of vertices
+   long vtx;
+   int nvtx;
+   //! index of first property and number of properties
+   long prop;
+   int nprop;
+   //! bounding box in Mercator coordinates (min x, min y, max x, max y)
+   double bb[4];
+};
+
+//! property, the strings are stored in the string arena
+struct mvt_prop
+{
+   long key, val;
+   int klen, vlen;
+};
+
+//! tile of a zoom level and the features within it
+struct mvt_tile
+{
+   uint64_t key;
+   long feat;
+};
+
+//! job of writer threads
+struct mvt_job
+{
+   mvt_ctrl_t *m;
+   int z, x, y;
+   //! features of tile
+   const struct mvt_tile *ft;
+   long nft;
+   int err;
+};
+
+struct mvt_ctrl
+{
+   const char *dir;
+   int zmin, zmax, nthreads;
+   //! vertices (pairs of Mercator x/y within [0, 1])
+   double *vtx;
+   long nvtx, mvtx;
+   struct mvt_feat *feat;
+   long nfeat, mfeat;
+   struct mvt_prop *prop;
+   long nprop, mprop;
+   char *str;
+   long nstr, mstr;
+   int err;
+};
+
+
+static void mb_reserve(struct mbuf *b, size_t n)
+{
+   uint8_t *p;
+   size_t m;
+
+   if (b->len + n <= b->max)
+      return;
+
+   for (m = b->max ? b->max : 4096; m < b->len + n; m <<= 1);
+   if ((p = realloc(b->buf, m)) == NULL)
+   {
+      b->err = 1;
+      return;
+   }
+   b->buf = p;
+   b->max = m;
+}
+
+
+static void mb_varint(struct mbuf *b, uint64_t v)
+{
+   mb_reserve(b, 10);
+   if (b->err)
+      return;
+   for (; v >= 0x80; v >>= 7)
+      b->buf[b->len++] = (v & 0x7f) | 0x80;
+   b->buf[b->len++] = v;
+}
+
+
+static uint32_t mb_zz(int32_t v)
+{
+   return ((uint32_t) v << 1) ^ (uint32_t) (v >> 31);
+}
+
+
+static void mb_uint(struct mbuf *b, int fn, uint64_t v)
+{
+   mb_varint(b, fn << 3);
+   mb_varint(b, v);
+}
+
+
+static void mb_bytes(struct mbuf *b, int fn, const void *d, size_t len)
+{
+   mb_varint(b, fn << 3 | 2);
+   mb_varint(b, len);
+   mb_reserve(b, len);
+   if (b->err)
+      return;
+   memcpy(b->buf + b->len, d, len);
+   b->len += len;
+}
+
+
+/*! Append contents of buffer s as length delimited field to b and clear s.
+ */
+static void mb_msg(struct mbuf *b, int fn, struct mbuf *s)
+{
+   if (s->err)
+      b->err = 1;
+   mb_bytes(b, fn, s->buf, s->len);
+   s->len = 0;
+}
+
+
+/*! Append raw contents of buffer s to b and clear s.
+ */
+static void mb_append(struct mbuf *b, struct mbuf *s)
+{
+   if (s->err)
+      b->err = 1;
+   mb_reserve(b, s->len);
+   if (b->err)
+      return;
+   memcpy(b->buf + b->len, s->buf, s->len);
+   b->len += s->len;
+   s->len = 0;
+}
+
+
+/*! Grow array p of n elements of size sz if it is full.
+ *  @return 0 on success, -1 on error.
+ */
+static int mvt_grow(void **p, long n, long *max, size_t sz)
+{
+   void *q;
+   long m;
+
+   if (n < *max)
+      return 0;
+   m = *max ? *max * 2 : 1024;
+   if ((q = realloc(*p, m * sz)) == NULL)
+      return -1;
+   *p = q;
+   *max = m;
+   return 0;
+}
+
+
+/*! Store string in arena. XML entities are resolved.
+ *  @return Offset of string or -1 on error.
+ */
+static long mvt_str(mvt_ctrl_t *m, bstring_t s, int *len)
+{
+   long off;
+
+   while (m->nstr + s.len > m->mstr)
+      if (mvt_grow((void**) &m->str, m->mstr, &m->mstr, 1) == -1)
+         return -1;
+
+   off = m->nstr;
+   *len = ev_unescape(m->str + off, s.buf, s.len);
+   m->nstr += *len;
+   return off;
+}
+
+
+mvt_ctrl_t *mvt_open(const char *dir, int zmin, int zmax, int nthreads)
+{
+   mvt_ctrl_t *m;
+
+   if (zmin < 0 || zmax > MVT_MAX_ZOOM || zmin > zmax)
+   {
+      errno = EINVAL;
+      return NULL;
+   }
+
+   if (mkdir(dir, 0777) == -1 && errno != EEXIST)
+      return NULL;
+
+   if ((m = calloc(1, sizeof(*m))) == NULL)
+      return NULL;
+
+   m->dir = dir;
+   m->zmin = zmin;
+   m->zmax = zmax;
+   m->nthreads = nthreads;
+   return m;
+}
+
+
+/*! Add feature.
+ *  @param vtx Vertices (pairs of lon/lat). A single vertex makes a point,
+ *  otherwise it is a line string.
+ *  @param t Element whose attributes are the properties of the feature.
+ *  @return 0 on success, -1 on error.
+ */
+int mvt_put_feature(mvt_ctrl_t *m, const double *vtx, int nvtx, const hpx_tag_t *t)
+{
+   struct mvt_feat *f;
+   struct mvt_prop *p;
+   double x, y, lat;
+   int i;
+
+   if (!nvtx)
+      return 0;
+
+   if (mvt_grow((void**) &m->feat, m->nfeat, &m->mfeat, sizeof(*m->feat)) == -1)
+      goto fail;
+
+   f = &m->feat[m->nfeat];
+   f->vtx = m->nvtx;
+   f->nvtx = nvtx;
+   f->prop = m->nprop;
+   f->nprop = t->nattr;
+
+   for (i = 0; i < nvtx; i++)
+   {
+      if (mvt_grow((void**) &m->vtx, m->nvtx * 2 + 1, &m->mvtx, sizeof(*m->vtx)) == -1)
+         goto fail;
+
+      lat = fmax(fmin(vtx[i * 2 + 1], 85.0511), -85.0511) * M_PI / 180.0;
+      x = (vtx[i * 2] + 180.0) / 360.0;
+      y = (1.0 - asinh(tan(lat)) / M_PI) / 2.0;
+      m->vtx[m->nvtx * 2] = x;
+      m->vtx[m->nvtx * 2 + 1] = y;
+      m->nvtx++;
+
+      if (!i)
+      {
+         f->bb[0] = f->bb[2] = x;
+         f->bb[1] = f->bb[3] = y;
+      }
+      f->bb[0] = fmin(f->bb[0], x);
+      f->bb[1] = fmin(f->bb[1], y);
+      f->bb[2] = fmax(f->bb[2], x);
+      f->bb[3] = fmax(f->bb[3], y);
+   }
+
+   for (i = 0; i < t->nattr; i++)
+   {
+      if (mvt_grow((void**) &m->prop, m->nprop, &m->mprop, sizeof(*m->prop)) == -1)
+         goto fail;
+      p = &m->prop[m->nprop];
+      if ((p->key = mvt_str(m, t->attr[i].name, &p->klen)) == -1
+            || (p->val = mvt_str(m, t->attr[i].value, &p->vlen)) == -1)
+         goto fail;
+      m->nprop++;
+   }
+
+   m->nfeat++;
+   return 0;
+
+fail:
+   m->err = 1;
+   return -1;
+}
+
+
+struct mvt_hent
+{
+   const char *s;
+   int len, idx;
+};
+
+/*! Hash table of the keys or values of a tile. It maps strings to their
+ *  index in the layer.
+ */
+struct mvt_hash
+{
+   struct mvt_hent *e;
+   int size, cnt;
+};
+
+
+static unsigned long mvt_hash(const char *s, int len)
+{
+   unsigned long k = 5381;
+
+   while (len--)
+      k = k * 33 + (unsigned char) *s++;
+   return k;
+}
+
+
+static struct mvt_hent *mvt_find(const struct mvt_hash *h, const char *s, int len)
+{
+   unsigned long k;
+
+   for (k = mvt_hash(s, len) & (h->size - 1); h->e[k].s != NULL; k = (k + 1) & (h->size - 1))
+      if (h->e[k].len == len && !memcmp(h->e[k].s, s, len))
+         break;
+   return &h->e[k];
+}
+
+
+static int mvt_hgrow(struct mvt_hash *h)
+{
+   struct mvt_hash n;
+   int i;
+
+   n.size = h->size ? h->size * 2 : 256;
+   n.cnt = h->cnt;
+   if ((n.e = calloc(n.size, sizeof(*n.e))) == NULL)
+      return -1;
+   for (i = 0; i < h->size; i++)
+      if (h->e[i].s != NULL)
+         *mvt_find(&n, h->e[i].s, h->e[i].len) = h->e[i];
+   free(h->e);
+   *h = n;
+   return 0;
+}
+
+
+/*! Get index of string s, it is added to the table and encoded as field of
+ *  the layer into b if it does not exist yet.
+ *  @param fn Field number of the layer (3 = keys, 4 = values).
+ *  @param tmp Buffer for encoding the Value message (values only).
+ *  @return Index or -1 on error.
+ */
+static int mvt_index(struct mvt_hash *h, struct mbuf *b, struct mbuf *tmp, int fn, const char *s, int len)
+{
+   struct mvt_hent *e;
+
+   if (h->cnt * 2 >= h->size && mvt_hgrow(h) == -1)
+      return -1;
+
+   if ((e = mvt_find(h, s, len))->s != NULL)
+      return e->idx;
+
+   e->s = s;
+   e->len = len;
+   e->idx = h->cnt;
+
+   if (fn == 3)
+      mb_bytes(b, fn, s, len);
+   else
+   {
+      // values are Value messages with the string in field 1
+      mb_bytes(tmp, 1, s, len);
+      mb_msg(b, fn, tmp);
+   }
+   return h->cnt++;
+}
+
+
+/*! Encode geometry of feature f into g. The coordinates are quantized
+ *  into pt first because consecutive identical points have to be removed.
+ *  @param n Number of tiles per row at the zoom level.
+ *  @return Number of vertices, 0 if the geometry degenerated, or -1 on
+ *  error.
+ */
+static int mvt_geom(const mvt_ctrl_t *m, const struct mvt_feat *f, double n, int x, int y, struct mbuf *g, int32_t **pt, int *mpt)
+{
+   int32_t *p, px, py;
+   int i, cnt;
+
+   if (f->nvtx > *mpt)
+   {
+      if ((p = realloc(*pt, sizeof(*p) * 2 * f->nvtx)) == NULL)
+         return -1;
+      *pt = p;
+      *mpt = f->nvtx;
+   }
+
+   for (i = 0, cnt = 0, p = *pt; i < f->nvtx; i++)
+   {
+      px = lround((m->vtx[(f->vtx + i) * 2] * n - x) * MVT_EXTENT);
+      py = lround((m->vtx[(f->vtx + i) * 2 + 1] * n - y) * MVT_EXTENT);
+
+      // zero-length segments are not allowed
+      if (cnt && px == p[cnt * 2 - 2] && py == p[cnt * 2 - 1])
+         continue;
+      p[cnt * 2] = px;
+      p[cnt * 2 + 1] = py;
+      cnt++;
+   }
+
+   if (f->nvtx > 1 && cnt < 2)
+      return 0;
+
+   // MoveTo(1), LineTo(cnt - 1)
+   mb_varint(g, 1 | 1 << 3);
+   mb_varint(g, mb_zz(p[0]));
+   mb_varint(g, mb_zz(p[1]));
+   if (cnt > 1)
+      mb_varint(g, 2 | (cnt - 1) << 3);
+   for (i = 1; i < cnt; i++)
+   {
+      mb_varint(g, mb_zz(p[i * 2] - p[i * 2 - 2]));
+      mb_varint(g, mb_zz(p[i * 2 + 1] - p[i * 2 - 1]));
+   }
+
+   return cnt;
+}
+
+
+/*! Encode and write tile. This is called by the threads of the job queue.
+ */
+static void mvt_write(void *p)
+{
+   struct mvt_job *j = p;
+   const mvt_ctrl_t *m = j->m;
+   struct mbuf tile = {NULL, 0, 0, 0}, layer = {NULL, 0, 0, 0}, feat = {NULL, 0, 0, 0},
+               tmp = {NULL, 0, 0, 0}, geom = {NULL, 0, 0, 0}, kbuf = {NULL, 0, 0, 0},
+               vbuf = {NULL, 0, 0, 0}, val = {NULL, 0, 0, 0};
+   struct mvt_hash keys = {NULL, 0, 0}, vals = {NULL, 0, 0};
+   const struct mvt_feat *f;
+   const struct mvt_prop *pr;
+   char name[strlen(m->dir) + 40];
+   int32_t *pt = NULL;
+   int i, k, v, cnt, mpt = 0;
+   long l;
+   FILE *fp;
+
+   j->err = 0;
+   mb_uint(&layer, 15, 2);
+   mb_bytes(&layer, 1, MVT_LAYER, strlen(MVT_LAYER));
+   mb_uint(&layer, 5, MVT_EXTENT);
+
+   for (l = 0; l < j->nft; l++)
+   {
+      f = &m->feat[j->ft[l].feat];
+      if ((cnt = mvt_geom(m, f, 1 << j->z, j->x, j->y, &geom, &pt, &mpt)) == -1)
+      {
+         j->err = errno;
+         goto out;
+      }
+      if (!cnt)
+         continue;
+
+      for (i = 0; i < f->nprop; i++)
+      {
+         pr = &m->prop[f->prop + i];
+         if ((k = mvt_index(&keys, &kbuf, NULL, 3, m->str + pr->key, pr->klen)) == -1
+               || (v = mvt_index(&vals, &vbuf, &val, 4, m->str + pr->val, pr->vlen)) == -1)
+         {
+            j->err = ENOMEM;
+            goto out;
+         }
+         mb_varint(&tmp, k);
+         mb_varint(&tmp, v);
+      }
+      mb_msg(&feat, 2, &tmp);
+      mb_uint(&feat, 3, f->nvtx == 1 ? MVT_POINT : MVT_LINESTRING);
+      mb_msg(&feat, 4, &geom);
+      mb_msg(&layer, 2, &feat);
+   }
+   // keys and values follow the features
+   mb_append(&layer, &kbuf);
+   mb_append(&layer, &vbuf);
+   mb_msg(&tile, 3, &layer);
+
+   if (tile.err)
+   {
+      j->err = ENOMEM;
+      goto out;
+   }
+
+   snprintf(name, sizeof(name), "%s/%d", m->dir, j->z);
+   if (mkdir(name, 0777) == -1 && errno != EEXIST)
+      goto fail;
+   snprintf(name, sizeof(name), "%s/%d/%d", m->dir, j->z, j->x);
+   if (mkdir(name, 0777) == -1 && errno != EEXIST)
+      goto fail;
+   snprintf(name, sizeof(name), "%s/%d/%d/%d.mvt", m->dir, j->z, j->x, j->y);
+   if ((fp = fopen(name, "w")) == NULL)
+      goto fail;
+   if (fwrite(tile.buf, tile.len, 1, fp) != 1)
+   {
+      j->err = errno;
+      fclose(fp);
+      goto out;
+   }
+   if (fclose(fp) == EOF)
+      goto fail;
+   goto out;
+
+fail:
+   j->err = errno;
+
+out:
+   free(pt);
+   free(keys.e);
+   free(vals.e);
+   free(tile.buf);
+   free(layer.buf);
+   free(feat.buf);
+   free(tmp.buf);
+   free(geom.buf);
+   free(kbuf.buf);
+   free(vbuf.buf);
+   free(val.buf);
+}
+
+
+static int mvt_cmp(const void *a, const void *b)
+{
+   const struct mvt_tile *x = a, *y = b;
+
+   if (x->key != y->key)
+      return x->key < y->key ? -1 : 1;
+   return x->feat < y->feat ? -1 : x->feat > y->feat;
+}
+
+
+/*! Collect the features of all tiles of zoom level z.
+ *  @param t Pointer to array which receives the pairs of tile and feature
+ *  sorted by tile.
+ *  @return Number of pairs or -1 on error.
+ */
+static long mvt_zoom(const mvt_ctrl_t *m, int z, struct mvt_tile **t, long *mt)
+{
+   double n = 1 << z, b = (double) MVT_BUFFER / MVT_EXTENT;
+   int x, y, x0, x1, y0, y1;
+   const struct mvt_feat *f;
+   long i, cnt = 0;
+
+   for (i = 0; i < m->nfeat; i++)
+   {
+      f = &m->feat[i];
+      x0 = fmax(floor(f->bb[0] * n - b), 0);
+      y0 = fmax(floor(f->bb[1] * n - b), 0);
+      x1 = fmin(floor(f->bb[2] * n + b), n - 1);
+      y1 = fmin(floor(f->bb[3] * n + b), n - 1);
+
+      for (x = x0; x <= x1; x++)
+         for (y = y0; y <= y1; y++)
+         {
+            if (mvt_grow((void**) t, cnt, mt, sizeof(**t)) == -1)
+               return -1;
+            (*t)[cnt].key = (uint64_t) x << 32 | y;
+            (*t)[cnt].feat = i;
+            cnt++;
+         }
+   }
+
+   qsort(*t, cnt, sizeof(**t), mvt_cmp);
+   return cnt;
+}
+
+
+/*! Write all tiles and free the encoder.
+ *  @return 0 on success, -1 on error.
+ */
+int mvt_close(mvt_ctrl_t *m)
+{
+   struct mvt_tile *t = NULL;
+   struct mvt_job *jobs = NULL, *j, *d;
+   long i, k, n, cnt, nj = 0, mt = 0;
+   jobq_t *jq = NULL;
+   int z, err = m->err ? ENOMEM : 0;
+
+   if (!err && (jq = jq_init(m->nthreads, mvt_write)) == NULL)
+      err = errno;
+
+   for (z = m->zmin; !err && z <= m->zmax; z++)
+   {
+      if ((cnt = mvt_zoom(m, z, &t, &mt)) == -1)
+      {
+         err = errno;
+         break;
+      }
+
+      // one job per tile, the jobs refer to the pairs of this zoom level
+      for (i = 0, n = 0; i < cnt; i = k, n++)
+         for (k = i + 1; k < cnt && t[k].key == t[i].key; k++);
+      free(jobs);
+      if ((jobs = calloc(n ? n : 1, sizeof(*jobs))) == NULL)
+      {
+         err = errno;
+         break;
+      }
+
+      for (i = 0, nj = 0; i < cnt; i = k, nj++)
+      {
+         for (k = i + 1; k < cnt && t[k].key == t[i].key; k++);
+         j = &jobs[nj];
+         j->m = m;
+         j->z = z;
+         j->x = t[i].key >> 32;
+         j->y = t[i].key & 0xffffffff;
+         j->ft = &t[i];
+         j->nft = k - i;
+
+         // wait for a finished tile if the queue is full
+         while (jq_submit(jq, j) == -1)
+            if ((d = jq_next(jq))->err && !err)
+               err = d->err;
+      }
+
+      // all jobs of this level have to be finished before t is reused
+      while ((j = jq_next(jq)) != NULL)
+         if (j->err && !err)
+            err = j->err;
+   }
+
+   if (jq != NULL)
+      jq_free(jq);
+   free(jobs);
+   free(t);
+   free(m->vtx);
+   free(m->feat);
+   free(m->prop);
+   free(m->str);
+   free(m);
+
+   if (err)
+   {
+      errno = err;
+      return -1;
+   }
+   return 0;
+}
+
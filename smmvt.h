@@ -0,0 +1,42 @@
+/* Copyright 2011 Bernhard R. Fischer, 2048R/5C5FFD47 <bf@abenteuerland.at>
+ *
+ * This file is part of smfilter.
+ *
+ * Smfilter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * Smfilter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with smfilter. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SMMVT_H
+#define SMMVT_H
+
+#include "libhpxml.h"
+
+
+//! default zoom range of vector tiles
+#define MVT_ZMIN 6
+#define MVT_ZMAX 14
+#define MVT_MAX_ZOOM 20
+//! extent and buffer of tiles
+#define MVT_EXTENT 4096
+#define MVT_BUFFER 64
+//! name of layer
+#define MVT_LAYER "light_sectors"
+
+typedef struct mvt_ctrl mvt_ctrl_t;
+
+
+mvt_ctrl_t *mvt_open(const char *dir, int zmin, int zmax, int nthreads);
+int mvt_put_feature(mvt_ctrl_t *m, const double *vtx, int nvtx, const hpx_tag_t *t);
+int mvt_close(mvt_ctrl_t *m);
+
+#endif
+
@@ -0,0 +1,575 @@
+/* Copyright 2011 Bernhard R. Fischer, 2048R/5C5FFD47 <bf@abenteuerland.at>
+ *
+ * This file is part of smfilter.
+ *
+ * Smfilter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * Smfilter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with smfilter. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! This file contains the output layer of smfilter. All elements, those
+ *  which are passed through from the input and those which are generated,
+ *  are written with out_tag(). Depending on the output format they are
+ *  printed as XML or handed over to the writer of the binary format.
+ *  Generated elements are assembled with out_elem(), out_attr() and
+ *  out_end(), except for plain XML output to which they are printed
+ *  directly with out_printf().
+ *  The GeoJSON and vector tile formats contain just the generated geometry
+ *  which is written as features with out_vertex() and out_feature().
+ *
+ *  @author Bernhard R. Fischer
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <limits.h>
+
+#include "smout.h"
+#include "osm_pbf.h"
+#include "osm_o5m.h"
+#include "osm_evbuf.h"
+#include "smmvt.h"
+#include "smstat.h"
+
+
+/*! Parse name of file format.
+ *  @return Format (FMT_OSM...) or -1 if it is unknown.
+ */
+int parse_fmt(const char *s)
+{
+   if (!strcmp(s, "osm") || !strcmp(s, "xml"))
+      return FMT_OSM;
+   if (!strcmp(s, "pbf"))
+      return FMT_PBF;
+   if (!strcmp(s, "o5m"))
+      return FMT_O5M;
+   if (!strcmp(s, "geojson"))
+      return FMT_GEOJSON;
+   if (!strcmp(s, "geojsonl") || !strcmp(s, "geojsonseq"))
+      return FMT_GEOJSONL;
+   return -1;
+}
+
+
+/*! Open output.
+ *  @param f Output stream.
+ *  @param fmt Output format (FMT_OSM, FMT_PBF, FMT_O5M, FMT_GEOJSON,
+ *  FMT_GEOJSONL).
+ *  @param nthreads Number of threads used for encoding (binary formats).
+ *  @return Pointer to smout_t structure or NULL in case of error with errno
+ *  set.
+ */
+smout_t *out_open(FILE *f, int fmt, int nthreads)
+{
+   smout_t *o;
+
+   if ((o = calloc(1, sizeof(*o))) == NULL)
+      return NULL;
+
+   o->f = f;
+   o->fmt = fmt;
+
+   if ((o->tag = hpx_tm_create(OUT_MATTR)) == NULL)
+   {
+      free(o);
+      return NULL;
+   }
+
+   if (fmt == FMT_PBF)
+      o->wr = pbf_wopen(f, nthreads);
+   else if (fmt == FMT_O5M)
+      o->wr = o5m_wopen(f);
+
+   else if (fmt == FMT_GEOJSON)
+      fprintf(f, "{\"type\":\"FeatureCollection\",\"features\":[\n");
+
+   if ((fmt == FMT_PBF || fmt == FMT_O5M) && o->wr == NULL)
+   {
+      hpx_tm_free(o->tag);
+      free(o);
+      return NULL;
+   }
+
+   return o;
+}
+
+
+/*! Open vector tile output. The tiles are written to the directory dir
+ *  when the output is closed.
+ *  @param f Output stream, just flushed on close.
+ *  @param zmin Lowest zoom level.
+ *  @param zmax Highest zoom level.
+ *  @param nthreads Number of threads used for encoding the tiles.
+ *  @return Pointer to smout_t structure or NULL in case of error.
+ */
+smout_t *out_open_mvt(FILE *f, const char *dir, int zmin, int zmax, int nthreads)
+{
+   smout_t *o;
+
+   if ((o = out_open(f, FMT_MVT, nthreads)) == NULL)
+      return NULL;
+
+   if ((o->wr = mvt_open(dir, zmin, zmax, nthreads)) == NULL)
+   {
+      hpx_tm_free(o->tag);
+      free(o);
+      return NULL;
+   }
+
+   return o;
+}
+
+
+/*! Flush all data and free the output structure. The output stream itself
+ *  is not closed.
+ *  @return 0 on success, -1 if any error occured during output.
+ */
+int out_close(smout_t *o)
+{
+   int e = o->err ? -1 : 0;
+   int i;
+
+   if (o->fmt == FMT_PBF && pbf_wclose(o->wr) == -1)
+      e = -1;
+   if (o->fmt == FMT_O5M && o5m_wclose(o->wr) == -1)
+      e = -1;
+   if (o->fmt == FMT_MVT && mvt_close(o->wr) == -1)
+      e = -1;
+   if (o->fmt == FMT_GEOJSON && fprintf(o->f, "%s]}\n", o->nfeat ? "\n" : "") < 0)
+      e = -1;
+   if (fflush(o->f) == EOF)
+      e = -1;
+
+   for (i = 0; o->route != NULL && i < OSC_NACT; i++)
+   {
+      if (o->act[i] != NULL)
+         fclose(o->act[i]);
+      free(o->abuf[i]);
+   }
+
+   hpx_tm_free(o->tag);
+   free(o->buf);
+   free(o->vtx);
+   free(o->jbuf);
+   free(o);
+
+   return e;
+}
+
+
+static int out_tag0(smout_t *o, const hpx_tag_t *t)
+{
+   if (o->route != NULL)
+   {
+      if ((t->type == HPX_OPEN || t->type == HPX_SINGLE) && (!bs_cmp(t->tag, "node")
+               || !bs_cmp(t->tag, "way") || !bs_cmp(t->tag, "relation")))
+         o->cur = o->route(t);
+      return hpx_fprintf_tag(o->act[o->cur], t) < 0 ? -1 : 0;
+   }
+
+   switch (o->fmt)
+   {
+      case FMT_PBF:
+         if (pbf_put_tag(o->wr, t) == -1)
+         {
+            o->err = 1;
+            return -1;
+         }
+         return 0;
+
+      case FMT_O5M:
+         if (o5m_put_tag(o->wr, t) == -1)
+         {
+            o->err = 1;
+            return -1;
+         }
+         return 0;
+
+      case FMT_GEOJSON:
+      case FMT_GEOJSONL:
+      case FMT_MVT:
+         // elements cannot be represented as features
+         return 0;
+
+      default:
+         return hpx_fprintf_tag(o->f, t) < 0 ? -1 : 0;
+   }
+}
+
+
+/*! Write element.
+ *  @return 0 on success, -1 on error.
+ */
+int out_tag(smout_t *o, const hpx_tag_t *t)
+{
+   int p, e;
+
+   p = st_switch(ST_OUT);
+   e = out_tag0(o, t);
+   st_switch(p);
+   return e;
+}
+
+
+/*! Start new element. The attributes are added with out_attr() and the
+ *  element is written with out_end().
+ *  @param type Type of element (HPX_OPEN, HPX_SINGLE, HPX_CLOSE).
+ *  @param name Name of element, e.g. "node".
+ */
+void out_elem(smout_t *o, int type, const char *name)
+{
+   o->tag->type = type;
+   o->tag->tag.buf = (char*) name;
+   o->tag->tag.len = strlen(name);
+   o->tag->nattr = 0;
+   o->tag->line = 0;
+   o->len = 0;
+}
+
+
+/*! Reserve len bytes in the attribute buffer.
+ *  @return Pointer to the free space or NULL on error.
+ */
+static char *out_reserve(smout_t *o, int len)
+{
+   char *b;
+   int n;
+
+   if (o->len + len > o->max)
+   {
+      for (n = o->max ? o->max : 1024; n < o->len + len; n <<= 1);
+      if ((b = realloc(o->buf, n)) == NULL)
+      {
+         o->err = 1;
+         return NULL;
+      }
+      o->buf = b;
+      o->max = n;
+   }
+   return o->buf + o->len;
+}
+
+
+/*! Add attribute to element. Its value of len bytes was stored at the free
+ *  space of the attribute buffer.
+ */
+static void out_add_attr(smout_t *o, const char *name, int len)
+{
+   hpx_attr_t *a;
+
+   a = &o->tag->attr[o->tag->nattr];
+   a->name.buf = (char*) name;
+   a->name.len = strlen(name);
+   a->value.len = len;
+   a->delim = '"';
+   o->off[o->tag->nattr++] = o->len;
+   o->len += len;
+}
+
+
+/*! Add attribute to element. The value is formatted like printf(3).
+ */
+void out_attr(smout_t *o, const char *name, const char *fmt, ...)
+{
+   va_list ap;
+   char *b;
+   int n;
+
+   if (o->tag->nattr >= OUT_MATTR || (b = out_reserve(o, 64)) == NULL)
+      return;
+
+   va_start(ap, fmt);
+   n = vsnprintf(b, o->max - o->len, fmt, ap);
+   va_end(ap);
+
+   if (n >= o->max - o->len)
+   {
+      if ((b = out_reserve(o, n + 1)) == NULL)
+         return;
+      va_start(ap, fmt);
+      vsnprintf(b, n + 1, fmt, ap);
+      va_end(ap);
+   }
+
+   out_add_attr(o, name, n);
+}
+
+
+/*! Add attribute with a bstring value to element.
+ */
+void out_battr(smout_t *o, const char *name, bstring_t v)
+{
+   char *b;
+
+   if (o->tag->nattr >= OUT_MATTR)
+      return;
+   // the attribute buffer is addressed with int
+   if (v.len >= INT_MAX / 2 - o->len)
+   {
+      o->err = 1;
+      return;
+   }
+   if ((b = out_reserve(o, v.len)) == NULL)
+      return;
+
+   memcpy(b, v.buf, v.len);
+   out_add_attr(o, name, v.len);
+}
+
+
+/*! Write element which was assembled with out_elem() and out_attr().
+ *  @return 0 on success, -1 on error.
+ */
+int out_end(smout_t *o)
+{
+   int i;
+
+   if (o->tag->type == HPX_OPEN || o->tag->type == HPX_SINGLE)
+   {
+      if (!bs_cmp(o->tag->tag, "node"))
+         ST_COUNT(SC_GNODE);
+      else if (!bs_cmp(o->tag->tag, "way"))
+         ST_COUNT(SC_GWAY);
+   }
+
+   for (i = 0; i < o->tag->nattr; i++)
+      o->tag->attr[i].value.buf = o->buf + o->off[i];
+
+   return out_tag(o, o->tag);
+}
+
+
+/*! Print XML data formatted like printf(3) directly to the output. This
+ *  is the fast path for generated elements and may be used only if
+ *  OUT_RAW() is true.
+ *  @return 0 on success, -1 on error.
+ */
+int out_printf(smout_t *o, const char *fmt, ...)
+{
+   va_list ap;
+   int p, n;
+
+   p = st_switch(ST_OUT);
+   va_start(ap, fmt);
+   n = vfprintf(o->f, fmt, ap);
+   va_end(ap);
+   st_switch(p);
+
+   if (n < 0)
+   {
+      o->err = 1;
+      return -1;
+   }
+   return 0;
+}
+
+
+/*! Write len bytes of raw XML data. This may be used only if OUT_RAW() is
+ *  true.
+ *  @return 0 on success, -1 on error.
+ */
+int out_write(smout_t *o, const char *buf, long len)
+{
+   if (len > 0 && fwrite(buf, len, 1, o->f) != 1)
+   {
+      o->err = 1;
+      return -1;
+   }
+   return 0;
+}
+
+
+/*! Write raw XML data, e.g. an element copied from the input, followed by a
+ *  newline. This may be used only if OUT_RAW() is true.
+ *  @return 0 on success, -1 on error.
+ */
+int out_raw(smout_t *o, const char *buf, long len)
+{
+   if (out_write(o, buf, len) == -1)
+      return -1;
+   return out_write(o, "\n", 1);
+}
+
+
+/*! Append vertex to the geometry of the feature.
+ */
+void out_vertex(smout_t *o, double lat, double lon)
+{
+   double *v;
+   int n;
+
+   if (o->nvtx >= o->mvtx)
+   {
+      n = o->mvtx ? o->mvtx * 2 : 64;
+      if ((v = realloc(o->vtx, sizeof(*v) * 2 * n)) == NULL)
+      {
+         o->err = 1;
+         return;
+      }
+      o->vtx = v;
+      o->mvtx = n;
+   }
+
+   o->vtx[o->nvtx * 2] = lon;
+   o->vtx[o->nvtx * 2 + 1] = lat;
+   o->nvtx++;
+}
+
+
+/*! Print XML attribute value as JSON string. The value is unescaped into
+ *  the buffer jbuf of the output which grows as needed.
+ */
+static void json_str(smout_t *o, const char *s, long len)
+{
+   char *buf;
+   long i;
+
+   if (len > o->jmax)
+   {
+      if ((buf = realloc(o->jbuf, len)) == NULL)
+      {
+         o->err = 1;
+         return;
+      }
+      o->jbuf = buf;
+      o->jmax = len;
+   }
+
+   buf = o->jbuf;
+   len = ev_unescape(buf, s, len);
+   fputc('"', o->f);
+   for (i = 0; i < len; i++)
+   {
+      if (buf[i] == '"' || buf[i] == '\\')
+         fprintf(o->f, "\\%c", buf[i]);
+      else if ((unsigned char) buf[i] < 0x20)
+         fprintf(o->f, "\\u%04x", buf[i]);
+      else
+         fputc(buf[i], o->f);
+   }
+   fputc('"', o->f);
+}
+
+
+/*! Encode feature in the output format.
+ *  @return 0 on success, -1 on error.
+ */
+static int out_feature0(smout_t *o)
+{
+   int i;
+
+   if (o->fmt == FMT_MVT)
+   {
+      for (i = 0; i < o->tag->nattr; i++)
+         o->tag->attr[i].value.buf = o->buf + o->off[i];
+      i = mvt_put_feature(o->wr, o->vtx, o->nvtx, o->tag);
+      o->nvtx = 0;
+      if (i == -1)
+         o->err = 1;
+      return i;
+   }
+
+   if (o->fmt == FMT_GEOJSON && o->nfeat)
+      fputs(",\n", o->f);
+   o->nfeat++;
+
+   fprintf(o->f, "{\"type\":\"Feature\",\"geometry\":{\"type\":\"%s\",\"coordinates\":%s",
+         o->nvtx == 1 ? "Point" : "LineString", o->nvtx == 1 ? "" : "[");
+   for (i = 0; i < o->nvtx; i++)
+      fprintf(o->f, "%s[%f,%f]", i ? "," : "", o->vtx[i * 2], o->vtx[i * 2 + 1]);
+   fprintf(o->f, "%s},\"properties\":{", o->nvtx == 1 ? "" : "]");
+
+   for (i = 0; i < o->tag->nattr; i++)
+   {
+      if (i)
+         fputc(',', o->f);
+      json_str(o, o->tag->attr[i].name.buf, o->tag->attr[i].name.len);
+      fputc(':', o->f);
+      json_str(o, o->buf + o->off[i], o->tag->attr[i].value.len);
+   }
+   o->nvtx = 0;
+
+   if (fprintf(o->f, "}}%s", o->fmt == FMT_GEOJSONL ? "\n" : "") < 0)
+      return -1;
+   return 0;
+}
+
+
+/*! Write feature. Its geometry consists of the vertices added with
+ *  out_vertex(), a single vertex makes a Point, several make a LineString.
+ *  The attributes of the element started with out_elem() are the properties
+ *  of the feature. The vertex buffer is cleared afterwards. GeoJSON features
+ *  are written on a single line each, vector tile features are handed over
+ *  to the tile encoder.
+ *  @return 0 on success, -1 on error.
+ */
+int out_feature(smout_t *o)
+{
+   int i, p;
+
+   if (!OUT_FEATURES(o))
+   {
+      o->nvtx = 0;
+      return 0;
+   }
+
+   ST_COUNT(SC_FEAT);
+   p = st_switch(ST_OUT);
+   i = out_feature0(o);
+   st_switch(p);
+   return i;
+}
+
+
+/*! Turn the output into an osmChange. All objects written with out_tag()
+ *  are collected separately for each action and are written by
+ *  out_flush_route() in the order create, modify, delete.
+ *  @param route Function which returns the action of an object.
+ *  @return 0 on success, -1 on error.
+ */
+int out_route(smout_t *o, int (*route)(const hpx_tag_t *))
+{
+   int i;
+
+   for (i = 0; i < OSC_NACT; i++)
+      if ((o->act[i] = open_memstream(&o->abuf[i], &o->alen[i])) == NULL)
+         return -1;
+
+   o->route = route;
+   o->cur = OSC_CREATE;
+   return 0;
+}
+
+
+/*! Write collected objects within action blocks (<create>...</create>).
+ *  @return 0 on success, -1 on error.
+ */
+int out_flush_route(smout_t *o)
+{
+   static const char *act[] = {"create", "modify", "delete"};
+   int i;
+
+   for (i = 0; i < OSC_NACT; i++)
+   {
+      if (fflush(o->act[i]) == EOF)
+         return -1;
+      if (!o->alen[i])
+         continue;
+      if (fprintf(o->f, "<%s>\n", act[i]) < 0 || fwrite(o->abuf[i], o->alen[i], 1, o->f) != 1 ||
+            fprintf(o->f, "</%s>\n", act[i]) < 0)
+         return -1;
+      // the size of a memory stream is its current position
+      rewind(o->act[i]);
+   }
+   return 0;
+}
+
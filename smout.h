@@ -0,0 +1,97 @@
+/* Copyright 2011 Bernhard R. Fischer, 2048R/5C5FFD47 <bf@abenteuerland.at>
+ *
+ * This file is part of smfilter.
+ *
+ * Smfilter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * Smfilter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with smfilter. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SMOUT_H
+#define SMOUT_H
+
+#include <stdio.h>
+
+#include "bstring.h"
+#include "libhpxml.h"
+
+//! maximum number of attributes of generated elements
+#define OUT_MATTR 16
+
+
+//! file formats
+enum {FMT_OSM, FMT_PBF, FMT_O5M, FMT_GEOJSON, FMT_GEOJSONL, FMT_MVT};
+
+//! output contains just features written with out_feature()
+#define OUT_FEATURES(o) ((o)->fmt == FMT_GEOJSON || (o)->fmt == FMT_GEOJSONL || (o)->fmt == FMT_MVT)
+
+//! output accepts raw XML data with out_raw(), out_write() and out_printf()
+#define OUT_RAW(o) ((o)->fmt == FMT_OSM && (o)->route == NULL)
+
+//! actions of osmChange files
+enum {OSC_CREATE, OSC_MODIFY, OSC_DELETE, OSC_NACT};
+
+typedef struct smout
+{
+   //! output format
+   int fmt;
+   //! output stream
+   FILE *f;
+   //! writer of binary formats
+   void *wr;
+   //! element which is assembled by out_elem() and out_attr()
+   hpx_tag_t *tag;
+   //! buffer for attribute values of tag
+   char *buf;
+   int len, max;
+   //! offsets of attribute values within buf
+   int off[OUT_MATTR];
+   //! flag set if an error occured
+   int err;
+   //! function which returns the osmChange action (OSC_CREATE...) of an
+   //! object, NULL if the output is not an osmChange
+   int (*route)(const hpx_tag_t *);
+   //! memory streams which collect the objects of each action
+   FILE *act[OSC_NACT];
+   char *abuf[OSC_NACT];
+   size_t alen[OSC_NACT];
+   //! action of current object
+   int cur;
+   //! vertex buffer of feature (pairs of lon/lat)
+   double *vtx;
+   int nvtx, mvtx;
+   //! number of GeoJSON features written
+   long nfeat;
+   //! buffer for unescaped strings of GeoJSON properties
+   char *jbuf;
+   long jmax;
+} smout_t;
+
+
+int parse_fmt(const char *s);
+smout_t *out_open(FILE *f, int fmt, int nthreads);
+smout_t *out_open_mvt(FILE *f, const char *dir, int zmin, int zmax, int nthreads);
+int out_close(smout_t *o);
+int out_tag(smout_t *o, const hpx_tag_t *t);
+void out_elem(smout_t *o, int type, const char *name);
+void out_attr(smout_t *o, const char *name, const char *fmt, ...);
+void out_battr(smout_t *o, const char *name, bstring_t b);
+int out_end(smout_t *o);
+int out_printf(smout_t *o, const char *fmt, ...);
+int out_write(smout_t *o, const char *buf, long len);
+int out_raw(smout_t *o, const char *buf, long len);
+void out_vertex(smout_t *o, double lat, double lon);
+int out_feature(smout_t *o);
+int out_route(smout_t *o, int (*route)(const hpx_tag_t *));
+int out_flush_route(smout_t *o);
+
+#endif
+
@@ -0,0 +1,460 @@
+/* Copyright 2011 Bernhard R. Fischer, 2048R/5C5FFD47 <bf@abenteuerland.at>
+ *
+ * This file is part of smfilter.
+ *
+ * Smfilter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * Smfilter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with smfilter. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! This file contains the spatial filter. The region is a set of rings
+ *  (from a bounding box or a polygon file in the Osmosis format) which are
+ *  evaluated with the even-odd rule, thus inner rings are holes.
+ *
+ *  The cluster grid of struct osm_node (256x256 cells, see NCL()) is
+ *  used as a coarse filter. Each cell is classified as being outside,
+ *  inside, or on the border of the region. Only nodes within border cells
+ *  are tested exactly. For this test the edges are bucketed into the 256
+ *  latitude rows of the grid, thus just the edges of the row of the node
+ *  have to be checked.
+ *
+ *  Ways and relations are kept if they reference kept nodes (or kept ways
+ *  and relations). Their elements are buffered with rgn_buf_add() until
+ *  this is known.
+ *
+ *  @author Bernhard R. Fischer
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "smregion.h"
+
+
+#define RGN_CELLS 256
+
+//! classification of cluster cells
+enum {CL_OUT, CL_IN, CL_EDGE};
+
+struct edge
+{
+   double x1, y1, x2, y2;
+};
+
+//! set of ids (open addressing), id 0 marks unused entries
+struct idset
+{
+   int64_t *id;
+   long size, cnt;
+};
+
+
+static struct edge *edge_ = NULL;
+static int nedge_ = 0, medge_ = 0;
+//! edges of each latitude row, row i uses row_edge_[row_off_[i]...row_off_[i + 1] - 1]
+static int row_off_[RGN_CELLS + 1];
+static int *row_edge_ = NULL;
+//! classification of cluster cells, indexed by NCL()
+static unsigned char cell_[RGN_CELLS * RGN_CELLS];
+static struct idset set_[RGN_NTYPE];
+//! buffered elements of current way or relation
+static hpx_tag_t **buf_ = NULL;
+static int nbuf_ = 0, mbuf_ = 0;
+
+
+static int cl_lat(double y)
+{
+   int i = (y + 90.0) * RGN_CELLS / 180.0;
+   return i < 0 ? 0 : i >= RGN_CELLS ? RGN_CELLS - 1 : i;
+}
+
+
+static int cl_lon(double x)
+{
+   int i = (x + 180.0) * RGN_CELLS / 360.0;
+   return i < 0 ? 0 : i >= RGN_CELLS ? RGN_CELLS - 1 : i;
+}
+
+
+static int add_edge(double x1, double y1, double x2, double y2)
+{
+   struct edge *e;
+
+   if (nedge_ >= medge_)
+   {
+      if ((e = realloc(edge_, sizeof(*e) * (medge_ ? medge_ * 2 : 64))) == NULL)
+         return -1;
+      edge_ = e;
+      medge_ = medge_ ? medge_ * 2 : 64;
+   }
+
+   e = &edge_[nedge_++];
+   e->x1 = x1;
+   e->y1 = y1;
+   e->x2 = x2;
+   e->y2 = y2;
+   return 0;
+}
+
+
+static void edge_row(const struct edge *e, int *r1, int *r2)
+{
+   *r1 = cl_lat(e->y1 < e->y2 ? e->y1 : e->y2);
+   *r2 = cl_lat(e->y1 < e->y2 ? e->y2 : e->y1);
+}
+
+
+/*! Exact point-in-polygon test (even-odd rule).
+ */
+static int pip(double x, double y)
+{
+   const struct edge *e;
+   int i, in = 0, r = cl_lat(y);
+
+   for (i = row_off_[r]; i < row_off_[r + 1]; i++)
+   {
+      e = &edge_[row_edge_[i]];
+      if ((e->y1 > y) != (e->y2 > y) && x < (e->x2 - e->x1) * (y - e->y1) / (e->y2 - e->y1) + e->x1)
+         in ^= 1;
+   }
+   return in;
+}
+
+
+/*! Bucket the edges into rows and classify the cluster cells.
+ *  @return 0 on success, -1 on error.
+ */
+static int rgn_build(void)
+{
+   int i, j, k, r1, r2, c1, c2;
+
+   if (!nedge_)
+   {
+      errno = EINVAL;
+      return -1;
+   }
+
+   memset(row_off_, 0, sizeof(row_off_));
+   for (i = 0; i < nedge_; i++)
+   {
+      edge_row(&edge_[i], &r1, &r2);
+      for (j = r1; j <= r2; j++)
+         row_off_[j + 1]++;
+   }
+   for (i = 0; i < RGN_CELLS; i++)
+      row_off_[i + 1] += row_off_[i];
+
+   if ((row_edge_ = malloc(sizeof(*row_edge_) * (row_off_[RGN_CELLS] + 1))) == NULL)
+      return -1;
+
+   {
+      int pos[RGN_CELLS];
+
+      memcpy(pos, row_off_, sizeof(pos));
+      for (i = 0; i < nedge_; i++)
+      {
+         edge_row(&edge_[i], &r1, &r2);
+         for (j = r1; j <= r2; j++)
+            row_edge_[pos[j]++] = i;
+      }
+   }
+
+   // all cells touched by the bounding box of an edge are border cells
+   memset(cell_, CL_OUT, sizeof(cell_));
+   for (i = 0; i < nedge_; i++)
+   {
+      edge_row(&edge_[i], &r1, &r2);
+      c1 = cl_lon(edge_[i].x1 < edge_[i].x2 ? edge_[i].x1 : edge_[i].x2);
+      c2 = cl_lon(edge_[i].x1 < edge_[i].x2 ? edge_[i].x2 : edge_[i].x1);
+      for (j = c1; j <= c2; j++)
+         for (k = r1; k <= r2; k++)
+            cell_[(j << 8) | k] = CL_EDGE;
+   }
+
+   // the other cells are either completely inside or outside
+   for (j = 0; j < RGN_CELLS; j++)
+      for (k = 0; k < RGN_CELLS; k++)
+         if (cell_[(j << 8) | k] != CL_EDGE && pip((j + 0.5) * 360.0 / RGN_CELLS - 180.0, (k + 0.5) * 180.0 / RGN_CELLS - 90.0))
+            cell_[(j << 8) | k] = CL_IN;
+
+   return 0;
+}
+
+
+/*! Set region to bounding box.
+ *  @param s Bounding box "<left>,<bottom>,<right>,<top>" in degrees.
+ *  @return 0 on success, -1 on error.
+ */
+int rgn_bbox(const char *s)
+{
+   double l, b, r, t;
+
+   if (sscanf(s, "%lf,%lf,%lf,%lf", &l, &b, &r, &t) != 4 || l >= r || b >= t)
+   {
+      errno = EINVAL;
+      return -1;
+   }
+
+   if (add_edge(l, b, r, b) == -1 || add_edge(r, b, r, t) == -1
+         || add_edge(r, t, l, t) == -1 || add_edge(l, t, l, b) == -1)
+      return -1;
+
+   return rgn_build();
+}
+
+
+/*! Set region to polygon read from a file in the Osmosis polygon filter
+ *  format: a name line followed by sections of coordinate lines
+ *  "<lon> <lat>", each terminated by "END". The file is terminated by
+ *  another "END". Names of sections of holes start with '!'.
+ *  @return 0 on success, -1 on error.
+ */
+int rgn_poly(const char *name)
+{
+   double x, y, x0 = 0, y0 = 0, xp = 0, yp = 0;
+   char line[256];
+   int n = 0, sect = 0;
+   FILE *f;
+
+   if ((f = fopen(name, "r")) == NULL)
+      return -1;
+
+   // skip name of polygon
+   if (fgets(line, sizeof(line), f) == NULL)
+      goto fail;
+
+   while (fgets(line, sizeof(line), f) != NULL)
+   {
+      if (!strncmp(line, "END", 3))
+      {
+         if (!sect)
+         {
+            fclose(f);
+            return rgn_build();
+         }
+
+         // close ring
+         if (n && (xp != x0 || yp != y0) && add_edge(xp, yp, x0, y0) == -1)
+            goto fail;
+         sect = 0;
+         continue;
+      }
+
+      if (!sect)
+      {
+         sect = 1;
+         n = 0;
+         continue;
+      }
+
+      if (sscanf(line, "%lf %lf", &x, &y) != 2)
+         goto fail;
+
+      if (!n++)
+      {
+         x0 = x;
+         y0 = y;
+      }
+      else if (add_edge(xp, yp, x, y) == -1)
+         goto fail;
+      xp = x;
+      yp = y;
+   }
+
+fail:
+   if (!ferror(f) && errno != ENOMEM)
+      errno = EINVAL;
+   fclose(f);
+   return -1;
+}
+
+
+/*! Test if node is within the region.
+ *  @return 1 if it is inside, otherwise 0.
+ */
+int rgn_inside(const struct osm_node *nd)
+{
+   // the cluster wraps around at lat = 90 and lon = 180
+   if (nd->lat < 90.0 && nd->lon < 180.0)
+   {
+      switch (cell_[nd->cl])
+      {
+         case CL_OUT:
+            return 0;
+         case CL_IN:
+            return 1;
+      }
+   }
+   return pip(nd->lon, nd->lat);
+}
+
+
+static unsigned long rgn_hash(int64_t id)
+{
+   return (unsigned long) id * 0x9e3779b97f4a7c15ul;
+}
+
+
+static int64_t *set_find(const struct idset *s, int64_t id)
+{
+   unsigned long i;
+
+   for (i = rgn_hash(id) & (s->size - 1); s->id[i] && s->id[i] != id; i = (i + 1) & (s->size - 1));
+   return &s->id[i];
+}
+
+
+static int set_grow(struct idset *s)
+{
+   int64_t *old = s->id;
+   long i, n = s->size;
+   struct idset t;
+
+   if ((t.id = calloc(n ? n * 2 : 4096, sizeof(*t.id))) == NULL)
+      return -1;
+   t.size = n ? n * 2 : 4096;
+   t.cnt = s->cnt;
+
+   for (i = 0; i < n; i++)
+      if (old[i])
+         *set_find(&t, old[i]) = old[i];
+   free(old);
+   *s = t;
+
+   return 0;
+}
+
+
+/*! Remember that object id of type (RGN_NODE...) is kept.
+ *  @return 0 on success, -1 on error.
+ */
+int rgn_keep(int type, int64_t id)
+{
+   struct idset *s = &set_[type];
+   int64_t *p;
+
+   if (!id)
+      return 0;
+   if (s->cnt * 2 >= s->size && set_grow(s) == -1)
+      return -1;
+
+   if (!*(p = set_find(s, id)))
+   {
+      *p = id;
+      s->cnt++;
+   }
+   return 0;
+}
+
+
+/*! Test if object id of type (RGN_NODE...) is kept.
+ */
+int rgn_kept(int type, int64_t id)
+{
+   return set_[type].size && id && *set_find(&set_[type], id) == id;
+}
+
+
+/*! Copy string b to s.
+ *  @return Pointer to the byte following the copy.
+ */
+static char *str_copy(char *s, bstring_t *b)
+{
+   if (b->len)
+      memcpy(s, b->buf, b->len);
+   b->buf = s;
+   return s + b->len;
+}
+
+
+/*! Append copy of element to the buffer.
+ *  @return 0 on success, -1 on error.
+ */
+int rgn_buf_add(const hpx_tag_t *t)
+{
+   hpx_tag_t **b, *c;
+   long len = t->tag.len;
+   char *s;
+   int i;
+
+   if (nbuf_ >= mbuf_)
+   {
+      if ((b = realloc(buf_, sizeof(*b) * (mbuf_ ? mbuf_ * 2 : 64))) == NULL)
+         return -1;
+      buf_ = b;
+      mbuf_ = mbuf_ ? mbuf_ * 2 : 64;
+   }
+
+   for (i = 0; i < t->nattr; i++)
+      len += t->attr[i].name.len + t->attr[i].value.len;
+
+   if ((c = malloc(sizeof(*c) + sizeof(*c->attr) * t->nattr + len)) == NULL)
+      return -1;
+
+   // strings are stored behind the attributes
+   s = (char*) &c->attr[t->nattr];
+   *c = *t;
+   c->mattr = c->nattr;
+   s = str_copy(s, &c->tag);
+   for (i = 0; i < t->nattr; i++)
+   {
+      c->attr[i] = t->attr[i];
+      s = str_copy(s, &c->attr[i].name);
+      s = str_copy(s, &c->attr[i].value);
+   }
+
+   buf_[nbuf_++] = c;
+   return 0;
+}
+
+
+/*! Output all buffered elements and clear the buffer.
+ *  @return Number of elements output.
+ */
+int rgn_buf_flush(smout_t *out)
+{
+   int i, n = nbuf_;
+
+   for (i = 0; i < nbuf_; i++)
+      out_tag(out, buf_[i]);
+   rgn_buf_clear();
+   return n;
+}
+
+
+void rgn_buf_clear(void)
+{
+   int i;
+
+   for (i = 0; i < nbuf_; i++)
+      free(buf_[i]);
+   nbuf_ = 0;
+}
+
+
+void rgn_free(void)
+{
+   int i;
+
+   rgn_buf_clear();
+   free(buf_);
+   for (i = 0; i < RGN_NTYPE; i++)
+      free(set_[i].id);
+   memset(set_, 0, sizeof(set_));
+   free(row_edge_);
+   free(edge_);
+   buf_ = NULL;
+   row_edge_ = NULL;
+   edge_ = NULL;
+   nedge_ = medge_ = mbuf_ = 0;
+}
+
@@ -0,0 +1,43 @@
+/* Copyright 2011 Bernhard R. Fischer, 2048R/5C5FFD47 <bf@abenteuerland.at>
+ *
+ * This file is part of smfilter.
+ *
+ * Smfilter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * Smfilter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with smfilter. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SMREGION_H
+#define SMREGION_H
+
+#include <stdint.h>
+
+#include "libhpxml.h"
+#include "osm_inplace.h"
+#include "smout.h"
+
+
+//! object types of the id sets
+enum {RGN_NODE, RGN_WAY, RGN_REL, RGN_NTYPE};
+
+
+int rgn_bbox(const char *s);
+int rgn_poly(const char *name);
+int rgn_inside(const struct osm_node *nd);
+int rgn_keep(int type, int64_t id);
+int rgn_kept(int type, int64_t id);
+int rgn_buf_add(const hpx_tag_t *t);
+int rgn_buf_flush(smout_t *out);
+void rgn_buf_clear(void);
+void rgn_free(void);
+
+#endif
+
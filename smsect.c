@@ -0,0 +1,280 @@
+/* Copyright 2011 Bernhard R. Fischer, 2048R/5C5FFD47 <bf@abenteuerland.at>
+ *
+ * This file is part of smfilter.
+ *
+ * Smfilter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * Smfilter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with smfilter. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! This file contains the writer and the reader of sector files. A sector
+ *  file contains the parsed and processed sectors of all lights, i.e. the
+ *  input of sector_calc2(), in a binary format which may be mapped into
+ *  memory by renderers (see struct sct_hdr). Thus they do not have to parse
+ *  and process the sector tags again.
+ *
+ *  The records are collected in memory and written by sct_close() to a
+ *  temporary file which replaces the sector file afterwards.
+ *
+ *  @author Bernhard R. Fischer
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "smsect.h"
+#include "seamark.h"
+#include "osm_inplace.h"
+
+
+//! name of sector file
+static char *name_ = NULL;
+static struct sct_light *light_ = NULL;
+static uint64_t nlight_ = 0, mlight_ = 0;
+static struct sct_sector *sec_ = NULL;
+static uint64_t nsec_ = 0, msec_ = 0;
+static struct sct_frac *frac_ = NULL;
+static uint64_t nfrac_ = 0, mfrac_ = 0;
+
+
+/*! Grow table p of n records of size sz if it is full.
+ *  @return 0 on success, -1 on error.
+ */
+static int sct_grow(void **p, uint64_t n, uint64_t *max, size_t sz)
+{
+   void *q;
+   uint64_t m;
+
+   if (n < *max)
+      return 0;
+
+   m = *max ? *max * 2 : 1024;
+   if ((q = realloc(*p, m * sz)) == NULL)
+      return -1;
+   *p = q;
+   *max = m;
+   return 0;
+}
+
+
+/*! Open sector file for writing.
+ *  @return 0 on success, -1 on error.
+ */
+int sct_open(const char *name)
+{
+   char tmp[strlen(name) + 5];
+   FILE *f;
+
+   // check early that the file can be written
+   snprintf(tmp, sizeof(tmp), "%s.tmp", name);
+   if ((f = fopen(tmp, "w")) == NULL)
+      return -1;
+   fclose(f);
+
+   if ((name_ = strdup(name)) == NULL)
+      return -1;
+   return 0;
+}
+
+
+/*! Add sector of a light. Consecutive sectors of the same node are
+ *  collected within a single light record. The sector must be processed by
+ *  proc_sfrac() before.
+ *  @return 0 on success, -1 on error.
+ */
+int sct_put(const struct osm_node *nd, const struct sector *sec)
+{
+   struct sct_light *l;
+   struct sct_sector *s;
+   struct sct_frac *f;
+   int i;
+
+   if (!nlight_ || light_[nlight_ - 1].id != nd->id)
+   {
+      if (sct_grow((void**) &light_, nlight_, &mlight_, sizeof(*light_)) == -1)
+         return -1;
+      l = &light_[nlight_++];
+      l->id = nd->id;
+      l->lat = nd->lat;
+      l->lon = nd->lon;
+      l->sec = nsec_;
+      l->nsec = 0;
+   }
+
+   if (sct_grow((void**) &sec_, nsec_, &msec_, sizeof(*sec_)) == -1)
+      return -1;
+   s = &sec_[nsec_++];
+   memset(s, 0, sizeof(*s));
+   s->start = sec->start;
+   s->end = sec->end;
+   s->dir = sec->dir;
+   s->r = sec->r;
+   s->nr = sec->nr;
+   s->col[0] = sec->col[0];
+   s->col[1] = sec->col[1];
+   s->cat = sec->cat;
+   s->frac = nfrac_;
+   s->nfrac = sec->fused;
+   light_[nlight_ - 1].nsec++;
+
+   for (i = 0; i < sec->fused; i++)
+   {
+      if (sct_grow((void**) &frac_, nfrac_, &mfrac_, sizeof(*frac_)) == -1)
+         return -1;
+      f = &frac_[nfrac_++];
+      f->r = sec->sf[i].r;
+      f->start = sec->sf[i].start;
+      f->end = sec->sf[i].end;
+      f->type = sec->sf[i].type;
+      f->col = sec->sf[i].col;
+      f->startr = sec->sf[i].startr;
+      f->endr = sec->sf[i].endr;
+   }
+
+   return 0;
+}
+
+
+/*! Write sector file and free all records.
+ *  @return 0 on success, -1 on error.
+ */
+int sct_close(void)
+{
+   char tmp[strlen(name_) + 5];
+   struct sct_hdr hdr;
+   const char *c;
+   FILE *f;
+   int e = 0;
+
+   memset(&hdr, 0, sizeof(hdr));
+   memcpy(hdr.magic, SCT_MAGIC, sizeof(hdr.magic));
+   hdr.version = SCT_VERSION;
+   hdr.hdr_size = sizeof(hdr);
+   for (; hdr.ncol < SCT_MCOL && (c = color(hdr.ncol)) != NULL; hdr.ncol++)
+      strncpy(hdr.col[hdr.ncol], c, SCT_COL_LEN - 1);
+
+   // all record sizes are multiples of 8 bytes
+   hdr.nlight = nlight_;
+   hdr.light_off = sizeof(hdr);
+   hdr.nsec = nsec_;
+   hdr.sec_off = hdr.light_off + nlight_ * sizeof(*light_);
+   hdr.nfrac = nfrac_;
+   hdr.frac_off = hdr.sec_off + nsec_ * sizeof(*sec_);
+
+   snprintf(tmp, sizeof(tmp), "%s.tmp", name_);
+   if ((f = fopen(tmp, "w")) == NULL)
+      e = -1;
+   else
+   {
+      if (fwrite(&hdr, sizeof(hdr), 1, f) != 1
+            || fwrite(light_, sizeof(*light_), nlight_, f) != nlight_
+            || fwrite(sec_, sizeof(*sec_), nsec_, f) != nsec_
+            || fwrite(frac_, sizeof(*frac_), nfrac_, f) != nfrac_)
+         e = -1;
+      if (fclose(f) == EOF)
+         e = -1;
+      if (!e)
+         e = rename(tmp, name_);
+   }
+
+   free(light_);
+   free(sec_);
+   free(frac_);
+   free(name_);
+   light_ = NULL;
+   sec_ = NULL;
+   frac_ = NULL;
+   name_ = NULL;
+   nlight_ = nsec_ = nfrac_ = mlight_ = msec_ = mfrac_ = 0;
+
+   return e;
+}
+
+
+/*! Check if table of n records of size sz at offset off is within the file.
+ */
+static int sct_inside(size_t len, uint64_t off, uint64_t n, size_t sz)
+{
+   return off <= len && (off & 7) == 0 && n <= (len - off) / sz;
+}
+
+
+/*! Map sector file into memory for reading.
+ *  @param sf Structure which receives the pointers to the tables.
+ *  @return 0 on success, -1 on error with errno set (EINVAL if the file is
+ *  not a valid sector file).
+ */
+int sct_map(const char *name, sct_file_t *sf)
+{
+   const struct sct_hdr *h;
+   struct stat st;
+   void *p;
+   int fd;
+
+   memset(sf, 0, sizeof(*sf));
+   if ((fd = open(name, O_RDONLY)) == -1)
+      return -1;
+
+   if (fstat(fd, &st) == -1)
+   {
+      close(fd);
+      return -1;
+   }
+
+   if ((size_t) st.st_size < sizeof(*h))
+   {
+      close(fd);
+      errno = EINVAL;
+      return -1;
+   }
+
+   p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+   close(fd);
+   if (p == MAP_FAILED)
+      return -1;
+
+   sf->map = p;
+   sf->len = st.st_size;
+   h = p;
+   if (memcmp(h->magic, SCT_MAGIC, sizeof(h->magic)) || h->version != SCT_VERSION
+         || h->hdr_size != sizeof(*h) || h->ncol > SCT_MCOL
+         || !sct_inside(sf->len, h->light_off, h->nlight, sizeof(*sf->light))
+         || !sct_inside(sf->len, h->sec_off, h->nsec, sizeof(*sf->sec))
+         || !sct_inside(sf->len, h->frac_off, h->nfrac, sizeof(*sf->frac)))
+   {
+      sct_unmap(sf);
+      errno = EINVAL;
+      return -1;
+   }
+
+   sf->hdr = h;
+   sf->light = (const struct sct_light*) (sf->map + h->light_off);
+   sf->sec = (const struct sct_sector*) (sf->map + h->sec_off);
+   sf->frac = (const struct sct_frac*) (sf->map + h->frac_off);
+   return 0;
+}
+
+
+/*! Unmap sector file.
+ */
+void sct_unmap(sct_file_t *sf)
+{
+   if (sf->map != NULL)
+      munmap((void*) sf->map, sf->len);
+   memset(sf, 0, sizeof(*sf));
+}
+
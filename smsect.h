@@ -0,0 +1,115 @@
+/* Copyright 2011 Bernhard R. Fischer, 2048R/5C5FFD47 <bf@abenteuerland.at>
+ *
+ * This file is part of smfilter.
+ *
+ * Smfilter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * Smfilter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with smfilter. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SMSECT_H
+#define SMSECT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+
+//! magic bytes at the beginning of a sector file
+#define SCT_MAGIC "SMSECTR\0"
+//! version of file layout
+#define SCT_VERSION 1
+//! maximum number and length of color names
+#define SCT_MCOL 16
+#define SCT_COL_LEN 16
+
+
+/*! Header of sector file. The file consists of the header followed by the
+ *  tables of lights, sectors, and subsectors. Each table is an array of
+ *  fixed size records in host byte order, aligned to 8 bytes, thus the file
+ *  can be mapped into memory and accessed directly. Indexes refer to the
+ *  elements of the following table, i.e. the sectors of a light are
+ *  sec[light.sec] to sec[light.sec + light.nsec - 1].
+ */
+struct sct_hdr
+{
+   char magic[8];
+   uint32_t version;
+   //! size of header, tables start at their offsets anyway
+   uint32_t hdr_size;
+   //! number of colors
+   uint32_t ncol;
+   uint32_t pad;
+   //! number and file offsets of the records of each table
+   uint64_t nlight, light_off;
+   uint64_t nsec, sec_off;
+   uint64_t nfrac, frac_off;
+   //! names of colors, indexed by the color numbers of the records
+   char col[SCT_MCOL][SCT_COL_LEN];
+};
+
+struct sct_light
+{
+   int64_t id;             //!< id of seamark node
+   float lat, lon;         //!< position
+   uint32_t sec, nsec;     //!< first sector and number of sectors
+};
+
+struct sct_sector
+{
+   float start, end;       //!< start and end angle, end may exceed 360
+   float dir;              //!< orientation of directional light, NaN otherwise
+   float r;                //!< nominal range in nm, NaN if undefined
+   int32_t nr;             //!< number of sector
+   int8_t col[2];          //!< color, second color of alternating light or -1
+   uint8_t cat;            //!< category (CAT_STD, CAT_DIR)
+   uint8_t pad;
+   uint32_t frac, nfrac;   //!< first subsector and number of subsectors
+};
+
+struct sct_frac
+{
+   float r;                //!< radius in nm
+   float start, end;       //!< start and end angle
+   uint8_t type;           //!< arc type (ARC_SOLID...)
+   int8_t col;             //!< color
+   uint8_t startr, endr;   //!< flags set if radial is drawn at start/end
+};
+
+// the layout of the file depends on the record sizes, thus they must not
+// change by accident, and the tables have to stay aligned to 8 bytes
+_Static_assert(sizeof(struct sct_hdr) % 8 == 0, "size of sct_hdr is not a multiple of 8");
+_Static_assert(sizeof(struct sct_light) == 24, "size of sct_light is not 24 bytes");
+_Static_assert(sizeof(struct sct_sector) == 32, "size of sct_sector is not 32 bytes");
+_Static_assert(sizeof(struct sct_frac) == 16, "size of sct_frac is not 16 bytes");
+
+//! sector file mapped into memory by sct_map()
+typedef struct sct_file
+{
+   const char *map;
+   size_t len;
+   const struct sct_hdr *hdr;
+   const struct sct_light *light;
+   const struct sct_sector *sec;
+   const struct sct_frac *frac;
+} sct_file_t;
+
+struct osm_node;
+struct sector;
+
+
+int sct_open(const char *name);
+int sct_put(const struct osm_node *nd, const struct sector *sec);
+int sct_close(void);
+int sct_map(const char *name, sct_file_t *sf);
+void sct_unmap(sct_file_t *sf);
+
+#endif
+
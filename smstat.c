@@ -0,0 +1,302 @@
+/* Copyright 2011 Bernhard R. Fischer, 2048R/5C5FFD47 <bf@abenteuerland.at>
+ *
+ * This file is part of smfilter.
+ *
+ * Smfilter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * Smfilter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with smfilter. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! This file contains the statistics of smfilter (option -v). Counters
+ *  are plain variables which are incremented with ST_COUNT(). The time is
+ *  measured per stage of processing: the code which enters a stage calls
+ *  st_switch() which charges the time elapsed since the previous switch to
+ *  the stage left and returns it, thus nested stages are measured
+ *  exclusively. Without -v st_switch() does not read the clock.
+ *
+ *  The counters may also be written periodically to a metrics file (option
+ *  -m) for monitoring long running jobs, either in the Prometheus text
+ *  format or as JSON. The file is replaced atomically.
+ *
+ *  @author Bernhard R. Fischer
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include "smstat.h"
+
+
+long st_cnt_[SC_NCNT];
+//! flag set if statistics are enabled
+static int on_ = 0;
+//! progress interval in seconds, 0 if disabled
+static int interval_ = 0;
+//! current stage and time of last switch
+static int cur_ = ST_OTHER;
+static int64_t last_, start_, next_;
+//! time spent in each stage (ns)
+static int64_t t_[ST_NSTAGE];
+//! metrics file, its format, interval (ns), and time of next update
+static char *mname_ = NULL;
+static int mjson_ = 0;
+static int64_t minterval_, mnext_;
+//! size of input file, 0 if unknown
+static long msize_ = 0;
+//! time, position, and number of elements of previous update
+static int64_t mlast_;
+static long mpos_, melem_;
+
+static const char *stage_[] = {"other", "scan", "parse", "generate", "output"};
+
+
+static int64_t st_now(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+/*! Enable statistics.
+ *  @param interval Print progress every interval seconds to stderr, 0
+ *  disables progress output.
+ */
+void st_init(int interval)
+{
+   on_ = 1;
+   interval_ = interval;
+   last_ = st_now();
+   if (!start_)
+      start_ = last_;
+   next_ = last_ + (int64_t) interval * 1000000000;
+}
+
+
+/*! Write metrics periodically to a file. The format is JSON if the name
+ *  ends with ".json", otherwise it is the Prometheus text format.
+ *  @param interval Interval of updates in seconds.
+ *  @param size Size of the input file, 0 if unknown.
+ *  @return 0 on success, -1 on error.
+ */
+int st_metrics(const char *name, int interval, long size)
+{
+   size_t len = strlen(name);
+
+   if ((mname_ = strdup(name)) == NULL)
+      return -1;
+   mjson_ = len > 5 && !strcmp(name + len - 5, ".json");
+   msize_ = size;
+   minterval_ = (int64_t) (interval > 0 ? interval : 1) * 1000000000;
+   mlast_ = st_now();
+   if (!start_)
+      start_ = mlast_;
+   mnext_ = mlast_ + minterval_;
+   return 0;
+}
+
+
+/*! Switch to stage.
+ *  @return Previous stage.
+ */
+int st_switch(int stage)
+{
+   int64_t now;
+   int prev = cur_;
+
+   if (!on_)
+      return prev;
+
+   now = st_now();
+   t_[cur_] += now - last_;
+   last_ = now;
+   cur_ = stage;
+   return prev;
+}
+
+
+/*! Test if progress has to be printed or metrics have to be written. The
+ *  clock is read just every 4096 elements.
+ */
+int st_due(void)
+{
+   int64_t now;
+
+   if ((!interval_ && mname_ == NULL) || (st_cnt_[SC_ELEM] & 4095))
+      return 0;
+   // the time of the last switch is recent if statistics are enabled
+   now = on_ ? last_ : st_now();
+   return (interval_ && now >= next_) || (mname_ != NULL && now >= mnext_);
+}
+
+
+static double st_sec(int64_t t)
+{
+   return t / 1e9;
+}
+
+
+//! return average time in ns which stage spent per item of counter cnt
+static double st_nsop(int stage, int cnt)
+{
+   return st_cnt_[cnt] ? (double) t_[stage] / st_cnt_[cnt] : 0;
+}
+
+
+/*! Write metrics file.
+ *  @param done Flag set if processing finished.
+ *  @return 0 on success, -1 on error.
+ */
+static int st_write_metrics(long pos, int done)
+{
+   static const char *name[SC_NCNT] = {"elements", "nodes", "seamarks", "sectors",
+      "generated_nodes", "generated_ways", "features", "buffer_refills"};
+   char tmp[strlen(mname_) + 5];
+   int64_t now = st_now();
+   double t = st_sec(now - start_), dt = st_sec(now - mlast_), eta = -1;
+   struct rusage ru;
+   long rss = 0;
+   FILE *f;
+   int i, e;
+
+   if (getrusage(RUSAGE_SELF, &ru) != -1)
+      rss = ru.ru_maxrss * 1024L;
+   if (msize_ > 0 && pos > 0 && !done)
+      eta = t * (msize_ - pos) / pos;
+
+   snprintf(tmp, sizeof(tmp), "%s.tmp", mname_);
+   if ((f = fopen(tmp, "w")) == NULL)
+      return -1;
+
+   if (mjson_)
+   {
+      fprintf(f, "{\"done\":%s,\"elapsed_seconds\":%.3f,\"input_bytes\":%ld,\"input_size_bytes\":%ld,"
+            "\"eta_seconds\":%.0f,\"bytes_per_second\":%.0f,\"elements_per_second\":%.0f,"
+            "\"peak_rss_bytes\":%ld,\"generated_ids\":%ld",
+            done ? "true" : "false", t, pos, msize_, eta, dt > 0 ? (pos - mpos_) / dt : 0,
+            dt > 0 ? (st_cnt_[SC_ELEM] - melem_) / dt : 0, rss,
+            st_cnt_[SC_GNODE] + st_cnt_[SC_GWAY]);
+      for (i = 0; i < SC_NCNT; i++)
+         fprintf(f, ",\"%s\":%ld", name[i], st_cnt_[i]);
+      fprintf(f, "}\n");
+   }
+   else
+   {
+      fprintf(f, "# HELP smfilter_done 1 if processing finished.\n# TYPE smfilter_done gauge\nsmfilter_done %d\n"
+            "# TYPE smfilter_elapsed_seconds gauge\nsmfilter_elapsed_seconds %.3f\n"
+            "# TYPE smfilter_input_bytes gauge\nsmfilter_input_bytes %ld\n"
+            "# TYPE smfilter_input_size_bytes gauge\nsmfilter_input_size_bytes %ld\n"
+            "# HELP smfilter_eta_seconds Estimated remaining time, -1 if unknown.\n"
+            "# TYPE smfilter_eta_seconds gauge\nsmfilter_eta_seconds %.0f\n"
+            "# TYPE smfilter_bytes_per_second gauge\nsmfilter_bytes_per_second %.0f\n"
+            "# TYPE smfilter_elements_per_second gauge\nsmfilter_elements_per_second %.0f\n"
+            "# TYPE smfilter_peak_rss_bytes gauge\nsmfilter_peak_rss_bytes %ld\n"
+            "# TYPE smfilter_generated_ids_total counter\nsmfilter_generated_ids_total %ld\n",
+            done, t, pos, msize_, eta, dt > 0 ? (pos - mpos_) / dt : 0,
+            dt > 0 ? (st_cnt_[SC_ELEM] - melem_) / dt : 0, rss,
+            st_cnt_[SC_GNODE] + st_cnt_[SC_GWAY]);
+      for (i = 0; i < SC_NCNT; i++)
+         fprintf(f, "# TYPE smfilter_%s_total counter\nsmfilter_%s_total %ld\n", name[i], name[i], st_cnt_[i]);
+   }
+
+   e = ferror(f) ? -1 : 0;
+   if (fclose(f) == EOF)
+      e = -1;
+   if (!e)
+      e = rename(tmp, mname_);
+
+   mlast_ = now;
+   mpos_ = pos;
+   melem_ = st_cnt_[SC_ELEM];
+   while (mnext_ <= now)
+      mnext_ += minterval_;
+   return e;
+}
+
+
+/*! Print progress line to stderr.
+ *  @param pos Current position within the input (bytes), 0 if unknown.
+ */
+static void st_progress(long pos)
+{
+   double t = st_sec(st_now() - start_);
+
+   fprintf(stderr, "[%.1fs] %.1f MB, %.1f MB/s, %ld elements, %ld seamarks, %ld sectors\n",
+         t, pos / 1e6, t > 0 ? pos / 1e6 / t : 0, st_cnt_[SC_ELEM], st_cnt_[SC_SEAMARK],
+         st_cnt_[SC_SECTOR]);
+   while (next_ <= last_ || next_ <= st_now())
+      next_ += (int64_t) interval_ * 1000000000;
+}
+
+
+/*! Print progress and write metrics if they are due.
+ *  @param pos Current position within the input (bytes), 0 if unknown.
+ */
+void st_update(long pos)
+{
+   int64_t now = st_now();
+
+   if (interval_ && now >= next_)
+      st_progress(pos);
+   if (mname_ != NULL && now >= mnext_ && st_write_metrics(pos, 0) == -1)
+      perror("st_write_metrics");
+}
+
+
+/*! Print statistics to stderr and write final metrics.
+ *  @param pos Number of bytes read, 0 if unknown.
+ */
+void st_print(long pos)
+{
+   double t;
+   int i;
+
+   if (mname_ != NULL)
+   {
+      if (st_write_metrics(pos, 1) == -1)
+         perror("st_write_metrics");
+      free(mname_);
+      mname_ = NULL;
+   }
+
+   if (!on_)
+      return;
+
+   (void) st_switch(cur_);
+   t = st_sec(last_ - start_);
+
+   fprintf(stderr,
+         "smfilter statistics:\n"
+         "   input ............ %.1f MB, %.1f MB/s\n"
+         "   elements ......... %ld\n"
+         "   nodes ............ %ld\n"
+         "   seamark nodes .... %ld\n"
+         "   sectors .......... %ld\n"
+         "   generated ........ %ld nodes, %ld ways, %ld features\n"
+         "   time ............. %.3fs\n"
+         "   stages ...........",
+         pos / 1e6, t > 0 ? pos / 1e6 / t : 0, st_cnt_[SC_ELEM], st_cnt_[SC_NODE],
+         st_cnt_[SC_SEAMARK], st_cnt_[SC_SECTOR], st_cnt_[SC_GNODE], st_cnt_[SC_GWAY],
+         st_cnt_[SC_FEAT], t);
+   for (i = 0; i < ST_NSTAGE; i++)
+      fprintf(stderr, "%s %s %.3fs (%.0f%%)", i ? "," : "", stage_[i], st_sec(t_[i]),
+            t > 0 ? st_sec(t_[i]) * 100 / t : 0);
+   fprintf(stderr, "\n"
+         "   per operation .... scan %.0f ns/element, parse %.0f ns/element, "
+         "generate %.0f ns/sector, output %.0f ns/element\n",
+         st_nsop(ST_SCAN, SC_ELEM), st_nsop(ST_PARSE, SC_ELEM), st_nsop(ST_GEN, SC_SECTOR),
+         st_nsop(ST_OUT, SC_ELEM));
+}
+
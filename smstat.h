@@ -0,0 +1,47 @@
+/* Copyright 2011 Bernhard R. Fischer, 2048R/5C5FFD47 <bf@abenteuerland.at>
+ *
+ * This file is part of smfilter.
+ *
+ * Smfilter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * Smfilter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with smfilter. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SMSTAT_H
+#define SMSTAT_H
+
+#include <stdio.h>
+
+
+//! default interval of updates of the metrics file (seconds)
+#define METRICS_INTERVAL 10
+
+//! stages of processing whose time is measured
+enum {ST_OTHER, ST_SCAN, ST_PARSE, ST_GEN, ST_OUT, ST_NSTAGE};
+
+//! counters
+enum {SC_ELEM, SC_NODE, SC_SEAMARK, SC_SECTOR, SC_GNODE, SC_GWAY, SC_FEAT, SC_REFILL, SC_NCNT};
+
+extern long st_cnt_[SC_NCNT];
+
+//! increment counter, this is done even if statistics are disabled
+#define ST_COUNT(c) (st_cnt_[c]++)
+
+
+void st_init(int interval);
+int st_metrics(const char *name, int interval, long size);
+int st_switch(int stage);
+int st_due(void);
+void st_update(long pos);
+void st_print(long pos);
+
+#endif
+
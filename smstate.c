@@ -0,0 +1,192 @@
+/* Copyright 2011 Bernhard R. Fischer, 2048R/5C5FFD47 <bf@abenteuerland.at>
+ *
+ * This file is part of smfilter.
+ *
+ * Smfilter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * Smfilter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with smfilter. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! This file contains the state of the incremental mode. For each seamark
+ *  node which generated objects, the number of generated nodes and ways is
+ *  kept. Together with the stable ids (see set_base_id()) this is
+ *  sufficient to know which objects have to be modified, created, or
+ *  deleted if the seamark changes. The state is kept in a text file with
+ *  one line "<node id> <nodes> <ways>" per seamark node.
+ *
+ *  @author Bernhard R. Fischer
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "smstate.h"
+
+
+struct gstate
+{
+   long id;
+   int nodes, ways;
+   //! flag set if entry is in use, any id including 0 is valid
+   int used;
+};
+
+//! hash table (open addressing)
+static struct gstate *gst_ = NULL;
+static long gst_size_ = 0, gst_cnt_ = 0;
+
+
+static unsigned long gst_hash(long id)
+{
+   return (unsigned long) id * 0x9e3779b97f4a7c15ul;
+}
+
+
+/*! Find entry of id or the free entry where it has to be inserted.
+ */
+static struct gstate *gst_find(long id)
+{
+   unsigned long i;
+
+   for (i = gst_hash(id) & (gst_size_ - 1); gst_[i].used && gst_[i].id != id; i = (i + 1) & (gst_size_ - 1));
+   return &gst_[i];
+}
+
+
+static int gst_grow(void)
+{
+   struct gstate *old = gst_, *g;
+   long i, n = gst_size_;
+
+   if ((g = calloc(n ? n * 2 : 4096, sizeof(*g))) == NULL)
+      return -1;
+
+   gst_ = g;
+   gst_size_ = n ? n * 2 : 4096;
+   for (i = 0; i < n; i++)
+      if (old[i].used)
+         *gst_find(old[i].id) = old[i];
+   free(old);
+
+   return 0;
+}
+
+
+/*! Get number of generated nodes and ways of seamark node id. Both are 0 if
+ *  the node is unknown.
+ */
+void gst_get(long id, int *nodes, int *ways)
+{
+   struct gstate *g;
+
+   *nodes = *ways = 0;
+   if (!gst_size_)
+      return;
+
+   g = gst_find(id);
+   if (g->used)
+   {
+      *nodes = g->nodes;
+      *ways = g->ways;
+   }
+}
+
+
+/*! Set number of generated nodes and ways of seamark node id. Entries with
+ *  nodes = ways = 0 are not written by gst_save().
+ *  @return 0 on success, -1 on error.
+ */
+int gst_put(long id, int nodes, int ways)
+{
+   struct gstate *g;
+
+   if (gst_cnt_ * 2 >= gst_size_ && gst_grow() == -1)
+      return -1;
+
+   g = gst_find(id);
+   if (!g->used)
+   {
+      if (!nodes && !ways)
+         return 0;
+      g->id = id;
+      g->used = 1;
+      gst_cnt_++;
+   }
+   g->nodes = nodes;
+   g->ways = ways;
+
+   return 0;
+}
+
+
+/*! Load state file. A missing file is not an error, the state is empty
+ *  then.
+ *  @return 0 on success, -1 on error.
+ */
+int gst_load(const char *name)
+{
+   int nodes, ways, n;
+   FILE *f;
+   long id;
+
+   if ((f = fopen(name, "r")) == NULL)
+      return errno == ENOENT ? 0 : -1;
+
+   while ((n = fscanf(f, "%ld %d %d", &id, &nodes, &ways)) == 3)
+      if (gst_put(id, nodes, ways) == -1)
+         break;
+
+   if (n != EOF || ferror(f))
+   {
+      if (!ferror(f))
+         errno = EINVAL;
+      fclose(f);
+      return -1;
+   }
+
+   fclose(f);
+   return 0;
+}
+
+
+/*! Save state. The file is written to a temporary file first which is
+ *  renamed afterwards, thus the old state is kept if anything fails.
+ *  @return 0 on success, -1 on error.
+ */
+int gst_save(const char *name)
+{
+   char tmp[strlen(name) + 5];
+   FILE *f;
+   long i;
+
+   snprintf(tmp, sizeof(tmp), "%s.tmp", name);
+   if ((f = fopen(tmp, "w")) == NULL)
+      return -1;
+
+   for (i = 0; i < gst_size_; i++)
+      if (gst_[i].used && (gst_[i].nodes || gst_[i].ways))
+         fprintf(f, "%ld %d %d\n", gst_[i].id, gst_[i].nodes, gst_[i].ways);
+
+   if (fclose(f) == EOF)
+      return -1;
+
+   return rename(tmp, name);
+}
+
+
+void gst_free(void)
+{
+   free(gst_);
+   gst_ = NULL;
+   gst_size_ = gst_cnt_ = 0;
+}
+
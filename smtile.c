@@ -0,0 +1,319 @@
+/* Copyright 2011 Bernhard R. Fischer, 2048R/5C5FFD47 <bf@abenteuerland.at>
+ *
+ * This file is part of smfilter.
+ *
+ * Smfilter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * Smfilter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with smfilter. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! This file contains the tile-partitioned output. The generated objects
+ *  of each seamark are written as an XML fragment into a spool file. The
+ *  fragment is assigned to every tile (slippy map scheme) which intersects
+ *  the bounding box of its nodes. Thus, arcs crossing tile boundaries are
+ *  contained completely, with the same ids, in all tiles which they touch.
+ *  At the end the tiles are written in parallel into the files
+ *  <dir>/<zoom>/<x>/<y>.osm.
+ *
+ *  @author Bernhard R. Fischer
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <math.h>
+#include <sys/stat.h>
+
+#include "smtile.h"
+#include "jobq.h"
+
+
+struct frag
+{
+   long off, len;
+};
+
+struct tile
+{
+   //! x << 32 | y, ~0 marks unused entries
+   uint64_t key;
+   struct frag *frag;
+   int nfrag, mfrag;
+   //! errno of writer
+   int err;
+};
+
+
+static const char *dir_;
+static int zoom_;
+//! spool file and its length
+static FILE *spool_ = NULL;
+static long slen_;
+//! hash table of tiles (open addressing)
+static struct tile *tile_ = NULL;
+static long tsize_ = 0, tcnt_ = 0;
+
+
+static unsigned long tile_hash(uint64_t key)
+{
+   return (unsigned long) key * 0x9e3779b97f4a7c15ul;
+}
+
+
+static struct tile *tile_find(uint64_t key)
+{
+   unsigned long i;
+
+   for (i = tile_hash(key) & (tsize_ - 1); tile_[i].key != ~0ull && tile_[i].key != key; i = (i + 1) & (tsize_ - 1));
+   return &tile_[i];
+}
+
+
+static int tile_grow(void)
+{
+   struct tile *old = tile_, *t;
+   long i, n = tsize_;
+
+   if ((t = malloc(sizeof(*t) * (n ? n * 2 : 1024))) == NULL)
+      return -1;
+
+   tile_ = t;
+   tsize_ = n ? n * 2 : 1024;
+   for (i = 0; i < tsize_; i++)
+      tile_[i].key = ~0ull;
+   for (i = 0; i < n; i++)
+      if (old[i].key != ~0ull)
+         *tile_find(old[i].key) = old[i];
+   free(old);
+
+   return 0;
+}
+
+
+static int tile_x(double lon)
+{
+   int n = 1 << zoom_, x = floor((lon + 180.0) / 360.0 * n);
+   return x < 0 ? 0 : x >= n ? n - 1 : x;
+}
+
+
+static int tile_y(double lat)
+{
+   int n = 1 << zoom_, y;
+
+   lat = fmax(fmin(lat, 85.0511), -85.0511) * M_PI / 180.0;
+   y = floor((1.0 - asinh(tan(lat)) / M_PI) / 2.0 * n);
+   return y < 0 ? 0 : y >= n ? n - 1 : y;
+}
+
+
+static double tile_lon(int x)
+{
+   return x * 360.0 / (1 << zoom_) - 180.0;
+}
+
+
+static double tile_lat(int y)
+{
+   return atan(sinh(M_PI * (1.0 - 2.0 * y / (1 << zoom_)))) * 180.0 / M_PI;
+}
+
+
+/*! Start tile output.
+ *  @param dir Output directory. It is created if it does not exist.
+ *  @param zoom Zoom level of tiles.
+ *  @return 0 on success, -1 on error.
+ */
+int tile_open(const char *dir, int zoom)
+{
+   char name[strlen(dir) + 8];
+
+   if (zoom < 0 || zoom > TILE_MAX_ZOOM)
+   {
+      errno = EINVAL;
+      return -1;
+   }
+
+   if (mkdir(dir, 0777) == -1 && errno != EEXIST)
+      return -1;
+
+   // the spool file is kept in the output directory because it may be large
+   snprintf(name, sizeof(name), "%s/.spool", dir);
+   if ((spool_ = fopen(name, "w+")) == NULL)
+      return -1;
+   unlink(name);
+
+   dir_ = dir;
+   zoom_ = zoom;
+   slen_ = 0;
+   return 0;
+}
+
+
+/*! Add fragment to all tiles which intersect the bounding box.
+ *  @param bb Bounding box (min lat, min lon, max lat, max lon).
+ *  @return 0 on success, -1 on error.
+ */
+int tile_put(const double *bb, const char *buf, size_t len)
+{
+   int x, y, x1 = tile_x(bb[3]), y1 = tile_y(bb[0]);
+   struct frag *f;
+   struct tile *t;
+   uint64_t key;
+
+   if (!len)
+      return 0;
+   if (fwrite(buf, len, 1, spool_) != 1)
+      return -1;
+
+   for (x = tile_x(bb[1]); x <= x1; x++)
+      for (y = tile_y(bb[2]); y <= y1; y++)
+      {
+         if (tcnt_ * 2 >= tsize_ && tile_grow() == -1)
+            return -1;
+
+         key = (uint64_t) x << 32 | y;
+         if ((t = tile_find(key))->key == ~0ull)
+         {
+            memset(t, 0, sizeof(*t));
+            t->key = key;
+            tcnt_++;
+         }
+
+         if (t->nfrag >= t->mfrag)
+         {
+            if ((f = realloc(t->frag, sizeof(*f) * (t->mfrag ? t->mfrag * 2 : 4))) == NULL)
+               return -1;
+            t->frag = f;
+            t->mfrag = t->mfrag ? t->mfrag * 2 : 4;
+         }
+         t->frag[t->nfrag].off = slen_;
+         t->frag[t->nfrag].len = len;
+         t->nfrag++;
+      }
+
+   slen_ += len;
+   return 0;
+}
+
+
+/*! Write tile file. This is called by the threads of the job queue.
+ */
+static void tile_write(void *p)
+{
+   struct tile *t = p;
+   int i, x = t->key >> 32, y = t->key & 0xffffffff;
+   char name[strlen(dir_) + 40], *buf = NULL;
+   long mlen = 0, n;
+   FILE *f;
+
+   snprintf(name, sizeof(name), "%s/%d", dir_, zoom_);
+   if (mkdir(name, 0777) == -1 && errno != EEXIST)
+      goto fail;
+   snprintf(name, sizeof(name), "%s/%d/%d", dir_, zoom_, x);
+   if (mkdir(name, 0777) == -1 && errno != EEXIST)
+      goto fail;
+   snprintf(name, sizeof(name), "%s/%d/%d/%d.osm", dir_, zoom_, x, y);
+   if ((f = fopen(name, "w")) == NULL)
+      goto fail;
+
+   fprintf(f, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<osm version=\"0.6\" generator=\"smfilter\">\n"
+         "<bounds minlat=\"%f\" minlon=\"%f\" maxlat=\"%f\" maxlon=\"%f\"/>\n",
+         tile_lat(y + 1), tile_lon(x), tile_lat(y), tile_lon(x + 1));
+
+   for (i = 0; i < t->nfrag; i++)
+   {
+      if (t->frag[i].len > mlen)
+      {
+         free(buf);
+         mlen = t->frag[i].len;
+         if ((buf = malloc(mlen)) == NULL)
+            break;
+      }
+      // pread() is used because the spool file is shared by all threads
+      if ((n = pread(fileno(spool_), buf, t->frag[i].len, t->frag[i].off)) != t->frag[i].len)
+      {
+         if (n != -1)
+            errno = EIO;
+         break;
+      }
+      if (fwrite(buf, t->frag[i].len, 1, f) != 1)
+         break;
+   }
+
+   fprintf(f, "</osm>\n");
+   free(buf);
+
+   if (i < t->nfrag)
+   {
+      t->err = errno;
+      fclose(f);
+      return;
+   }
+   if (fclose(f) == EOF)
+      goto fail;
+   return;
+
+fail:
+   t->err = errno;
+}
+
+
+/*! Write all tiles and free everything.
+ *  @param nthreads Number of writer threads.
+ *  @return 0 on success, -1 on error.
+ */
+int tile_close(int nthreads)
+{
+   struct tile *t;
+   jobq_t *jq;
+   int err = 0;
+   long i;
+
+   if (fflush(spool_) == EOF || (jq = jq_init(nthreads, tile_write)) == NULL)
+      err = errno;
+   else
+   {
+      for (i = 0; i < tsize_; i++)
+      {
+         if (tile_[i].key == ~0ull)
+            continue;
+         // wait for a finished tile if the queue is full
+         while (jq_submit(jq, &tile_[i]) == -1)
+            if ((t = jq_next(jq))->err && !err)
+               err = t->err;
+      }
+
+      while ((t = jq_next(jq)) != NULL)
+         if (t->err && !err)
+            err = t->err;
+      jq_free(jq);
+   }
+
+   for (i = 0; i < tsize_; i++)
+      if (tile_[i].key != ~0ull)
+         free(tile_[i].frag);
+   free(tile_);
+   tile_ = NULL;
+   tsize_ = tcnt_ = 0;
+   fclose(spool_);
+   spool_ = NULL;
+
+   if (err)
+   {
+      errno = err;
+      return -1;
+   }
+   return 0;
+}
+
@@ -0,0 +1,34 @@
+/* Copyright 2011 Bernhard R. Fischer, 2048R/5C5FFD47 <bf@abenteuerland.at>
+ *
+ * This file is part of smfilter.
+ *
+ * Smfilter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * Smfilter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with smfilter. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SMTILE_H
+#define SMTILE_H
+
+#include <stddef.h>
+
+
+//! default zoom level of tiles
+#define TILE_ZOOM 10
+#define TILE_MAX_ZOOM 20
+
+
+int tile_open(const char *dir, int zoom);
+int tile_put(const double *bb, const char *buf, size_t len);
+int tile_close(int nthreads);
+
+#endif
+
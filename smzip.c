@@ -0,0 +1,405 @@
+/* Copyright 2011 Bernhard R. Fischer, 2048R/5C5FFD47 <bf@abenteuerland.at>
+ *
+ * This file is part of smfilter.
+ *
+ * Smfilter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * Smfilter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with smfilter. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! This file contains a compressing output stream. Data written to the
+ *  stream is collected in large buffers which are handed over to a separate
+ *  thread. The thread compresses the data and writes it to the destination
+ *  file descriptor, thus compression runs in parallel to parsing.
+ *
+ *  @author Bernhard R. Fischer
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <zlib.h>
+#ifdef WITH_ZSTD
+#include <zstd.h>
+#endif
+
+#include "smzip.h"
+
+
+struct zip_buf
+{
+   char *buf;
+   size_t len;
+};
+
+struct zip_ctrl
+{
+   //! destination file descriptor
+   int fd;
+   //! compression type (ZIP_GZIP, ZIP_ZSTD)
+   int type;
+   //! compression level, -1 means default
+   int level;
+   pthread_t thread;
+   pthread_mutex_t mtx;
+   pthread_cond_t cond;
+   struct zip_buf zb[ZIP_NBUF];
+   //! buffer currently filled by the producer
+   int wr;
+   //! buffer currently compressed by the thread
+   int rd;
+   //! number of buffers handed over to the thread
+   int full;
+   //! flag set by the producer if no more data follows
+   int eof;
+   //! errno of failed operation within the thread, 0 otherwise
+   int err;
+   //! output buffer of the compressor
+   char *obuf;
+};
+
+
+/*! Parse compression type definition of the form <type>[:<level>].
+ *  @param s String containing the definition, e.g. "gzip:6".
+ *  @param level Pointer to integer which receives the level. It is set to -1
+ *  if no level is given.
+ *  @return Compression type (ZIP_GZIP, ZIP_ZSTD) or -1 if the type is unknown
+ *  or not supported.
+ */
+int zip_parse(const char *s, int *level)
+{
+   int n;
+
+   *level = -1;
+   n = strcspn(s, ":");
+   if (s[n] == ':')
+      *level = atoi(s + n + 1);
+
+   if (!strncmp(s, "gzip", n) && n == 4)
+      return ZIP_GZIP;
+#ifdef WITH_ZSTD
+   if (!strncmp(s, "zstd", n) && n == 4)
+      return ZIP_ZSTD;
+#endif
+   return -1;
+}
+
+
+/*! Write a buffer completely to a file descriptor.
+ *  @return 0 on success, -1 on error with errno set.
+ */
+static int zip_write_all(int fd, const char *buf, size_t len)
+{
+   ssize_t s;
+
+   while (len)
+   {
+      if ((s = write(fd, buf, len)) == -1)
+      {
+         if (errno == EINTR)
+            continue;
+         return -1;
+      }
+      buf += s;
+      len -= s;
+   }
+   return 0;
+}
+
+
+/*! Compress all data of the buffer zb with zlib and write it to the output.
+ *  @param flush Z_NO_FLUSH or Z_FINISH.
+ *  @return 0 on success, -1 on error with errno set.
+ */
+static int zip_gz(struct zip_ctrl *zc, z_stream *zs, const struct zip_buf *zb, int flush)
+{
+   int e;
+
+   zs->next_in = (Bytef*) (zb != NULL ? zb->buf : NULL);
+   zs->avail_in = zb != NULL ? zb->len : 0;
+   do
+   {
+      zs->next_out = (Bytef*) zc->obuf;
+      zs->avail_out = ZIP_BUFSIZ;
+      if ((e = deflate(zs, flush)) == Z_STREAM_ERROR)
+      {
+         errno = EIO;
+         return -1;
+      }
+      if (zip_write_all(zc->fd, zc->obuf, ZIP_BUFSIZ - zs->avail_out) == -1)
+         return -1;
+   }
+   while (!zs->avail_out || (flush == Z_FINISH && e != Z_STREAM_END));
+
+   return 0;
+}
+
+
+#ifdef WITH_ZSTD
+/*! Compress all data of the buffer zb with zstd and write it to the output.
+ *  @param mode ZSTD_e_continue or ZSTD_e_end.
+ *  @return 0 on success, -1 on error with errno set.
+ */
+static int zip_zstd(struct zip_ctrl *zc, ZSTD_CCtx *cc, const struct zip_buf *zb, ZSTD_EndDirective mode)
+{
+   ZSTD_inBuffer in = {zb != NULL ? zb->buf : NULL, zb != NULL ? zb->len : 0, 0};
+   ZSTD_outBuffer out;
+   size_t r;
+
+   do
+   {
+      out.dst = zc->obuf;
+      out.size = ZIP_BUFSIZ;
+      out.pos = 0;
+      if (ZSTD_isError(r = ZSTD_compressStream2(cc, &out, &in, mode)))
+      {
+         errno = EIO;
+         return -1;
+      }
+      if (zip_write_all(zc->fd, zc->obuf, out.pos) == -1)
+         return -1;
+   }
+   while (mode == ZSTD_e_end ? r != 0 : in.pos < in.size);
+
+   return 0;
+}
+#endif
+
+
+/*! Compressor thread. It takes filled buffers in order out of the ring,
+ *  compresses and writes them until the producer signals eof.
+ */
+static void *zip_thread(void *p)
+{
+   struct zip_ctrl *zc = p;
+   z_stream zs;
+#ifdef WITH_ZSTD
+   ZSTD_CCtx *cc = NULL;
+#endif
+   int e = 0;
+
+   if (zc->type == ZIP_GZIP)
+   {
+      memset(&zs, 0, sizeof(zs));
+      if (deflateInit2(&zs, zc->level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+         e = ENOMEM;
+   }
+#ifdef WITH_ZSTD
+   else
+   {
+      if ((cc = ZSTD_createCCtx()) == NULL)
+         e = ENOMEM;
+      else if (zc->level != -1)
+         ZSTD_CCtx_setParameter(cc, ZSTD_c_compressionLevel, zc->level);
+   }
+#endif
+
+   for (;;)
+   {
+      pthread_mutex_lock(&zc->mtx);
+      if (e)
+         zc->err = e;
+      while (!zc->full && !zc->eof)
+         pthread_cond_wait(&zc->cond, &zc->mtx);
+      if (!zc->full)
+      {
+         pthread_mutex_unlock(&zc->mtx);
+         break;
+      }
+      pthread_mutex_unlock(&zc->mtx);
+
+      // data is dropped after an error but buffers are still released to
+      // not block the producer
+      if (!e)
+      {
+#ifdef WITH_ZSTD
+         if (zc->type == ZIP_ZSTD)
+         {
+            if (zip_zstd(zc, cc, &zc->zb[zc->rd], ZSTD_e_continue) == -1)
+               e = errno;
+         }
+         else
+#endif
+         if (zip_gz(zc, &zs, &zc->zb[zc->rd], Z_NO_FLUSH) == -1)
+            e = errno;
+      }
+
+      pthread_mutex_lock(&zc->mtx);
+      zc->zb[zc->rd].len = 0;
+      zc->rd = (zc->rd + 1) % ZIP_NBUF;
+      zc->full--;
+      pthread_cond_signal(&zc->cond);
+      pthread_mutex_unlock(&zc->mtx);
+   }
+
+   if (zc->type == ZIP_GZIP)
+   {
+      if (!e && zip_gz(zc, &zs, NULL, Z_FINISH) == -1)
+         e = errno;
+      (void) deflateEnd(&zs);
+   }
+#ifdef WITH_ZSTD
+   else
+   {
+      if (!e && zip_zstd(zc, cc, NULL, ZSTD_e_end) == -1)
+         e = errno;
+      ZSTD_freeCCtx(cc);
+   }
+#endif
+
+   zc->err = e;
+   return NULL;
+}
+
+
+/*! Hand the current buffer over to the compressor thread and wait until
+ *  the next one is available.
+ *  @return 0 on success, -1 if the thread failed. errno is set accordingly.
+ */
+static int zip_submit(struct zip_ctrl *zc)
+{
+   int e;
+
+   pthread_mutex_lock(&zc->mtx);
+   zc->full++;
+   pthread_cond_signal(&zc->cond);
+   while (zc->full == ZIP_NBUF)
+      pthread_cond_wait(&zc->cond, &zc->mtx);
+   zc->wr = (zc->wr + 1) % ZIP_NBUF;
+   e = zc->err;
+   pthread_mutex_unlock(&zc->mtx);
+
+   if (e)
+   {
+      errno = e;
+      return -1;
+   }
+   return 0;
+}
+
+
+static ssize_t zip_cwrite(void *cookie, const char *buf, size_t size)
+{
+   struct zip_ctrl *zc = cookie;
+   struct zip_buf *zb;
+   size_t len, n;
+
+   for (len = size; len; len -= n, buf += n)
+   {
+      zb = &zc->zb[zc->wr];
+      n = ZIP_BUFSIZ - zb->len < len ? ZIP_BUFSIZ - zb->len : len;
+      memcpy(zb->buf + zb->len, buf, n);
+      zb->len += n;
+
+      if (zb->len == ZIP_BUFSIZ && zip_submit(zc) == -1)
+         return -1;
+   }
+
+   return size;
+}
+
+
+static int zip_cclose(void *cookie)
+{
+   struct zip_ctrl *zc = cookie;
+   int i, e;
+
+   e = zc->zb[zc->wr].len ? zip_submit(zc) : 0;
+
+   pthread_mutex_lock(&zc->mtx);
+   zc->eof = 1;
+   pthread_cond_signal(&zc->cond);
+   pthread_mutex_unlock(&zc->mtx);
+   pthread_join(zc->thread, NULL);
+
+   if (!e && zc->err)
+   {
+      errno = zc->err;
+      e = -1;
+   }
+
+   pthread_cond_destroy(&zc->cond);
+   pthread_mutex_destroy(&zc->mtx);
+   for (i = 0; i < ZIP_NBUF; i++)
+      free(zc->zb[i].buf);
+   free(zc->obuf);
+   free(zc);
+
+   return e ? EOF : 0;
+}
+
+
+/*! Open a compressing output stream on the file descriptor fd. All data
+ *  written to the stream is compressed by a separate thread. The stream must
+ *  be closed with fclose(3) to flush all data and terminate the thread.
+ *  @param fd Destination file descriptor.
+ *  @param type Compression type (ZIP_GZIP or ZIP_ZSTD).
+ *  @param level Compression level or -1 for the default level.
+ *  @return Pointer to FILE stream or NULL in case of error with errno set.
+ */
+FILE *zip_fdopen(int fd, int type, int level)
+{
+   cookie_io_functions_t iof = {NULL, zip_cwrite, NULL, zip_cclose};
+   struct zip_ctrl *zc;
+   FILE *f;
+   int i, e;
+
+   if (type != ZIP_GZIP && type != ZIP_ZSTD)
+   {
+      errno = EINVAL;
+      return NULL;
+   }
+
+   if ((zc = calloc(1, sizeof(*zc))) == NULL)
+      return NULL;
+
+   zc->fd = fd;
+   zc->type = type;
+   zc->level = level;
+   for (i = 0; i < ZIP_NBUF; i++)
+      if ((zc->zb[i].buf = malloc(ZIP_BUFSIZ)) == NULL)
+         goto zip_err;
+   if ((zc->obuf = malloc(ZIP_BUFSIZ)) == NULL)
+      goto zip_err;
+
+   pthread_mutex_init(&zc->mtx, NULL);
+   pthread_cond_init(&zc->cond, NULL);
+   if ((e = pthread_create(&zc->thread, NULL, zip_thread, zc)))
+   {
+      pthread_cond_destroy(&zc->cond);
+      pthread_mutex_destroy(&zc->mtx);
+      errno = e;
+      goto zip_err;
+   }
+
+   if ((f = fopencookie(zc, "w", iof)) == NULL)
+   {
+      e = errno;
+      (void) zip_cclose(zc);
+      errno = e;
+      return NULL;
+   }
+
+   return f;
+
+zip_err:
+   e = errno;
+   for (i = 0; i < ZIP_NBUF; i++)
+      free(zc->zb[i].buf);
+   free(zc->obuf);
+   free(zc);
+   errno = e;
+   return NULL;
+}
+
@@ -0,0 +1,36 @@
+/* Copyright 2011 Bernhard R. Fischer, 2048R/5C5FFD47 <bf@abenteuerland.at>
+ *
+ * This file is part of smfilter.
+ *
+ * Smfilter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * Smfilter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with smfilter. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SMZIP_H
+#define SMZIP_H
+
+#include <stdio.h>
+
+//! size of a single buffer handed to the compressor thread
+#define ZIP_BUFSIZ (1024 * 1024)
+//! number of buffers in the ring between producer and compressor
+#define ZIP_NBUF 4
+
+
+enum {ZIP_NONE, ZIP_GZIP, ZIP_ZSTD};
+
+
+int zip_parse(const char *s, int *level);
+FILE *zip_fdopen(int fd, int type, int level);
+
+#endif
+